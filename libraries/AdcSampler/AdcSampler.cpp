@@ -0,0 +1,199 @@
+/**
+ *  File: AdcSampler.cpp
+ *
+ *  Background sampling of analog inputs on Arduino Mega 2560
+ *
+ *  analogRead() starts a conversion and waits for it.  With the 128 prescaler
+ *  the ADC clock is 125 kHz and one conversion takes 13 clocks, so every
+ *  analogRead() blocks the program for about 110 us.
+ *
+ *  This library does the conversions in the ADC conversion complete interrupt
+ *  - Up to 8 channels are registered with addChannel
+ *  - The interrupt stores the result, selects the next channel, and
+ *    > starts the next conversion immediately (adcFreeRunning), about 9600
+ *      conversions per second shared by all channels
+ *    > or lets the Timer 0 overflow start the next conversion (adcTimer0),
+ *      976 conversions per second with a fixed sampling interval
+ *  - Each channel is oversampled with 4^n conversions and decimated by n bits
+ *    > n = 0 .. 3, so the sum of 64 conversions fits into 16 bits
+ *    > readHiRes returns the 10 + n bit value, read returns it in 10 bits
+ *  - The accessors return the latest decimated value without waiting
+ *  - If the sampler is not running, the first read starts it.  It can not be
+ *    started in a constructor, because the Arduino init() resets the ADC
+ *  - analogRead() must not be used while the sampler is running
+ *
+ *  The ADC multiplexer for pins A0 - A15 is
+ *      ADMUX   bits MUX4..0 for channel 0 - 7 (single ended)
+ *      ADCSRB  bit MUX5 for channels 8 - 15
+ *
+ *  A tick function can be attached to run in the interrupt after every
+ *  conversion, for example to poll inputs without a pin change interrupt.
+ *  tickPin() and tickValue() give it the conversion that just completed,
+ *  before the oversampling, so it can check a limit on every conversion.
+ */
+
+#include <AdcSampler.h>
+
+#define MAXCHANNELS     8
+#define MAXOVERSAMPLE   3
+#define NOCHANNEL       0xFF
+                                    // See 2560 datasheet section 26.8.1 for ADMUX
+#define ADCREFERENCE    (1 << REFS0)                    // AVCC reference
+                                    // See 2560 datasheet section 26.8.3 for ADCSRA
+#define ADCPRESCALER    (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0)   // 128
+#define ADCENABLE       (1 << ADEN) | (1 << ADIE) | ADCPRESCALER
+                                    // See 2560 datasheet section 26.8.4 for ADCSRB
+#define ADCTSTIMER0     (1 << ADTS2)                    // Timer 0 overflow
+
+typedef struct {
+    uint8_t     pin;                // A0 .. A15
+    uint8_t     bits;               // Oversampling bits
+    uint8_t     count;              // Conversions in the sum
+    uint16_t    sum;                // Sum of the conversions
+    uint16_t    value;              // Latest decimated value
+    uint16_t    samples;            // Number of decimated values
+} AdcChannel;
+
+static AdcChannel       channels[MAXCHANNELS];
+static uint8_t          channelCount;
+volatile uint8_t        currentChannel;
+volatile bool           running;
+static AdcTrigger       adcTrigger;
+static AdcTick          adcTick;
+static uint8_t          adcTickPin;         // Latest conversion
+static uint16_t         adcTickValue;
+
+//---------------------------------------------------- Local Functions -------
+
+uint8_t findChannel(uint8_t pin) {
+    for (uint8_t i=0;i<channelCount;i++) {
+        if (channels[i].pin == pin) return i;
+    }
+    return NOCHANNEL;
+}
+
+void selectChannel(uint8_t i) {     // Route the pin to the ADC
+    uint8_t adcNr   = channels[i].pin - A0;
+    ADMUX   = ADCREFERENCE | (adcNr & 7);
+    if (adcNr & 8)  ADCSRB |=  (1 << MUX5);
+    else            ADCSRB &= ~(1 << MUX5);
+}
+
+//---------------------------------------------------- Class Methods ---------
+
+bool AdcSampler::addChannel(uint8_t pin, uint8_t oversampleBits) {
+    if ((pin < A0) || (pin > A0 + 15)) return false;
+    if (oversampleBits > MAXOVERSAMPLE) oversampleBits = MAXOVERSAMPLE;
+
+    uint8_t i = findChannel(pin);
+    if (i == NOCHANNEL) {
+        if (channelCount >= MAXCHANNELS) return false;
+        i = channelCount;
+    }
+    uint8_t sreg    = SREG;
+    cli();                          // The interrupt can not see a partial channel
+    channels[i].pin     = pin;
+    channels[i].bits    = oversampleBits;
+    channels[i].count   = 0;
+    channels[i].sum     = 0;
+    if (i == channelCount) {
+        channels[i].value   = 0;
+        channels[i].samples = 0;
+        channelCount++;
+    }
+    SREG    = sreg;
+    return true;
+}
+
+void AdcSampler::start(AdcTrigger trigger) {
+    if (channelCount == 0) return;
+    stop();
+    adcTrigger      = trigger;
+    currentChannel  = 0;
+    selectChannel(0);
+    if (trigger == adcTimer0) {
+        ADCSRB  = (ADCSRB & (1 << MUX5)) | ADCTSTIMER0;
+        ADCSRA  = ADCENABLE | (1 << ADATE) | (1 << ADIF);
+    } else {
+        ADCSRA  = ADCENABLE | (1 << ADIF);
+        ADCSRA  |= (1 << ADSC);     // Start the first conversion
+    }
+    running = true;
+}
+
+void AdcSampler::stop() {
+    ADCSRA  = (1 << ADEN) | ADCPRESCALER;   // Same as Arduino init() for analogRead
+    while (ADCSRA & (1 << ADSC));           // Let a running conversion complete
+    running = false;
+}
+
+bool AdcSampler::isRunning() {
+    return running;
+}
+
+bool AdcSampler::isSampled(uint8_t pin) {
+    return findChannel(pin) != NOCHANNEL;
+}
+
+uint16_t AdcSampler::readHiRes(uint8_t pin) {
+    uint8_t i = findChannel(pin);
+    if (i == NOCHANNEL) return 0;
+    if (!running) start(adcTrigger);
+    uint8_t sreg    = SREG;
+    cli();
+    uint16_t value  = channels[i].value;
+    SREG    = sreg;
+    return value;
+}
+
+uint16_t AdcSampler::read(uint8_t pin) {
+    uint8_t i = findChannel(pin);
+    if (i == NOCHANNEL) return 0;
+    return readHiRes(pin) >> channels[i].bits;
+}
+
+uint16_t AdcSampler::sampleCount(uint8_t pin) {
+    uint8_t i = findChannel(pin);
+    if (i == NOCHANNEL) return 0;
+    uint8_t sreg    = SREG;
+    cli();
+    uint16_t count  = channels[i].samples;
+    SREG    = sreg;
+    return count;
+}
+
+void AdcSampler::attachTick(AdcTick tick) {
+    uint8_t sreg    = SREG;
+    cli();
+    adcTick = tick;
+    SREG    = sreg;
+}
+
+uint8_t AdcSampler::tickPin() {     // In the tick, interrupts disabled
+    return adcTickPin;
+}
+
+uint16_t AdcSampler::tickValue() {
+    return adcTickValue;
+}
+
+//-------------------------------------------- Interrupt Routines ---------------------
+
+ISR(ADC_vect) {                     // ADC CONVERSION COMPLETE INTERRUPT
+    AdcChannel  *ch = &channels[currentChannel];
+    adcTickPin      = ch->pin;
+    adcTickValue    = ADC;
+    ch->sum += adcTickValue;
+    if (++ch->count >= (1 << (2 * ch->bits))) {
+        ch->value   = ch->sum >> ch->bits;      // Decimate 4^n samples by n bits
+        ch->sum     = 0;
+        ch->count   = 0;
+        ch->samples++;
+    }
+    if (++currentChannel >= channelCount) currentChannel = 0;
+    selectChannel(currentChannel);
+    if (adcTrigger == adcFreeRunning) {
+        ADCSRA  |= (1 << ADSC);     // Start the next conversion
+    }
+    if (adcTick) adcTick();
+}
@@ -0,0 +1,28 @@
+#ifndef ADCSAMPLER_H
+#define ADCSAMPLER_H
+
+#include <Arduino.h>
+
+typedef enum adcTriggers {
+    adcFreeRunning,                 // Next conversion starts in the interrupt
+    adcTimer0                       // Conversions at Timer 0 overflow (976 Hz)
+} AdcTrigger;
+
+typedef void (*AdcTick)(void);
+
+class AdcSampler {
+public:
+    static bool     addChannel(uint8_t pin, uint8_t oversampleBits = 2);
+    static void     start(AdcTrigger trigger = adcFreeRunning);
+    static void     stop();
+    static bool     isRunning();
+    static bool     isSampled(uint8_t pin);
+    static uint16_t read(uint8_t pin);          // 0 .. 1023
+    static uint16_t readHiRes(uint8_t pin);     // 10 + oversampleBits bits
+    static uint16_t sampleCount(uint8_t pin);   // Decimated values, wraps around
+    static void     attachTick(AdcTick tick);   // Called in every ADC interrupt
+    static uint8_t  tickPin();                  // In the tick, pin of the conversion
+    static uint16_t tickValue();                //  and its value 0 .. 1023
+};
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * Demonstrate the background sampling of analog inputs
+ *  - Two optical distance sensors in A6 and A7
+ *  - Two motor current sense inputs in A2 and A3
+ *  - The loop is not waiting for the ADC, so it runs every 1 ms
+ *
+ *  Use Serial Monitor and Plotter in Arduino tools to visualize the values
+ *    A6 and A7 with 4 times oversampling (11 bits)
+ *    A2 and A3 with 16 times oversampling (12 bits)
+ */
+
+#include <AdcSampler.h>
+
+uint8_t   pins[]  = {A6, A7, A2, A3};
+
+void setup() {
+  Serial.begin(230400);
+
+  AdcSampler::addChannel(A6, 1);
+  AdcSampler::addChannel(A7, 1);
+  AdcSampler::addChannel(A2, 2);
+  AdcSampler::addChannel(A3, 2);
+  AdcSampler::start(adcTimer0);     // Fixed 976 Hz, 244 Hz per channel
+}
+
+void loop() {
+  uint32_t  start = micros();
+
+  for (uint8_t i=0;i<4;i++) {
+    Serial.print(AdcSampler::readHiRes(pins[i]));
+    Serial.print('\t');
+  }
+  Serial.println(micros() - start); // Time used for reading and printing
+
+  delay(1);
+}
@@ -41,29 +41,168 @@
  *  ADC values representing the range from 0 to 700.  Simple interpolation is 
  *  used to find the distance for values that are not there.
  *
+ *  The interpolation is done at compile time (SharpCurve.h) for all 1024
+ *  ADC values.  The table is in flash, so the 140 bytes of SRAM used by the
+ *  odsCurve table are free, and the conversion is a single flash read
+ *  instead of two divisions, a multiplication, and a third division.
+ *  The cost is 2048 bytes of flash.  The example GP2Y0A21_compare checks
+ *  all ADC values against the run time interpolation and times both.
+ *
+ *  Individual sensors differ from this curve by tens of millimeters.
+ *  A sensor specific curve can be stored into EEPROM
+ *  - Example GP2Y0A21_calibrate logs ADC readings with an ultrasonic
+ *    reference distance, and stores a curve into EEPROM
+ *  - extras/odsfit.py fits a monotone curve to the logged pairs
+ *  - GP2Y0A21loadCalibration(sensorId, table) checks the EEPROM slot at startup
+ *  - GP2Y0A21distance(reading, sensorId) uses the loaded curve, or the
+ *    built-in flash table if the slot was not valid
+ *
+ *  The EEPROM slot for sensorId starts at sensorId * 146
+ *      uint16_t    magic       0x4F44
+ *      uint8_t     points      2 .. 70
+ *      uint8_t     step        ADC counts between the points
+ *      int16_t     curve[70]   distance in mm for 0, step, 2 * step, ...
+ *      uint16_t    checksum    sum of the words above
+ *
+ *  Without a table, every conversion interpolates the EEPROM curve with two
+ *  EEPROM word reads and a 32 bit division.  The library keeps only 4 bytes
+ *  of SRAM per sensor.
+ *
+ *  With a table of GP2Y0A21_TABLEPOINTS words (258 bytes), given by the
+ *  caller, GP2Y0A21loadCalibration() interpolates the EEPROM curve once
+ *  into it for every 8th ADC value.  The conversion is then an indexed
+ *  read of two neighbours and a shift, without EEPROM reads or divisions.
+ *  Between the 8 counts the table differs from an EEPROM curve shaped like
+ *  the built-in one by up to 6 mm under 1 m, 30 mm under 3 m, and a few
+ *  hundred mm over 3 m, where the readings are not usable anyway.  A curve
+ *  that is steeper at the low ADC values differs more.  The table must stay allocated
+ *  while the curve is used.
+ *
  */
  
 #include <GP2Y0A21.h>
+#include <SharpCurve.h>
+#include <avr/eeprom.h>
+
+#define EEMAGIC     0x4F44
+#define EEHEADER    4
+#define EESLOTSIZE  (EEHEADER + 2 * GP2Y0A21_MAXPOINTS + 2)
+#define RAMSHIFT    3               // SRAM table has every 8th ADC value
+#define RAMMASK     ((1 << RAMSHIFT) - 1)
 
-#define ARRSIZE 70
-#define ARRSIZE_1 (ARRSIZE - 1)
+static_assert(GP2Y0A21_TABLEPOINTS == (1024 >> RAMSHIFT) + 1, "GP2Y0A21_TABLEPOINTS");
 
-int16_t odsCurve[ARRSIZE] = {
+struct GP2Y0A21Model {
+    static constexpr uint8_t    points  = 70;
+    static constexpr uint8_t    step    = 10;
+    static constexpr int16_t    curve[points] = {
     4227, 3362, 2672, 2132, 1717, 1402, 1162, 977, 832, 716, 623, 548, 488, 440,
     402, 372, 348, 328, 310, 293, 278, 264, 251, 239, 228, 218, 209, 201,
     194, 187, 180, 174, 168, 162, 156, 151, 146, 141, 137, 133, 129, 125,
     122, 119, 116, 113, 110, 107, 104, 101, 98, 95, 92, 90, 88, 86,
     84, 82, 80, 78, 76, 74, 72, 71, 70, 69, 68, 67, 66, 65};
+};
+
+template struct SharpTable<GP2Y0A21Model, SharpAdcIndices>;
 
 int16_t GP2Y0A21distance(int16_t sensorReading) {
-    int16_t    major = sensorReading / 10;
-    int16_t    minor = sensorReading % 10;
-    
-    if (major + 1 > ARRSIZE_1) return odsCurve[ARRSIZE_1];
-    if (major < 1) return odsCurve[0];
+    return SharpCurve<GP2Y0A21Model>::distance(sensorReading);
+}
+
+static uint8_t  eePoints[GP2Y0A21_SENSORS];     // Loaded EEPROM curve, 0 = built-in
+static uint8_t  eeStep[GP2Y0A21_SENSORS];
+static int16_t  *ramTable[GP2Y0A21_SENSORS];    // Caller's table, NULL = EEPROM
+
+static uint16_t *eeAddress(uint8_t sensorId, uint8_t offset) {
+    return (uint16_t *) (uintptr_t) (sensorId * EESLOTSIZE + offset);
+}
+
+static uint16_t eeWord(uint8_t sensorId, uint8_t offset) {
+    return eeprom_read_word(eeAddress(sensorId, offset));
+}
+
+static int16_t eeCurve(uint8_t sensorId, uint8_t i) {
+    return eeWord(sensorId, EEHEADER + 2 * i);
+}
+
+static uint16_t eeChecksum(uint8_t sensorId, uint8_t points) {
+    uint16_t    sum = eeWord(sensorId, 0) + eeWord(sensorId, 2);
+    for (uint8_t i=0;i<points;i++) {
+        sum += eeCurve(sensorId, i);
+    }
+    return sum;
+}
+
+static int16_t eeInterpolate(uint8_t sensorId, uint8_t points, uint8_t step, int16_t sensorReading) {
+    uint8_t     last    = points - 1;
+    if (sensorReading < step) return eeCurve(sensorId, 0);
+
+    int16_t     major   = sensorReading / step;
+    int16_t     minor   = sensorReading % step;
+    if (major + 1 > last) return eeCurve(sensorId, last);
+
+    int16_t     v1      = eeCurve(sensorId, major);
+    int16_t     v2      = eeCurve(sensorId, major + 1);
+
+    return v1 - (int32_t) minor * (v1 - v2) / step;
+}
+
+bool GP2Y0A21loadCalibration(uint8_t sensorId, int16_t *table) {
+    if (sensorId >= GP2Y0A21_SENSORS) return false;
+    eePoints[sensorId]  = 0;            // Built-in curve unless loaded
+    ramTable[sensorId]  = NULL;
+    if (eeWord(sensorId, 0) != EEMAGIC) return false;
+
+    uint8_t points  = eeprom_read_byte((uint8_t *) eeAddress(sensorId, 2));
+    uint8_t step    = eeprom_read_byte((uint8_t *) eeAddress(sensorId, 3));
+    if ((points < 2) || (points > GP2Y0A21_MAXPOINTS) || (step == 0)) return false;
+    if (eeChecksum(sensorId, points) != eeWord(sensorId, EEHEADER + 2 * points)) return false;
+
+    if (table) {
+        for (int16_t i=0;i<GP2Y0A21_TABLEPOINTS;i++) {
+            table[i]    = eeInterpolate(sensorId, points, step, i << RAMSHIFT);
+        }
+    }
+    ramTable[sensorId]  = table;
+    eeStep[sensorId]    = step;
+    eePoints[sensorId]  = points;
+    return true;
+}
+
+bool GP2Y0A21saveCalibration(uint8_t sensorId, const int16_t *curve,
+                             uint8_t points, uint8_t step) {
+    if (sensorId >= GP2Y0A21_SENSORS) return false;
+    if ((points < 2) || (points > GP2Y0A21_MAXPOINTS) || (step == 0)) return false;
+
+    int16_t     *table  = ramTable[sensorId];
+    eePoints[sensorId]  = 0;            // Not valid while writing
+    eeprom_update_word(eeAddress(sensorId, 0), EEMAGIC);
+    eeprom_update_byte((uint8_t *) eeAddress(sensorId, 2), points);
+    eeprom_update_byte((uint8_t *) eeAddress(sensorId, 3), step);
+    for (uint8_t i=0;i<points;i++) {
+        eeprom_update_word(eeAddress(sensorId, EEHEADER + 2 * i), curve[i]);
+    }
+    eeprom_update_word(eeAddress(sensorId, EEHEADER + 2 * points),
+                       eeChecksum(sensorId, points));
+    return GP2Y0A21loadCalibration(sensorId, table);
+}
 
-    int16_t    v1 = odsCurve[major];
-    int16_t    v2 = odsCurve[major +1];
+void GP2Y0A21clearCalibration(uint8_t sensorId) {
+    if (sensorId >= GP2Y0A21_SENSORS) return;
+    eePoints[sensorId]  = 0;
+    ramTable[sensorId]  = NULL;
+    eeprom_update_word(eeAddress(sensorId, 0), 0xFFFF);
+}
 
-    return v1 - minor*(v1 - v2) / 10;
-}
\ No newline at end of file
+int16_t GP2Y0A21distance(int16_t sensorReading, uint8_t sensorId) {
+    if ((sensorId >= GP2Y0A21_SENSORS) || (eePoints[sensorId] == 0)) {
+        return GP2Y0A21distance(sensorReading);     // Built-in curve
+    }
+    if (sensorReading < 0) sensorReading = 0;
+    if (sensorReading > 1023) sensorReading = 1023;
+    if (ramTable[sensorId] == NULL) {
+        return eeInterpolate(sensorId, eePoints[sensorId], eeStep[sensorId], sensorReading);
+    }
+    const int16_t *v    = &ramTable[sensorId][sensorReading >> RAMSHIFT];
+    return v[0] - (((v[0] - v[1]) * (sensorReading & RAMMASK)) >> RAMSHIFT);
+}
@@ -3,6 +3,15 @@
 
 #include <Arduino.h>
 
+#define GP2Y0A21_SENSORS    4       // Calibration slots in EEPROM
+#define GP2Y0A21_MAXPOINTS  70      // Breakpoints in a calibration curve
+#define GP2Y0A21_TABLEPOINTS 129    // Words in a loaded curve table, every 8th ADC value
+
 int16_t GP2Y0A21distance(int16_t sensorReading);
+int16_t GP2Y0A21distance(int16_t sensorReading, uint8_t sensorId);
+bool    GP2Y0A21loadCalibration(uint8_t sensorId, int16_t *table = NULL);  // NULL = EEPROM
+bool    GP2Y0A21saveCalibration(uint8_t sensorId, const int16_t *curve,
+                                uint8_t points, uint8_t step);
+void    GP2Y0A21clearCalibration(uint8_t sensorId);
 
-#endif
\ No newline at end of file
+#endif
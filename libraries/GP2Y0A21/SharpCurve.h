@@ -0,0 +1,95 @@
+/**
+ *  File: SharpCurve.h
+ *
+ *  Compile time lookup tables for Sharp optical distance sensors
+ *
+ *  A sensor model is described with a class that has
+ *      points      number of breakpoints in the curve
+ *      step        ADC counts between the breakpoints
+ *      curve[]     distance in mm for the ADC values 0, step, 2 * step, ...
+ *
+ *  SharpCurve<Model>::interpolate is the same linear interpolation that was
+ *  done at run time.  It is constexpr, so the compiler can expand the curve
+ *  into a table with one entry for every ADC value 0 .. 1023.  The table is
+ *  stored in flash (PROGMEM) and the conversion is a single flash read.
+ *
+ *  The table is generated with a pack of indices 0 .. 1023.  The index list
+ *  is built by concatenating two halves, so the template depth is only 10.
+ *
+ *  Usage for another model, in a cpp-file
+ *
+ *      struct MyModel {
+ *          static constexpr uint8_t    points  = 40;
+ *          static constexpr uint8_t    step    = 20;
+ *          static constexpr int16_t    curve[points] = {...};
+ *      };
+ *      template struct SharpTable<MyModel, SharpAdcIndices>;
+ *
+ *      int16_t d = SharpCurve<MyModel>::distance(analogRead(A0));
+ */
+
+#ifndef SHARPCURVE_H
+#define SHARPCURVE_H
+
+#include <Arduino.h>
+
+#define SHARP_ADC_VALUES    1024
+
+template <uint16_t... I> struct SharpIndices {};
+
+template <class A, class B> struct SharpConcat;
+
+template <uint16_t... I, uint16_t... J>
+struct SharpConcat<SharpIndices<I...>, SharpIndices<J...> > {
+    typedef SharpIndices<I..., (sizeof...(I) + J)...> type;
+};
+
+template <uint16_t N> struct SharpMakeIndices {
+    typedef typename SharpConcat<   typename SharpMakeIndices<N / 2>::type,
+                                    typename SharpMakeIndices<N - N / 2>::type>::type type;
+};
+template <> struct SharpMakeIndices<0> {typedef SharpIndices<>  type;};
+template <> struct SharpMakeIndices<1> {typedef SharpIndices<0> type;};
+
+typedef SharpMakeIndices<SHARP_ADC_VALUES>::type SharpAdcIndices;
+
+template <class Model> struct SharpInterpolation {
+    static constexpr int16_t last() {
+        return Model::curve[Model::points - 1];
+    }
+    static constexpr int16_t between(int16_t major, int16_t minor) {
+        return Model::curve[major]
+            - minor * (Model::curve[major] - Model::curve[major + 1]) / Model::step;
+    }
+    static constexpr int16_t at(int16_t sensorReading) {
+        return (sensorReading / Model::step + 1 > Model::points - 1) ? last()
+            :  (sensorReading / Model::step < 1) ? Model::curve[0]
+            :  between(sensorReading / Model::step, sensorReading % Model::step);
+    }
+};
+
+template <class Model, class Indices> struct SharpTable;
+
+template <class Model, uint16_t... I> struct SharpTable<Model, SharpIndices<I...> > {
+    static const int16_t values[sizeof...(I)];
+};
+
+template <class Model, uint16_t... I>
+const int16_t SharpTable<Model, SharpIndices<I...> >::values[sizeof...(I)] PROGMEM = {
+    SharpInterpolation<Model>::at(I)...
+};
+
+template <class Model> class SharpCurve {
+public:
+    static constexpr int16_t interpolate(int16_t sensorReading) {
+        return SharpInterpolation<Model>::at(sensorReading);
+    }
+    static int16_t distance(int16_t sensorReading) {
+        if (sensorReading < 0) sensorReading = 0;
+        if (sensorReading > SHARP_ADC_VALUES - 1) sensorReading = SHARP_ADC_VALUES - 1;
+        typedef SharpTable<Model, SharpAdcIndices> Table;
+        return pgm_read_word(&Table::values[sensorReading]);
+    }
+};
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Calibrate a GP2Y0A21 against a HC_SR04 reference and store the curve
+ *
+ *  Step 1, logging
+ *  - Mount the optical sensor next to the front ultrasonic sensor
+ *  - Send 'l' and move a flat target slowly between 8 and 80 cm
+ *  - Every 50 ms a line "adc<TAB>mm" is printed, when the ultrasonic
+ *    reading is not clear.  Send 'l' again to stop.
+ *  - Copy the lines from Serial Monitor into a text file
+ *
+ *  Step 2, fitting on the PC
+ *      python3 extras/odsfit.py log.txt
+ *  - Paste the printed CURVEPOINTS, CURVESTEP, and curve below
+ *
+ *  Step 3, storing
+ *  - Upload the sketch again and send 's' to write the curve into the
+ *    EEPROM slot SENSORID.  'c' clears the slot, and 'v' prints the built-in
+ *    and calibrated distances side by side.
+ *  - The loaded curve is expanded into table, so the conversions do not
+ *    read EEPROM.  Without the table it costs no SRAM.
+ *
+ *  WH_Rover uses slot 0 for ODS_L (A6) and slot 1 for ODS_R (A7).
+ */
+
+#include <GP2Y0A21.h>
+#include <AdcSampler.h>
+#include <HC_SR04.h>
+
+#define ODSPIN      A6
+#define SENSORID    0
+#define USCHANNEL   1                       // Front sensor, US_FF
+
+                                            // Output of extras/odsfit.py
+#define CURVEPOINTS 70
+#define CURVESTEP   10
+int16_t curve[CURVEPOINTS] = {
+    4227, 3362, 2672, 2132, 1717, 1402, 1162, 977, 832, 716, 623, 548, 488, 440,
+    402, 372, 348, 328, 310, 293, 278, 264, 251, 239, 228, 218, 209, 201,
+    194, 187, 180, 174, 168, 162, 156, 151, 146, 141, 137, 133, 129, 125,
+    122, 119, 116, 113, 110, 107, 104, 101, 98, 95, 92, 90, 88, 86,
+    84, 82, 80, 78, 76, 74, 72, 71, 70, 69, 68, 67, 66, 65};
+
+int16_t table[GP2Y0A21_TABLEPOINTS];        // The loaded curve
+
+HC_SR04     uss(1UL << USCHANNEL);
+bool        logging;
+
+void verify() {
+    Serial.println("adc\tbuilt-in\tcalibrated");
+    for (int16_t adc=0;adc<1024;adc+=16) {
+        Serial.print(adc);                                  Serial.print('\t');
+        Serial.print(GP2Y0A21distance(adc));                Serial.print('\t');
+        Serial.println(GP2Y0A21distance(adc, SENSORID));
+    }
+}
+
+void setup() {
+    Serial.begin(230400);
+    AdcSampler::addChannel(ODSPIN);
+    if (GP2Y0A21loadCalibration(SENSORID, table)) Serial.println("Calibration loaded");
+    else                                        Serial.println("No calibration");
+    Serial.println("l = log, s = save, c = clear, v = verify");
+}
+
+void loop() {
+    switch (Serial.read()) {
+        case 'l':
+            logging = !logging;
+            break;
+        case 's':
+            if (GP2Y0A21saveCalibration(SENSORID, curve, CURVEPOINTS, CURVESTEP)) {
+                Serial.println("Saved");
+            } else {
+                Serial.println("Save failed");
+            }
+            break;
+        case 'c':
+            GP2Y0A21clearCalibration(SENSORID);
+            Serial.println("Cleared");
+            break;
+        case 'v':
+            verify();
+            break;
+    }
+    if (logging) {
+        uint16_t    mm  = uss.readSensor(USCHANNEL);
+        if ((mm > 0) && (mm < HC_SR04_CLEAR)) {
+            Serial.print(AdcSampler::read(ODSPIN));         Serial.print('\t');
+            Serial.println(mm);
+        }
+        delay(50);
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * Compare the GP2Y0A21 flash table against the run time interpolation
+ *  - Every ADC value 0 .. 1023 is converted with both methods
+ *  - Any difference is printed
+ *  - Both methods are timed over all ADC values
+ *
+ *  The run time interpolation below is the earlier library code.  Its table
+ *  takes 140 bytes of SRAM, which the flash table does not use.
+ *
+ *  Use Serial Monitor to see the results
+ */
+
+#include <GP2Y0A21.h>
+
+#define ARRSIZE 70
+#define ARRSIZE_1 (ARRSIZE - 1)
+
+int16_t odsCurve[ARRSIZE] = {
+    4227, 3362, 2672, 2132, 1717, 1402, 1162, 977, 832, 716, 623, 548, 488, 440,
+    402, 372, 348, 328, 310, 293, 278, 264, 251, 239, 228, 218, 209, 201,
+    194, 187, 180, 174, 168, 162, 156, 151, 146, 141, 137, 133, 129, 125,
+    122, 119, 116, 113, 110, 107, 104, 101, 98, 95, 92, 90, 88, 86,
+    84, 82, 80, 78, 76, 74, 72, 71, 70, 69, 68, 67, 66, 65};
+
+int16_t interpolatedDistance(int16_t sensorReading) {
+    int16_t    major = sensorReading / 10;
+    int16_t    minor = sensorReading % 10;
+    
+    if (major + 1 > ARRSIZE_1) return odsCurve[ARRSIZE_1];
+    if (major < 1) return odsCurve[0];
+
+    int16_t    v1 = odsCurve[major];
+    int16_t    v2 = odsCurve[major +1];
+
+    return v1 - minor*(v1 - v2) / 10;
+}
+
+volatile int16_t sink;              // Keep the compiler from removing the loops
+
+void setup() {
+    Serial.begin(230400);
+    Serial.println("GP2Y0A21 compare");
+
+    uint16_t errors = 0;
+    for (int16_t i=0;i<1024;i++) {
+        if (GP2Y0A21distance(i) != interpolatedDistance(i)) {
+            errors++;
+            Serial.print(i);                        Serial.print('\t');
+            Serial.print(interpolatedDistance(i));  Serial.print('\t');
+            Serial.println(GP2Y0A21distance(i));
+        }
+    }
+    Serial.print("Differences: ");
+    Serial.println(errors);
+
+    uint32_t start = micros();
+    for (int16_t i=0;i<1024;i++) sink = interpolatedDistance(i);
+    uint32_t interpolated = micros() - start;
+
+    start = micros();
+    for (int16_t i=0;i<1024;i++) sink = GP2Y0A21distance(i);
+    uint32_t table = micros() - start;
+
+    Serial.print("Interpolation [us/1024]: ");  Serial.println(interpolated);
+    Serial.print("Flash table   [us/1024]: ");  Serial.println(table);
+}
+
+void loop() {
+}
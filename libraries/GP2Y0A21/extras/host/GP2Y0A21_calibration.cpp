@@ -0,0 +1,65 @@
+/**
+ *  File: GP2Y0A21_calibration.cpp
+ *
+ *  Host test of the GP2Y0A21 sensor specific curves
+ *
+ *  The built-in curve 20 mm further away is saved into the EEPROM slots
+ *  0 and 1.  Slot 0 is loaded without a table and slot 1 with one.  For
+ *  every ADC value 0 .. 1023
+ *  - Sensor 0 must give the run time interpolation of the saved curve
+ *  - Sensor 1 must be within 6 mm of it under 1 m and 30 mm under 3 m
+ *  - Sensor 2, which has no curve, and sensor 1 after clearing its slot
+ *    must give the built-in curve
+ *
+ *      ./GP2Y0A21_calibration          (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <GP2Y0A21.h>
+#include <stdio.h>
+
+#define POINTS      70
+#define STEP        10
+
+int16_t curve[POINTS];
+int16_t table[GP2Y0A21_TABLEPOINTS];
+
+int16_t interpolatedDistance(int16_t sensorReading) {
+    if (sensorReading < STEP) return curve[0];
+    int16_t     major   = sensorReading / STEP;
+    int16_t     minor   = sensorReading % STEP;
+    if (major + 1 > POINTS - 1) return curve[POINTS - 1];
+    return curve[major] - (int32_t) minor * (curve[major] - curve[major + 1]) / STEP;
+}
+
+int main() {
+    uint16_t    errors      = 0;
+    int16_t     worst       = 0;    // [mm] table against the curve under 3 m
+
+    for (uint8_t i=0;i<POINTS;i++) curve[i] = GP2Y0A21distance(i * STEP) + 20;
+    bool        saved       = GP2Y0A21saveCalibration(0, curve, POINTS, STEP)
+                           && GP2Y0A21saveCalibration(1, curve, POINTS, STEP)
+                           && GP2Y0A21loadCalibration(0)
+                           && GP2Y0A21loadCalibration(1, table);
+    if (!saved) errors++;
+    for (int16_t i=0;i<1024;i++) {
+        int16_t     expected    = interpolatedDistance(i);
+        int16_t     fromTable   = GP2Y0A21distance(i, 1);
+        int16_t     difference  = abs(fromTable - expected);
+        bool        error       = (GP2Y0A21distance(i, 0) != expected)
+                               || (GP2Y0A21distance(i, 2) != GP2Y0A21distance(i))
+                               || ((expected < 1000) && (difference > 6))
+                               || ((expected < 3000) && (difference > 30));
+        if ((expected < 3000) && (difference > worst)) worst = difference;
+        if (error && (errors++ < 20)) {
+            printf("%d\t%d\t%d\t%d\n", i, expected, GP2Y0A21distance(i, 0), fromTable);
+        }
+    }
+    GP2Y0A21clearCalibration(1);
+    for (int16_t i=0;i<1024;i++) {
+        if (GP2Y0A21distance(i, 1) != GP2Y0A21distance(i)) errors++;
+    }
+    fprintf(stderr, "1024 ADC values, table within %d mm under 3 m, %u errors%s\n",
+        worst, errors, errors? "  FAIL": "");
+    return errors? 1: 0;
+}
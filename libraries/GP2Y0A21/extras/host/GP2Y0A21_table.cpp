@@ -0,0 +1,57 @@
+/**
+ *  File: GP2Y0A21_table.cpp
+ *
+ *  Host test of the GP2Y0A21 flash table against the run time interpolation
+ *
+ *  The table is generated at compile time (SharpCurve.h).  Every ADC value
+ *  0 .. 1023 must give the same distance as the earlier library code,
+ *  which interpolated the odsCurve table at run time (copied below from
+ *  the example GP2Y0A21_compare).  Without a stored calibration the sensor
+ *  specific conversion must give the same distances too.
+ *
+ *      ./GP2Y0A21_table                (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <GP2Y0A21.h>
+#include <stdio.h>
+
+#define ARRSIZE 70
+#define ARRSIZE_1 (ARRSIZE - 1)
+
+int16_t odsCurve[ARRSIZE] = {
+    4227, 3362, 2672, 2132, 1717, 1402, 1162, 977, 832, 716, 623, 548, 488, 440,
+    402, 372, 348, 328, 310, 293, 278, 264, 251, 239, 228, 218, 209, 201,
+    194, 187, 180, 174, 168, 162, 156, 151, 146, 141, 137, 133, 129, 125,
+    122, 119, 116, 113, 110, 107, 104, 101, 98, 95, 92, 90, 88, 86,
+    84, 82, 80, 78, 76, 74, 72, 71, 70, 69, 68, 67, 66, 65};
+
+int16_t interpolatedDistance(int16_t sensorReading) {
+    int16_t    major = sensorReading / 10;
+    int16_t    minor = sensorReading % 10;
+
+    if (major + 1 > ARRSIZE_1) return odsCurve[ARRSIZE_1];
+    if (major < 1) return odsCurve[0];
+
+    int16_t    v1 = odsCurve[major];
+    int16_t    v2 = odsCurve[major +1];
+
+    return v1 - minor*(v1 - v2) / 10;
+}
+
+int main() {
+    uint16_t    errors      = 0;
+    for (uint8_t s=0;s<GP2Y0A21_SENSORS;s++) GP2Y0A21loadCalibration(s);
+    for (int16_t i=0;i<1024;i++) {
+        int16_t     expected    = interpolatedDistance(i);
+        bool        error       = GP2Y0A21distance(i) != expected;
+        for (uint8_t s=0;s<GP2Y0A21_SENSORS;s++) {
+            if (GP2Y0A21distance(i, s) != expected) error = true;
+        }
+        if (error && (errors++ < 20)) {
+            printf("%d\t%d\t%d\t%d\n", i, expected, GP2Y0A21distance(i), GP2Y0A21distance(i, 0));
+        }
+    }
+    fprintf(stderr, "1024 ADC values, %u differences%s\n", errors, errors? "  FAIL": "");
+    return errors? 1: 0;
+}
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""
+Fit a GP2Y0A21 calibration curve to logged (ADC reading, reference distance) pairs.
+
+The log is the Serial Monitor output of the GP2Y0A21_calibrate example:
+one pair per line, separated by a tab.  Other lines are ignored.
+
+    python3 odsfit.py [--points 70] [--step 10] log1.txt [log2.txt ...]
+
+For every breakpoint ADC value (0, step, 2 * step, ...) the median distance of
+the readings within half a step is used.  Breakpoints without readings are
+interpolated from their neighbours, or copied from the nearest breakpoint at
+the ends.  The curve must decrease when the ADC value increases, so the
+medians are made monotone with the pool adjacent violators algorithm, where
+each breakpoint is weighted by its number of readings.
+
+The result is printed as a C array to be pasted into GP2Y0A21_calibrate.
+"""
+
+import argparse
+import statistics
+import sys
+
+
+def read_pairs(paths):
+    pairs = []
+    for path in paths:
+        with open(path) as f:
+            for line in f:
+                fields = line.split()
+                if len(fields) != 2:
+                    continue
+                try:
+                    adc, mm = int(fields[0]), int(fields[1])
+                except ValueError:
+                    continue
+                if 0 <= adc <= 1023 and 0 < mm < 9999:
+                    pairs.append((adc, mm))
+    return pairs
+
+
+def bin_medians(pairs, points, step):
+    bins = [[] for _ in range(points)]
+    for adc, mm in pairs:
+        i = (adc + step // 2) // step
+        if i < points:
+            bins[i].append(mm)
+    return [statistics.median(b) if b else None for b in bins], [len(b) for b in bins]
+
+
+def fill_gaps(values):
+    known = [i for i, v in enumerate(values) if v is not None]
+    if not known:
+        sys.exit("No usable readings")
+    filled = list(values)
+    for i in range(len(values)):
+        if filled[i] is not None:
+            continue
+        left = max((k for k in known if k < i), default=None)
+        right = min((k for k in known if k > i), default=None)
+        if left is None:
+            filled[i] = values[right]
+        elif right is None:
+            filled[i] = values[left]
+        else:
+            t = (i - left) / (right - left)
+            filled[i] = values[left] + t * (values[right] - values[left])
+    return filled
+
+
+def monotone_decreasing(values, weights):
+    """Pool adjacent violators for a non-increasing fit."""
+    blocks = []                         # [mean, weight, count]
+    for v, w in zip(values, weights):
+        blocks.append([v, max(w, 1), 1])
+        while len(blocks) > 1 and blocks[-2][0] < blocks[-1][0]:
+            v2, w2, n2 = blocks.pop()
+            v1, w1, n1 = blocks.pop()
+            blocks.append([(v1 * w1 + v2 * w2) / (w1 + w2), w1 + w2, n1 + n2])
+    result = []
+    for mean, _, count in blocks:
+        result.extend([mean] * count)
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--points", type=int, default=70, help="breakpoints, 2 .. 70")
+    parser.add_argument("--step", type=int, default=10, help="ADC counts between breakpoints")
+    parser.add_argument("logs", nargs="+")
+    args = parser.parse_args()
+    if not 2 <= args.points <= 70 or args.step < 1:
+        sys.exit("Invalid points or step")
+
+    pairs = read_pairs(args.logs)
+    medians, counts = bin_medians(pairs, args.points, args.step)
+    curve = monotone_decreasing(fill_gaps(medians), counts)
+    curve = [int(round(v)) for v in curve]
+
+    print("// %d readings, %d of %d breakpoints measured"
+          % (len(pairs), sum(1 for c in counts if c), args.points))
+    print("#define CURVEPOINTS %d" % args.points)
+    print("#define CURVESTEP   %d" % args.step)
+    print("int16_t curve[CURVEPOINTS] = {")
+    for i in range(0, len(curve), 14):
+        row = ", ".join(str(v) for v in curve[i:i + 14])
+        print("    " + row + ("," if i + 14 < len(curve) else "};"))
+
+
+if __name__ == "__main__":
+    main()
@@ -4,8 +4,10 @@
 
 /**
  * Support for an array of sonar sensors using HC_SR04 type
- * interface.  Max array size is is restricted to 7 due to the
- * layout of the Mega Sensor Shield (pin 50 is in "wrong" place)
+ * interface.  The wiring is selected at compile time in HC_SR04_PinMap.h.
+ * The default map is the Wissahickon Rover wiring, which is restricted
+ * to 7 sensors due to the layout of the Mega Sensor Shield (pin 50 is
+ * in "wrong" place)
  *
  * Platform: Arduino Mega 2560
  * - Port K Pin Change interrupt,for Echo inputs (pins A8 - A14)
@@ -13,6 +15,12 @@
  *    is used for SD_MISO signal and is in "wrong" place.
  * - Timer  2 Comparator A for trigger delay
  * - Pins 43, 44, 45, 46, 47, 48, and  49 for Trigger outputs
+ *
+ * Other pin maps can use any trigger pins and echo pins on all three
+ * pin change interrupt banks (PCINT0, PCINT1, and PCINT2), up to 32 sensors.
+ * - The trigger and echo pins are resolved once to (port, mask) pairs,
+ *   so the interrupt cost per sample does not depend on the number of sensors
+ * - The pin change interrupts only check the echo level of the current channel
  * 
  * This library is used in the Ultrasonic Sensors on Wissahickon Rover.
  * The implementation code is described a blog post at
@@ -25,6 +33,8 @@
  * - After completing a measurement in one channel, allow extra time
  *   > to avoid detecting echoes from previous channel
  * - Generate a 10 us long triggering pulse
+ *   > Here the pulse is one timer tick, 16 us.  It is started and ended in
+ *     two compare B interrupts, so the interrupt does not wait for it
  * - Wait for detection of rising edge in the echo pulse
  * - Wait for detection of falling edge in the echo pulse
  * - The duration of the echo pulse is calculated in us
@@ -45,14 +55,75 @@
  * - The practical minimum distance with the HC-SR04 sensor is 17 mm   
  *   > With 100 us duration, the distance is 17.015 mm
  * - If the rising or falling edge is not detected in 30 ms, the channel is skipped  
+ * - readSensor() averages the middle 3 of the last 5 readings.  It returns 0,
+ *   no data, until all 5 are measured after the start or setMaxRange(), and for
+ *   a channel that is not selected
+ *
+ * Temperature compensation
+ * - The speed of sound changes 0.606 m/s per C, which is 303 nm/us per C for
+ *   the round trip.  340.3 m/s is used as the speed at 20 C (setTemperature)
+ * - The division is done once when the temperature is set.  A scaled reciprocal
+ *   replaces the 32 bit multiply and divide in readSensor
+ *
+ *      distance in mm = duration in us * mmScale >> 16
+ *      mmScale        = nm/us * 65536 / 1000,000 = 11151 at 20 C
+ *
+ *   > At 20 C the result differs from the formula above by at most 1 mm
+ *   > With 22 ms duration and 60 C the product is 22000 * 11945 = 262,790,000
+ *
+ * Range gating
+ * - Each channel can have its own maximum range (setMaxRange)
+ * - The range is converted into the maximum echo duration for the channel
+ *   > Ranges over 3.7 m are clamped to 3.7 m, the practical maximum
+ * - If the falling edge is not detected within that duration, the channel is
+ *   reported as clear (HC_SR04_CLEAR) and the next channel is started immediately
+ *   > Timer 2 is restarted at the rising edge to end the measurement window
+ *   > Gates longer than the 8 bit timer range (255 * 16 us = 4 ms, about 690 mm)
+ *     are timed in pieces of up to 255 ticks, counted down in the compare A interrupt
+ *   > The timer is cleared for every trigger, so the channel isolation is the full
+ *     1.6 ms also after an echo that ended before its gate
+ * - A side sensor gated to 500 mm is done in about 4.5 ms instead of up to 24 ms
+ * - The echo pin level is checked in the pin change interrupt, because the echo
+ *   of a gated channel can still be active while the next channel is measured
+ *
+ * Echo timestamps
+ * - The default source is micros(), which has 4 us resolution
+ * - Timer 5 can be used instead as a free running 16 bit counter with 0.5 us ticks
+ *   > The overflow interrupt extends the counter to 32 bits
+ *   > A pending overflow is accounted when the counter is read inside an interrupt
+ *   > Timer 5 is then not available for Servo library or PWM on pins 44 - 46
+ * - The echo width is rounded to us in both cases, so the readings are the same
+ * - jitter() shows the spread of the filter window (max - min) to compare the sources
+ *
+ * Scan health
+ * - Each channel has counters for the outcome of every measurement
+ * - The counters are 16 bit increments in the interrupt routines
+ * - stats() copies the counters with interrupts disabled and adds the sample
+ *   rate since resetStats() and the latest scan period
+ *   > The rate adds the 16 bit difference since the previous stats() into a
+ *     32 bit total, so it stays right after the counters wrap if stats() is
+ *     called at least once per 65535 samples of the channel
+ * - A rising edge timeout is counted in the timer interrupt.  A missing
+ *   falling edge has no timer without a range gate, and it is counted when
+ *   readSensor() finds the channel waiting for over 30 ms
+ *
+ * Sample stream
+ * - Every stored reading is also pushed as (channel, width, time) into a ring
+ *   buffer of 16 samples.  The ISR is the only writer of the head index and
+ *   readSample() is the only writer of the tail index, so no locking is needed
+ * - If the ring is full, the new sample is not stored and overflows() is increased
+ * - A callback can be attached to each channel.  It is called in the interrupt
+ *   routine and must be short
+ * - With Timer 5 timestamps the sample time wraps around after 35 minutes
  */
 
 #include "HC_SR04.h"
+#include "HC_SR04_PinMap.h"
 
 //----------------------------------------------- Constants ----------------------------
 
 /*
- *  Arduino Mega 2560 Timer 2
+ *  Arduino Mega 2560 Timer 2 (or timer HC_SR04_TIMER)
  *  - 8 bit counter
  *  - Use 256 prescaler, 16,000,000 / 256 = 62,500
  *    > Clock frequency is 62.5 kHz
@@ -62,8 +133,26 @@
  *    > Mode 2 (binary 010) is stored in TCCR2B bit WGM2 and TCCR2A bits WGM1 and WGM0
  *  - Use Timer/Counter2 Output Compare Match A Interrupt Enable
  *    > The mask is stored in TIMSK2 register bit OCIE2A
+ *
+ *  The 16 bit timers 1, 3, and 4 have the same interrupts, but
+ *  - The 256 prescaler code is 4 (binary 100)
+ *  - CTC is mode 4 (binary 0100) with bit WGMn2 in TCCRnB
  */
 
+#define   TIMERCAT(a, b)        a ## b
+#define   TIMERREG(a, b)        TIMERCAT(a, b)
+#define   TIMERREG3(a, b, c)    TIMERREG(TIMERREG(a, b), c)
+
+#define   TCCRxA        TIMERREG3(TCCR, HC_SR04_TIMER, A)
+#define   TCCRxB        TIMERREG3(TCCR, HC_SR04_TIMER, B)
+#define   OCRxA         TIMERREG3(OCR,  HC_SR04_TIMER, A)
+#define   OCRxB         TIMERREG3(OCR,  HC_SR04_TIMER, B)
+#define   TCNTx         TIMERREG(TCNT,  HC_SR04_TIMER)
+#define   TIMSKx        TIMERREG(TIMSK, HC_SR04_TIMER)
+#define   TIMERx_COMPA  TIMERREG3(TIMER, HC_SR04_TIMER, _COMPA_vect)
+#define   TIMERx_COMPB  TIMERREG3(TIMER, HC_SR04_TIMER, _COMPB_vect)
+
+#if HC_SR04_TIMER == 2
                         // See 2560 datasheet section 20.10.2 for TCCR2B
 #define   TIMERSTART    (1 << CS22) | (1 << CS21) | (0 << CS20)
 #define   TIMERSTOP     0
@@ -72,21 +161,62 @@
                         //  Wave Generation Mode 010 = Clear Timer on Compare
                         //  Note: Only OCR2A is used for CTC
 #define   TIMERCTCMODE  (1 << WGM21) | (0 << WGM20)
-                        // OCR2B is for channel isolation, OCR2A is for sensor detection
-#define   TIMERINTENA   (1 << OCIE2A) | (1 << OCIE2B)
+#define   TIMERMAXTICKS 0xFF
+#elif (HC_SR04_TIMER == 1) || (HC_SR04_TIMER == 3) || (HC_SR04_TIMER == 4)
+                        // See 2560 datasheet section 17.11 for TCCRnA and TCCRnB
+                        //  Wave Generation Mode 0100 = Clear Timer on Compare
+#define   TIMERSTOP     (1 << TIMERREG(WGM, TIMERREG(HC_SR04_TIMER, 2)))
+#define   TIMERSTART    TIMERSTOP | (1 << TIMERREG(CS, TIMERREG(HC_SR04_TIMER, 2)))
+#define   TIMERCTCMODE  0
+#define   TIMERMAXTICKS 0xFFFF
+#else
+#error "HC_SR04_TIMER must be 1, 2, 3, or 4"
+#endif
+                        // OCRxB is for channel isolation, OCRxA is for sensor detection
+#define   TIMERINTENA   (1 << TIMERREG3(OCIE, HC_SR04_TIMER, A)) | \
+                        (1 << TIMERREG3(OCIE, HC_SR04_TIMER, B))
+
+static constexpr HC_SR04Pins pinMap[] = HC_SR04_PINMAP;
+
+#define   MAX_CHANNEL   (sizeof(pinMap) / sizeof(pinMap[0]))
+#define   ALL_CHANNELS  (0xFFFFFFFFUL >> (32 - MAX_CHANNEL))
+
+constexpr bool banksDeclared(uint8_t i) {     // All echo banks are in HC_SR04_PCINT_BANKS
+  return (i >= MAX_CHANNEL) ? true :
+    ((HC_SR04_PCINT_BANKS >> (pinMap[i].echoPcint >> 3)) & 1) && banksDeclared(i + 1);
+}
+
+static_assert(MAX_CHANNEL <= 32, "HC_SR04_PINMAP has more than 32 sensors");
+static_assert(banksDeclared(0), "HC_SR04_PINMAP uses a bank missing from HC_SR04_PCINT_BANKS");
 
-#define   MAX_CHANNEL   7
 #define   FILTER_WINDOW 5
 #define   NMPERMS       170150UL
 #define   NMINMM        1000000UL
+#define   REFTEMP       200       // [0.1 C] NMPERMS is used at 20 C
+#define   NMPERC        303L      // Change of NMPERMS per C
+#define   MINTEMP       -400      // [0.1 C] Temperature range for compensation
+#define   MAXTEMP       600
+#define   MAXRANGE      3700      // [mm] Longer gates are clamped
+#define   RINGSIZE      16        // Must be a power of 2
+#define   RINGMASK      (RINGSIZE - 1)
 #define   MINTIME       100L
 #define   MAXTIME       22000L
 #define   TIMEOUT       30000L
+#define   CLEARTIME     0xFFFF    // Stored reading for an echo beyond the range gate
+#define   ISOLATIONTICKS 100      // Extra delay between channels is 100/62500 = 1.6 ms
+#define   RISETICKS     40        // Timeout for missing sensor (40/62500 = 0.64 ms)
+#define   TRIGTICKS     1         // Trigger pulse is 1/62500 = 16 us
+#define   USPERTICK     16        // Timer runs at 62.5 kHz
+                        // See 2560 datasheet section 17.11.6 for TCCR5B
+#define   TSTIMERSTART  (0 << CS52) | (1 << CS51) | (0 << CS50)
+#define   TSTIMERSTOP   0
+#define   TSTIMERSHIFT  1         // 16,000,000 / 8 = 2 MHz, 2 ticks per us
 
 //---------------------------------------- Enumerations -------------------------------
 enum sState {
   start,
   waitTrigger,
+  triggering,
   waitRisingEdge,
   waitFallingEdge,
   done
@@ -96,47 +226,103 @@ enum sState {
 
 volatile sState     state;                // Each channel goes  through all states
 volatile uint32_t   tTrigger;             // Channel trigering time
-volatile uint32_t   tRise, tFall, dt;     // Measurement of the echo signal width [ms]
+volatile uint32_t   tRise, tFall, dt;     // Measurement of the echo signal width [ticks]
 volatile uint16_t   chNr;                 // Current measurement channel 0..MAX_CHANNEL-1
 
 volatile uint8_t    busyChannel;
 volatile uint8_t    nextSlot[MAX_CHANNEL];
 volatile uint16_t   readings[MAX_CHANNEL][FILTER_WINDOW];
 
-static uint8_t      _selectionMask;
+static uint32_t     _selectionMask;
+
+volatile uint8_t    *trigPort[MAX_CHANNEL]; // Resolved pin map
+uint8_t             trigMask[MAX_CHANNEL];
+volatile uint8_t    *echoPort[MAX_CHANNEL];
+uint8_t             echoMask[MAX_CHANNEL];
+
+uint16_t            gateRange[MAX_CHANNEL]; // Max range [mm], 0 = no gate
+volatile uint16_t   gateTime[MAX_CHANNEL];  // Max echo duration [us], 0 = no gate
+volatile uint16_t   gateTicks[MAX_CHANNEL]; // Same in timer ticks
+volatile uint16_t   gateLeft;             // Gate ticks after the running piece
+volatile bool       gateArmed;            // Timer is timing the range gate
+volatile uint32_t   scanStart, scanDelta; // Measurement of scanning all channels [us]
+
+volatile TimestampSource tsSource = tsMicros;
+volatile uint8_t    tsShift   = 0;        // Timestamp ticks per us as a shift
+volatile uint16_t   tsHigh;               // Timer 5 overflow count
+
+static int16_t      airTemp   = REFTEMP;  // [0.1 C]
+static uint32_t     nmPerUs   = NMPERMS;  // Half of the speed of sound
+static uint16_t     mmScale   = (NMPERMS * 4096 + 31250) / 62500;
+
+static HC_SR04Stats counters[MAX_CHANNEL];  // Updated in the interrupt routines
+static uint32_t     statsStart;             // [ms] time of resetStats
+static uint32_t     sampleTotal[MAX_CHANNEL];   // Valid and clear since resetStats
+static uint16_t     sampleSeen[MAX_CHANNEL];    // Their 16 bit sum at the last stats
+
+static HC_SR04Sample      ring[RINGSIZE];   // Sample stream
+volatile uint8_t          ringHead;         // Next slot to write, only in ISR
+volatile uint8_t          ringTail;         // Next slot to read, only in readSample
+volatile uint16_t         ringOverflows;
+static HC_SR04Callback    callbacks[MAX_CHANNEL];
 
 //---------------------------------------- Forward References ------------------------
 void      startScanning();
 void      startNextChannel();
+uint32_t  timestamp();
+void      initTimestampTimer();
     
 //---------------------------------------- Class Initialization ----------------------
 
-HC_SR04::HC_SR04 (uint8_t selectionMask) {
+volatile uint8_t *echoRegister(uint8_t pcint) {
+  switch (pcint >> 3) {
+    case 0:   return &PINB;
+    case 1:   return (pcint == 8) ? &PINE : &PINJ;
+    default:  return &PINK;
+  }
+}
+
+uint8_t echoBitMask(uint8_t pcint) {
+  if (pcint == 8)       return 1;                       // PCINT8 is PE0
+  if ((pcint >> 3) == 1) return 1 << ((pcint & 7) - 1); // PCINT9 .. is PJ0 ..
+  return 1 << (pcint & 7);
+}
+
+HC_SR04::HC_SR04 (uint32_t selectionMask) {
   uint32_t i,j;
   _selectionMask  = selectionMask;
   for (i=0;i<MAX_CHANNEL;i++) {
-    pinMode(43 + i, OUTPUT);        // Enable triggers
+    uint8_t pin   = pinMap[i].trigPin;
+    pinMode(pin, OUTPUT);           // Enable triggers
+    trigPort[i]   = portOutputRegister(digitalPinToPort(pin));
+    trigMask[i]   = digitalPinToBitMask(pin);
+    echoPort[i]   = echoRegister(pinMap[i].echoPcint);
+    echoMask[i]   = echoBitMask(pinMap[i].echoPcint);
     nextSlot[i] = 0;
+    gateRange[i]  = 0;
+    gateTime[i]   = 0;
+    gateTicks[i]  = 0;
+    callbacks[i]  = 0;
     for (j=0;j<FILTER_WINDOW;j++) {
       readings[i][j] = 0;
     }
   }
   busyChannel = 0xFF;
+  resetStats();
   startScanning();
 }
 
-HC_SR04::HC_SR04 () {
-  HC_SR04((1 << (MAX_CHANNEL + 1)) -1);
+HC_SR04::HC_SR04 () : HC_SR04(ALL_CHANNELS) {
 }
 
 //---------------------------------------------------- Class Methods ---------
 
-void HC_SR04::selectSensors(uint8_t selectionMask) {
+void HC_SR04::selectSensors(uint32_t selectionMask) {
   uint32_t i,j;
   _selectionMask  = selectionMask;
   for (i=0;i<MAX_CHANNEL;i++) {
                                 // Clear the past readings
-    if ((_selectionMask & (1<<i)) == 0) {
+    if ((_selectionMask & (1UL << i)) == 0) {
       for (j=0;j<FILTER_WINDOW;j++) {
         readings[i][j] = 0;
       }
@@ -144,115 +330,389 @@ void HC_SR04::selectSensors(uint8_t selectionMask) {
   }
 }
 
-uint8_t HC_SR04::selectionMask() {
+uint32_t HC_SR04::selectionMask() {
   return _selectionMask;
 }
 
+void applyGate(uint8_t chNr) {
+  uint32_t  us  = 0;
+
+  if ((gateRange[chNr] > 0) && (gateRange[chNr] <= MAXRANGE)) {
+    us = NMINMM * gateRange[chNr] / nmPerUs;  // Convert from mm into us duration
+    if (us >= MAXTIME) us = 0;
+  }
+  uint8_t   sreg  = SREG;
+  cli();                                  // Keep the pair consistent for the ISRs
+  gateTime[chNr]  = us;
+  gateTicks[chNr] = us / USPERTICK;
+  SREG  = sreg;
+}
+
+void HC_SR04::setMaxRange(uint8_t sensorNumber, uint16_t maxRange) {
+  if (sensorNumber >= MAX_CHANNEL) return;
+  if (maxRange > MAXRANGE) maxRange = MAXRANGE; // 1,000,000 * range fits in 32 bits
+  gateRange[sensorNumber] = maxRange;
+  cli();
+  applyGate(sensorNumber);
+  for (uint8_t j=0;j<FILTER_WINDOW;j++) { // Clear the readings of the old gate
+    readings[sensorNumber][j] = 0;
+  }
+  sei();
+}
+
+uint16_t HC_SR04::maxRange(uint8_t sensorNumber) {
+  if (sensorNumber >= MAX_CHANNEL) return 0;
+  return gateTime[sensorNumber] ? gateRange[sensorNumber] : 0;
+}
+
+void HC_SR04::setTemperature(int16_t temperature) {
+  if (temperature < MINTEMP) temperature = MINTEMP;
+  if (temperature > MAXTEMP) temperature = MAXTEMP;
+  airTemp = temperature;
+  nmPerUs = NMPERMS + NMPERC * (airTemp - REFTEMP) / 10;
+                                          // 65536 / 1000,000 = 4096 / 62500
+  mmScale = (nmPerUs * 4096 + 31250) / 62500;
+  for (uint8_t i=0;i<MAX_CHANNEL;i++) {   // Gates have the same range in mm
+    applyGate(i);
+  }
+}
+
+int16_t HC_SR04::temperature() {
+  return airTemp;
+}
+
+uint32_t HC_SR04::scanTime() {
+  uint32_t  t;
+  cli();
+  t = scanDelta;
+  sei();
+  return t;
+}
+
+void HC_SR04::setTimestampSource(TimestampSource source) {
+  cli();
+  tsSource  = source;
+  tsShift   = (source == tsTimer5) ? TSTIMERSHIFT : 0;
+  if (source == tsTimer5) initTimestampTimer();
+  else                    TCCR5B = TSTIMERSTOP;
+  if (state == waitFallingEdge) {               // Rising edge has the old units
+    startNextChannel();
+  }
+  sei();
+}
+
+TimestampSource HC_SR04::timestampSource() {
+  return tsSource;
+}
+
+uint16_t HC_SR04::jitter(uint8_t sensorNumber) {
+  uint16_t  x,min,max;
+
+  if (sensorNumber >= MAX_CHANNEL) return 0;
+  min = CLEARTIME;
+  max = 0;
+  for (uint8_t j=0;j<FILTER_WINDOW;j++) {
+    x = readings[sensorNumber][j];
+    if ((x == 0) || (x == CLEARTIME)) continue; // Not a measured echo
+    if (x < min) min = x;
+    if (x > max) max = x;
+  }
+  return (max < min) ? 0 : max - min;
+}
+
+void HC_SR04::stats(uint8_t sensorNumber, HC_SR04Stats *snapshot) {
+  if (sensorNumber >= MAX_CHANNEL) return;
+  cli();
+  *snapshot = counters[sensorNumber];
+  snapshot->scanTime  = scanDelta;
+  sei();
+  uint16_t  samples = snapshot->valid + snapshot->clear;    // Wraps with the counters
+  sampleTotal[sensorNumber] += (uint16_t) (samples - sampleSeen[sensorNumber]);
+  sampleSeen[sensorNumber]  = samples;
+  uint32_t  total   = sampleTotal[sensorNumber];
+  uint32_t  elapsed = millis() - statsStart;
+  if (elapsed == 0)           snapshot->sampleRate = 0;
+  else if (elapsed < 1000000) snapshot->sampleRate = total * 1000UL / elapsed;
+  else                        snapshot->sampleRate = total / (elapsed / 1000);
+}
+
+void HC_SR04::resetStats() {
+  cli();
+  memset(counters, 0, sizeof(counters));
+  memset(sampleTotal, 0, sizeof(sampleTotal));
+  memset(sampleSeen, 0, sizeof(sampleSeen));
+  statsStart = millis();
+  sei();
+}
+
+bool HC_SR04::readSample(HC_SR04Sample *sample) {
+  uint8_t   tail  = ringTail;
+  if (tail == ringHead) return false;     // No new samples
+  *sample   = ring[tail];                 // ISR does not write to the tail slot
+  ringTail  = (tail + 1) & RINGMASK;
+  return true;
+}
+
+uint8_t HC_SR04::available() {
+  return (ringHead - ringTail) & RINGMASK;
+}
+
+uint16_t HC_SR04::overflows() {
+  uint16_t  n;
+  cli();
+  n = ringOverflows;
+  sei();
+  return n;
+}
+
+void HC_SR04::attachCallback(uint8_t sensorNumber, HC_SR04Callback callback) {
+  if (sensorNumber >= MAX_CHANNEL) return;
+  cli();
+  callbacks[sensorNumber] = callback;
+  sei();
+}
+
+uint16_t HC_SR04::toMillimeters(uint16_t width) {
+  if (width == CLEARTIME) return HC_SR04_CLEAR;
+  return ((uint32_t) width * mmScale) >> 16;
+}
+
 uint32_t HC_SR04::readSensor(uint8_t sensorNumber) {
   uint32_t  i,j;
   uint32_t  x,sum,min,max;
+  uint8_t   clearCount = 0;
+  bool      filling = false;                    // Window not yet full
 
   i = sensorNumber;
-  if ((_selectionMask & (1 << i)) == 0) return 0;
+  if ((_selectionMask & (1UL << i)) == 0) return 0;
   busyChannel = i;
-  x   = readings[i][0];
-  sum = x;
-  min = x;
-  max = x;
-  for (j=1;j<FILTER_WINDOW;j++) {
+  sum = 0;
+  min = CLEARTIME;
+  max = 0;
+  for (j=0;j<FILTER_WINDOW;j++) {
     x = readings[i][j];
+    if (x == 0) filling = true;
+    if (x == CLEARTIME) {                       // Count beyond gate as gate time
+      clearCount++;
+      x = gateTime[i];
+    }
     sum += x;
     if (x < min) min = x;
     if (x > max) max = x;
   }  
   busyChannel = 0xFF;
-  if ((micros() - tRise) > TIMEOUT) {           // Missing reply from a sensor
-    tRise = micros();                           // Prevent multiple recoveries
+  uint8_t   sreg  = SREG;
+  cli();                                        // timestamp() expects no interrupts
+  uint32_t  now   = timestamp();
+                                                // Missing falling edge.  The other
+                                                //  states are ended by the timer
+  if ((state == waitFallingEdge) && (((now - tRise) >> tsShift) > TIMEOUT)) {
+    counters[chNr].fallTimeouts++;
     startNextChannel();
   }
+  SREG  = sreg;
+  if (filling) return 0;
+  if (clearCount > FILTER_WINDOW / 2) return HC_SR04_CLEAR;
                                                 // Calculate average duration in us
   uint32_t  aveTime     = (sum - min - max) / (FILTER_WINDOW - 2);
-  uint32_t  nanoMeters  = NMPERMS * aveTime;    // Convert from us duration into nm
-  uint32_t  milliMeters = nanoMeters / NMINMM;  // Convert from nm into mm
+  uint32_t  milliMeters = (aveTime * mmScale) >> 16; // Scaled reciprocal of nm in mm
   return milliMeters; 
 }
 
 //---------------------------------------- Initialization -----------------------------
 
 void initPinChangeInterrupts() {
-  PCICR     |= (1 << 2);      // Enable Pin-Change Interrupt for port K bits
-                              // Enable input pins PK0, PK1, .. PK (MAX_CHANNEL-1)
-                              // No extra interrupt pins are allowed
-  PCMSK2    = 0xFFFF ^ (0xFFFF << MAX_CHANNEL);
+  static volatile uint8_t * const pcmsk[] = {&PCMSK0, &PCMSK1, &PCMSK2};
+  for (uint8_t i=0;i<MAX_CHANNEL;i++) {
+    uint8_t bank  = pinMap[i].echoPcint >> 3;
+    PCICR         |= (1 << bank);   // Enable Pin-Change Interrupt for the bank
+                                    // Enable the echo input pin in the bank
+    *pcmsk[bank]  |= (1 << (pinMap[i].echoPcint & 7));
+  }
 }
 
 void initTriggerDelayTimer() {
-  cli();                      // Clear interrupts when setting timer2 (not really required)
-  TCCR2A    = TIMERCTCMODE;   // Only the TCT bit is set
-  OCR2B     = 100;            // Extra delay between channels is 100/62500 = 1.6 ms
-  OCR2A     = OCR2B + 40;     // Timeout for missing sensor (40/62500 = 0.64 ms
-  TIMSK2    |= TIMERINTENA;   // Timer interrupt enable
-  TCCR2B    = TIMERSTART;     // Start Timer 2 for the first reading
+  cli();                      // Clear interrupts when setting timer (not really required)
+  TCCRxA    = TIMERCTCMODE;   // Only the TCT bit is set
+  TCCRxB    = TIMERSTOP;
+  OCRxB     = ISOLATIONTICKS; // Extra delay between channels is 100/62500 = 1.6 ms
+  OCRxA     = ISOLATIONTICKS + RISETICKS; // Timeout for missing sensor (40/62500 = 0.64 ms
+  TIMSKx    |= TIMERINTENA;   // Timer interrupt enable
+  TCCRxB    = TIMERSTART;     // Start the timer for the first reading
   sei();
 }
 
+void initTimestampTimer() {
+  TCCR5A    = 0;              // Normal mode, free running 0 .. 0xFFFF
+  TCCR5B    = TSTIMERSTOP;
+  TCNT5     = 0;
+  tsHigh    = 0;
+  TIFR5     = (1 << TOV5);    // Clear a pending overflow
+  TIMSK5    |= (1 << TOIE5);  // Overflow interrupt extends the counter
+  TCCR5B    = TSTIMERSTART;
+}
+
 void startScanning() {
   chNr  = 0;
+  state = waitTrigger;
+  scanStart = micros();
+  scanDelta = 0;
   initPinChangeInterrupts();
   initTriggerDelayTimer();    // This will trigger the first probe
 }
 
 //----------------------------------------- Scheduling ----------------------------
 
+uint32_t timestamp() {        // Call with interrupts disabled
+  if (tsSource == tsMicros) return micros();
+  uint16_t  lo  = TCNT5;
+  uint16_t  hi  = tsHigh;
+  if ((TIFR5 & (1 << TOV5)) && (lo < 0x8000)) hi++;   // Overflow not yet served
+  return ((uint32_t) hi << 16) | lo;
+}
+
 void scheduleTrigger() {
-  state   = waitTrigger;
-  TCCR2B  = TIMERSTART;      // Schedule next trigger
+  state     = waitTrigger;
+  gateArmed = false;
+  TCNTx     = 0;              // Full isolation, also when a gate was running
+  OCRxB     = ISOLATIONTICKS; // Restore the trigger start
+  OCRxA     = ISOLATIONTICKS + RISETICKS; // Restore the rising edge timeout
+  TCCRxB    = TIMERSTART;    // Schedule next trigger
 }
 
 void startNextChannel() {
+  uint16_t  prevNr = chNr;
   if (_selectionMask == 0){ // If none selected, keep reading 0 channel
     chNr = 0;
   } else {                  // Find next selected channel
     for (uint8_t i=0;i<MAX_CHANNEL;i++) {
       if (++chNr >= MAX_CHANNEL) chNr = 0;
-      if (_selectionMask & (1 << chNr)) break;
+      if (_selectionMask & (1UL << chNr)) break;
     }
-  }                                      
+  }
+  if (chNr <= prevNr) {     // Wrapped around, all selected channels scanned
+    uint32_t now = micros();
+    scanDelta = now - scanStart;
+    scanStart = now;
+  }
   scheduleTrigger();                      // Start the next reading
 }
 
+void armGate() {              // Time the next piece of the range gate
+  uint16_t  ticks = (gateLeft > TIMERMAXTICKS) ? TIMERMAXTICKS : gateLeft;
+  gateLeft  -= ticks;
+  TCNTx     = 0;
+  OCRxA     = ticks;
+  TCCRxB    = TIMERSTART;
+}
+
+void pushSample(uint16_t value) {
+  HC_SR04Sample latest;
+  uint8_t   head  = ringHead;
+  uint8_t   next  = (head + 1) & RINGMASK;
+
+  latest.channel  = chNr;
+  latest.width    = value;
+  latest.time     = timestamp() >> tsShift;
+  if (next == ringTail) {                 // Ring is full, keep the older samples
+    ringOverflows++;
+  } else {
+    ring[head]  = latest;
+    ringHead    = next;
+  }
+  if (callbacks[chNr]) callbacks[chNr](&latest);
+}
+
+void storeReading(uint16_t value) {
+  pushSample(value);
+  if (chNr == busyChannel) {              // readSensor is filtering this channel
+    counters[chNr].dropped++;
+    return;
+  }
+  if (value == CLEARTIME) counters[chNr].clear++;
+  else                    counters[chNr].valid++;
+                                          // Open the next slot
+  if (++nextSlot[chNr] >= FILTER_WINDOW) nextSlot[chNr] = 0;
+                                          // Store the latest reading there
+  readings[chNr][nextSlot[chNr]]   = value;
+}
+
 //-------------------------------------------- Interrupt Routines ---------------------
 
-ISR(TIMER2_COMPB_vect) {        // TIMER 2 COMPARE B INTERRUPT TO START MEASUREMENT
-  uint8_t   trigPin = 43 + chNr;
-  digitalWrite(trigPin, HIGH);  // Create trigger pulse
-  delayMicroseconds(4);
-  digitalWrite(trigPin, LOW);
-  state     = waitRisingEdge;
-  tTrigger  = micros();
+ISR(TIMERx_COMPB) {             // TIMER COMPARE B INTERRUPT TO START MEASUREMENT
+  if (state == waitTrigger) {   // Start the trigger pulse
+    *trigPort[chNr] |= trigMask[chNr];
+    OCRxB   = ISOLATIONTICKS + TRIGTICKS;
+    state   = triggering;
+  } else if (state == triggering) { // End it one tick later, no waiting here
+    *trigPort[chNr] &= ~trigMask[chNr];
+    state     = waitRisingEdge;
+    tTrigger  = micros();
+  }                             // Else the timer was restarted for a range gate
+}
+
+ISR(TIMER5_OVF_vect) {          // TIMER 5 OVERFLOW FOR 32 BIT TIMESTAMPS
+  tsHigh++;
 }
 
-ISR(TIMER2_COMPA_vect) {        // TIMER 2 COMPARE A INTERRUPT TO DETECT TIMEOUT
-  TCCR2B = TIMERSTOP;           // Stop the timer
+ISR(TIMERx_COMPA) {             // TIMER COMPARE A INTERRUPT TO DETECT TIMEOUT
+  TCCRxB = TIMERSTOP;           // Stop the timer
   if (state == waitRisingEdge) {// Failing or missing sensor
+    counters[chNr].riseTimeouts++;
     startNextChannel();
+  } else if ((state == waitFallingEdge) && gateArmed) {
+    if (gateLeft) {             // Longer than the timer range
+      armGate();
+    } else {
+      storeReading(CLEARTIME);  // Nothing inside the range gate
+      startNextChannel();
+    }
   }
 }
 
-ISR(PCINT2_vect) {              // PORT K PIN CHANGE INTERRUPT (#2)
-  if (state == waitRisingEdge) {
-    tRise   = micros();         // Record the rising time
+void echoChange() {             // Common for all pin change interrupt banks
+  uint8_t   echo  = *echoPort[chNr] & echoMask[chNr];
+  if ((state == waitRisingEdge) && echo) {
+    tRise   = timestamp();      // Record the rising time
     state   = waitFallingEdge;
-  } else if (state == waitFallingEdge) {
-    tFall   = micros();         // Record the falling time
-    dt  = tFall - tRise;        // Calculate echo pulse length in us
-    if ((dt > MINTIME) && (dt < MAXTIME) && (chNr != busyChannel)) {
-                                // Open the next slot
-      if (++nextSlot[chNr] >= FILTER_WINDOW) nextSlot[chNr] = 0;
-                                // Store the latest reading there
-      readings[chNr][nextSlot[chNr]]   = dt;
+    if (gateTicks[chNr]) {      // Restart the timer to end the range gate
+      TCCRxB    = TIMERSTOP;
+      gateLeft  = gateTicks[chNr];
+      gateArmed = true;
+      armGate();
+    }
+  } else if ((state == waitFallingEdge) && !echo) {
+    tFall   = timestamp();      // Record the falling time
+                                // Calculate echo pulse length in us
+    dt  = (tFall - tRise + (tsShift ? 1 : 0)) >> tsShift;
+    if (gateTime[chNr] && (dt > gateTime[chNr])) {
+      storeReading(CLEARTIME);  // Echo from beyond the range gate
+    } else if (dt <= MINTIME) {
+      counters[chNr].tooShort++;
+    } else if (dt >= MAXTIME) {
+      counters[chNr].tooLong++;
+    } else {
+      storeReading(dt);
     }
     startNextChannel();         // Start the next channel
   }
 }
+
+#if HC_SR04_PCINT_BANKS & (1 << 0)
+ISR(PCINT0_vect) {              // PORT B PIN CHANGE INTERRUPT (#0)
+  echoChange();
+}
+#endif
+
+#if HC_SR04_PCINT_BANKS & (1 << 1)
+ISR(PCINT1_vect) {              // PORT E/J PIN CHANGE INTERRUPT (#1)
+  echoChange();
+}
+#endif
+
+#if HC_SR04_PCINT_BANKS & (1 << 2)
+ISR(PCINT2_vect) {              // PORT K PIN CHANGE INTERRUPT (#2)
+  echoChange();
+}
+#endif
 
@@ -7,13 +7,55 @@
 #ifndef HC_SR04_H
 #define HC_SR04_H
 
+#define HC_SR04_CLEAR 9999        // Reading for a channel with no echo inside its range gate
+
+typedef enum timestampSources {
+  tsMicros,                       // micros(), 4 us resolution
+  tsTimer5                        // Free running 16 bit Timer 5, 0.5 us resolution
+} TimestampSource;
+
+typedef struct {                  // Counters wrap around at 65535
+  uint16_t  valid;                // Echoes inside the limits
+  uint16_t  clear;                // Echoes beyond the range gate
+  uint16_t  tooShort;             // Echoes up to 100 us
+  uint16_t  tooLong;              // Echoes from 22 ms
+  uint16_t  riseTimeouts;         // Missing rising edge
+  uint16_t  fallTimeouts;         // Missing falling edge
+  uint16_t  dropped;              // Skipped while readSensor was filtering
+  uint16_t  sampleRate;           // [1/s] valid and clear since resetStats
+  uint32_t  scanTime;             // [us] latest scan of all selected channels
+} HC_SR04Stats;
+
+typedef struct {
+  uint8_t   channel;              // Sensor number
+  uint16_t  width;                // [us] echo width, 0xFFFF = beyond the range gate
+  uint32_t  time;                 // [us] end of the measurement
+} HC_SR04Sample;
+
+typedef void (*HC_SR04Callback)(const HC_SR04Sample *sample);
+
 class HC_SR04 {
   public:
-    HC_SR04   (uint8_t selectionMask);
+    HC_SR04   (uint32_t selectionMask);
     HC_SR04   ();
-    void      selectSensors(uint8_t selectionMask);
-    uint8_t   selectionMask();
+    void      selectSensors(uint32_t selectionMask);
+    uint32_t  selectionMask();
     uint32_t  readSensor(uint8_t sensorNumber);
+    void      setMaxRange(uint8_t sensorNumber, uint16_t maxRange);  // [mm], 0 = no gate
+    uint16_t  maxRange(uint8_t sensorNumber);
+    uint32_t  scanTime();                                           // [us] for all selected
+    void      setTimestampSource(TimestampSource source);
+    TimestampSource timestampSource();
+    uint16_t  jitter(uint8_t sensorNumber);                         // [us] spread in filter
+    void      setTemperature(int16_t temperature);                  // [0.1 C] air temperature
+    int16_t   temperature();
+    void      stats(uint8_t sensorNumber, HC_SR04Stats *snapshot);
+    void      resetStats();
+    bool      readSample(HC_SR04Sample *sample);                    // false if no new samples
+    uint8_t   available();
+    uint16_t  overflows();
+    void      attachCallback(uint8_t sensorNumber, HC_SR04Callback callback);
+    uint16_t  toMillimeters(uint16_t width);
   protected:
 };
 
@@ -0,0 +1,56 @@
+/**
+ *  Compile time configuration of the HC_SR04 sensor array
+ *
+ *  - HC_SR04_TIMER selects the timer for the trigger delay and timeouts
+ *    > 2 is the 8 bit timer used on Wissahickon Rover
+ *    > 1, 3, or 4 selects a 16 bit timer in CTC mode with the same 16 us tick
+ *    > Timer 5 is reserved for the echo timestamps
+ *    > Vnh2sp30 uses timers 1, 3, and 4 for its 20 kHz PWM on their pins.
+ *      On Wissahickon Rover the motor PWM pins 5 and 6 are on timers 3 and 4,
+ *      so 3 and 4 must not be used there
+ *  - HC_SR04_PINMAP selects the wiring
+ *    > Every entry is a trigger pin and the PCINT number of the echo pin
+ *    > PCINT 0 - 7 are pins 53, 52, 51, 50, 10, 11, 12, 13 (Port B)
+ *    > PCINT 8 - 10 are pins 0, 15, 14 (Port E and J)
+ *    > PCINT 16 - 23 are pins A8 - A15 (Port K)
+ *  - HC_SR04_PCINT_BANKS has a bit for each pin change interrupt used by the map
+ *    > Only those interrupt vectors are defined by the library
+ *
+ *  Edit the defaults below or define the values before this file is included
+ *  by HC_SR04.cpp (for example with compiler flags)
+ */
+
+#ifndef HC_SR04_PINMAP_H
+#define HC_SR04_PINMAP_H
+
+#include <Arduino.h>
+
+typedef struct {
+  uint8_t   trigPin;              // Any digital output pin
+  uint8_t   echoPcint;            // PCINT number of the echo input
+} HC_SR04Pins;
+
+                                  // Wissahickon Rover, Mega Sensor Shield
+                                  //  Triggers 43 - 49, echoes A8 - A14
+#define HC_SR04_PINMAP_WH_ROVER { \
+  {43, 16}, {44, 17}, {45, 18}, {46, 19}, {47, 20}, {48, 21}, {49, 22} }
+#define HC_SR04_BANKS_WH_ROVER  (1 << 2)
+
+                                  // 16 sensors on Port K and Port B
+                                  //  Triggers 26 - 33 and 38 - 45
+                                  //  Port B is also SPI, so no SD card
+#define HC_SR04_PINMAP_16 { \
+  {26, 16}, {27, 17}, {28, 18}, {29, 19}, {30, 20}, {31, 21}, {32, 22}, {33, 23}, \
+  {38,  0}, {39,  1}, {40,  2}, {41,  3}, {42,  4}, {43,  5}, {44,  6}, {45,  7} }
+#define HC_SR04_BANKS_16        ((1 << 2) | (1 << 0))
+
+#ifndef HC_SR04_TIMER
+#define HC_SR04_TIMER           2
+#endif
+
+#ifndef HC_SR04_PINMAP
+#define HC_SR04_PINMAP          HC_SR04_PINMAP_WH_ROVER
+#define HC_SR04_PCINT_BANKS     HC_SR04_BANKS_WH_ROVER
+#endif
+
+#endif
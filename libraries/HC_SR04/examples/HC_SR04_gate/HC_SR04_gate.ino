@@ -0,0 +1,45 @@
+/**
+ * Demonstrate the effect of range gating on the HC_SR04 scan period
+ *  - 6 sensors, numbered 0 .. 5, wired as in HC_SR04_demo
+ *  - The same gate is applied to all sensors for 2 seconds at the time
+ *  - The scan period is averaged over the last second of each step
+ *
+ *  Use Serial Monitor to see the results
+ *    gate    maximum range in mm (0 = no gate)
+ *    scan    average time to scan all 6 sensors in us
+ *    FF      reading of the front sensor in mm (9999 = clear)
+ */
+
+#include <HC_SR04.h>
+
+#define   CHCOUNT   6
+
+uint16_t  gates[] = {0, 2000, 1000, 500, 300};
+
+HC_SR04   uss(0x3F);              // Scan all 6 sensors
+
+void setup() {
+  Serial.begin(230400);
+  Serial.println("gate\tscan\tFF");
+}
+
+void loop() {
+  for (uint8_t g=0;g<sizeof(gates)/sizeof(gates[0]);g++) {
+    for (uint8_t chNr=0;chNr<CHCOUNT;chNr++) {
+      uss.setMaxRange(chNr,gates[g]);
+    }
+    delay(1000);                  // Let the filters settle
+
+    uint32_t  sum   = 0;
+    uint16_t  count = 0;
+    for (uint16_t i=0;i<100;i++) {
+      sum += uss.scanTime();
+      count++;
+      delay(10);
+    }
+    Serial.print(gates[g]);       Serial.print('\t');
+    Serial.print(sum / count);    Serial.print('\t');
+    Serial.print(uss.readSensor(1));
+    Serial.println();
+  }
+}
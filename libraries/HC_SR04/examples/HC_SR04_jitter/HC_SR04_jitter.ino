@@ -0,0 +1,44 @@
+/**
+ * Compare the echo timestamp sources of HC_SR04
+ *  - Point the front sensor (FF, channel 1) to a fixed flat target
+ *  - The sources are swapped every 5 seconds
+ *  - The jitter is the spread (max - min) of the 5 latest echo widths in us
+ *    > 1 us of echo width is about 0.17 mm of distance
+ *
+ *  Use Serial Monitor to see the statistics for each source
+ *    src     0 = micros(), 1 = Timer 5
+ *    mm      latest reading
+ *    ave     average jitter [us]
+ *    max     maximum jitter [us]
+ */
+
+#include <HC_SR04.h>
+
+#define   CHANNEL   1
+
+HC_SR04   uss(1 << CHANNEL);      // Scan only the front sensor
+
+void setup() {
+  Serial.begin(230400);
+  Serial.println("src\tmm\tave\tmax");
+}
+
+void loop() {
+  TimestampSource source = (uss.timestampSource() == tsMicros) ? tsTimer5 : tsMicros;
+  uss.setTimestampSource(source);
+  delay(500);                     // Refill the filter window
+
+  uint32_t  sum     = 0;
+  uint16_t  maxJit  = 0;
+  for (uint16_t i=0;i<450;i++) {
+    uint16_t  jit = uss.jitter(CHANNEL);
+    sum += jit;
+    if (jit > maxJit) maxJit = jit;
+    delay(10);
+  }
+  Serial.print(source);                 Serial.print('\t');
+  Serial.print(uss.readSensor(CHANNEL));Serial.print('\t');
+  Serial.print(sum / 450);              Serial.print('\t');
+  Serial.print(maxJit);
+  Serial.println();
+}
@@ -0,0 +1,47 @@
+/**
+ * Demonstrate the sample stream of HC_SR04
+ *  - 6 sensors, numbered 0 .. 5, wired as in HC_SR04_demo
+ *  - Only new samples are processed, each of them exactly once
+ *  - A callback on the front sensor turns on the LED for close objects
+ *
+ *  Use Serial Monitor to see the samples
+ *    time    [us] end of the measurement
+ *    ch      sensor number
+ *    mm      distance (9999 = clear)
+ *  and the number of lost samples, if the loop is too slow
+ */
+
+#include <HC_SR04.h>
+
+#define   LED       13
+#define   CLOSE     300           // [mm] Distance to turn on the LED
+
+HC_SR04   uss(0x3F);              // Scan all 6 sensors
+uint16_t  lostSamples;
+
+void frontSample(const HC_SR04Sample *sample) {
+  digitalWrite(LED, uss.toMillimeters(sample->width) < CLOSE);
+}
+
+void setup() {
+  Serial.begin(230400);
+  Serial.println("time\tch\tmm");
+  pinMode(LED, OUTPUT);
+  uss.attachCallback(1, frontSample);
+  lostSamples = 0;
+}
+
+void loop() {
+  HC_SR04Sample sample;
+
+  while (uss.readSample(&sample)) {
+    Serial.print(sample.time);                      Serial.print('\t');
+    Serial.print(sample.channel);                   Serial.print('\t');
+    Serial.print(uss.toMillimeters(sample.width));  Serial.println();
+  }
+  if (uss.overflows() != lostSamples) {
+    lostSamples = uss.overflows();
+    Serial.print("lost ");
+    Serial.println(lostSamples);
+  }
+}
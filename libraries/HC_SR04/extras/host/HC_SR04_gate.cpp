@@ -0,0 +1,69 @@
+/**
+ *  File: HC_SR04_gate.cpp
+ *
+ *  Host benchmark of the HC_SR04 scan period against the range gate
+ *
+ *  The seven sensors of the Wissahickon Rover map see a wall at 3 m, and
+ *  the scan of all of them is timed with gates from none to 2.9 m
+ *  (HostSonar.h emulates Timer 2 and the echoes in 1 us steps)
+ *  - Every channel takes the 1.6 ms isolation, the trigger, the echo
+ *    delay, and the echo up to its gate
+ *  - It fails if a reading is not 0, no data, after 2.5 scans of a new
+ *    gate, a scan is not within 5 % of that, or a gated scan is
+ *    not shorter than the ungated one and the shorter gates, or a gated
+ *    reading is not HC_SR04_CLEAR.  The gates over 690 mm need more
+ *    than one period of the 8 bit timer
+ *
+ *      ./HC_SR04_gate seconds      (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <HC_SR04.h>
+#include <HostSonar.h>
+#include <stdio.h>
+
+#define WALL        3000            // [mm] beyond all gates
+#define CHANNELS    7
+#define CHANNELTIME (101 * 16 + HOSTSONAR_DELAY)    // [us] before the echo
+
+HC_SR04     sonar;
+HostSonar   sensors;
+
+static const uint16_t gates[] = {0, 300, 500, 680, 700, 1000, 2000, 2900};   // [mm]
+#define GATES       (sizeof(gates) / sizeof(gates[0]))
+
+int main(int argc, char *argv[]) {
+    uint32_t    seconds     = (argc > 1)? atol(argv[1]): 8;
+    uint32_t    duration    = seconds * 1000000 / GATES;
+    uint32_t    scans[GATES];
+    bool        ok          = true;
+
+    for (uint8_t i=0;i<CHANNELS;i++) sensors.setRange(i, WALL);
+    printf("gate [mm]\tscan [us]\texpected [us]\treading [mm]\n");
+    for (uint8_t g=0;g<GATES;g++) {
+        for (uint8_t i=0;i<CHANNELS;i++) sonar.setMaxRange(i, gates[g]);
+        uint32_t    width       = sensors.width(0);
+        if (gates[g]) width = 1000000UL * gates[g] / HOSTSONAR_NMPERUS;
+        uint32_t    expected    = CHANNELS * (CHANNELTIME + width);
+        sensors.run(expected * 5 / 2);      // Filter window not yet full
+        if (sonar.readSensor(0) != 0) ok = false;
+        sensors.run(duration - expected * 5 / 2);
+        uint32_t    scan        = sonar.scanTime();
+        uint32_t    reading     = sonar.readSensor(0);
+        printf("%u\t%lu\t%lu\t%lu\n", gates[g], (unsigned long) scan,
+            (unsigned long) expected, (unsigned long) reading);
+        if ((scan * 20 < expected * 19) || (scan * 20 > expected * 21)) ok = false;
+        if (g == 0) {
+            if (reading == HC_SR04_CLEAR) ok = false;
+        } else {
+            if (scan >= scans[0]) ok = false;
+            if ((g > 1) && (scan <= scans[g - 1])) ok = false;
+            if (reading != HC_SR04_CLEAR) ok = false;
+        }
+        scans[g]    = scan;
+    }
+    fprintf(stderr, "scan %.1f ms gated to %u mm, %.1f ms to %u mm, %.1f ms ungated%s\n",
+        scans[1] / 1e3, gates[1], scans[GATES - 1] / 1e3, gates[GATES - 1],
+        scans[0] / 1e3, ok? "": "  FAIL");
+    return ok? 0: 1;
+}
@@ -0,0 +1,58 @@
+/**
+ *  File: HC_SR04_scale.cpp
+ *
+ *  Host test of the HC_SR04 width to distance conversion
+ *
+ *  toMillimeters() (and readSensor) multiply the echo width by the scaled
+ *  reciprocal mmScale.  It is compared with the floating point formula
+ *      distance in mm = width in us * (170,150 + 303 * (T - 20 C)) / 1000,000
+ *  for every width from 100 us to 22 ms at every temperature setting
+ *  from -40 C to 60 C in 0.1 C
+ *  - The result is truncated (1 mm), mmScale is rounded to 1/65536 mm/us
+ *    (0.17 mm at 22 ms), and the temperature term to 1 nm/us (0.02 mm),
+ *    so it must be from 1.2 mm under to 0.2 mm over the formula
+ *
+ *      ./HC_SR04_scale                 (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <HC_SR04.h>
+#include <stdio.h>
+
+#define MINWIDTH    100             // [us]
+#define MAXWIDTH    22000
+#define MINTEMP     -400            // [0.1 C]
+#define MAXTEMP     600
+
+HC_SR04     sonar;
+
+int main() {
+    double      under       = 0;    // [mm] worst below and above the formula
+    double      over        = 0;
+    int16_t     underTemp   = 0, overTemp = 0;
+    uint16_t    underWidth  = 0, overWidth = 0;
+
+    for (int16_t t=MINTEMP;t<=MAXTEMP;t++) {
+        sonar.setTemperature(t);
+        double  mmPerUs     = (170150 + 303 * (t - 200) / 10.0) / 1e6;
+        for (uint16_t w=MINWIDTH;w<=MAXWIDTH;w++) {
+            double  error   = sonar.toMillimeters(w) - w * mmPerUs;
+            if (error < under) {
+                under       = error;
+                underTemp   = t;
+                underWidth  = w;
+            }
+            if (error > over) {
+                over        = error;
+                overTemp    = t;
+                overWidth   = w;
+            }
+        }
+    }
+    printf("under %.3f mm at %d.%d C %u us\n", -under, underTemp / 10, abs(underTemp % 10), underWidth);
+    printf("over  %.3f mm at %d.%d C %u us\n", over, overTemp / 10, abs(overTemp % 10), overWidth);
+    bool        ok          = (under > -1.2) && (over < 0.2);
+    fprintf(stderr, "%u widths at %d temperatures, %.3f mm under to %.3f mm over%s\n",
+        MAXWIDTH - MINWIDTH + 1, MAXTEMP - MINTEMP + 1, -under, over, ok? "": "  FAIL");
+    return ok? 0: 1;
+}
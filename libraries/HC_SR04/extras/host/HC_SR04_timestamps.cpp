@@ -0,0 +1,88 @@
+/**
+ *  File: HC_SR04_timestamps.cpp
+ *
+ *  Host test of the two HC_SR04 echo timestamp sources
+ *
+ *  The seven sensors see targets from 150 mm to 3.5 m (HostSonar.h), and
+ *  the sample stream is read with micros() timestamps for the first half
+ *  of the run and with Timer 5 for the second half
+ *  - A width from micros() (4 us resolution) must be within 4 us of the
+ *    emulated width, and a width from Timer 5 (0.5 us) must be exact
+ *  - So the averages of a channel differ by less than a micros() step.
+ *    The echoes of the emulated scan come at the same phase of the 4 us,
+ *    so the rounding error does not average out here
+ *  - The Timer 5 half lasts many overflows of the 16 bit counter, so the
+ *    extension to 32 bits is tested across them
+ *
+ *      ./HC_SR04_timestamps seconds    (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <HC_SR04.h>
+#include <HostSonar.h>
+#include <stdio.h>
+
+#define CHANNELS    7
+
+HC_SR04     sonar;
+HostSonar   sensors;
+
+static const uint16_t ranges[CHANNELS] = {150, 333, 687, 1000, 1999, 2750, 3500}; // [mm]
+
+static const uint8_t tolerance[2] = {4, 0};         // [us] tsMicros, tsTimer5
+
+static uint32_t     samples[2];
+static uint32_t     errors[2];
+static uint32_t     channelSamples[2][CHANNELS];
+static uint32_t     channelTotal[2][CHANNELS];      // [us]
+
+static void readSamples(uint32_t duration, uint8_t source) {     // [us]
+    HC_SR04Sample   sample;
+    for (uint32_t t=0;t<duration;t+=1000) {
+        sensors.run(1000);                  // The ring holds 16 samples
+        while (sonar.readSample(&sample)) {
+            uint32_t    width   = sensors.width(sample.channel);
+            samples[source]++;
+            channelSamples[source][sample.channel]++;
+            channelTotal[source][sample.channel] += sample.width;
+            if (labs((long) sample.width - (long) width) > tolerance[source]) {
+                if (errors[source]++ < 10) {
+                    printf("%s channel %u width %u, not %lu\n",
+                        (source == tsMicros)? "micros": "Timer 5", sample.channel,
+                        sample.width, (unsigned long) width);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t    seconds     = (argc > 1)? atol(argv[1]): 10;
+    uint32_t    half        = seconds * 500000;
+
+    for (uint8_t i=0;i<CHANNELS;i++) sensors.setRange(i, ranges[i]);
+    sonar.setTimestampSource(tsMicros);
+    readSamples(half, tsMicros);
+    sonar.setTimestampSource(tsTimer5);
+    readSamples(half, tsTimer5);
+    bool        ok          = !errors[tsMicros] && !errors[tsTimer5] && !sonar.overflows();
+    double      maxDiff     = 0;
+    for (uint8_t i=0;i<CHANNELS;i++) {
+        if (!channelSamples[tsMicros][i] || !channelSamples[tsTimer5][i]) {
+            ok  = false;
+            continue;
+        }
+        double  diff    = fabs((double) channelTotal[tsMicros][i] / channelSamples[tsMicros][i]
+                             - (double) channelTotal[tsTimer5][i] / channelSamples[tsTimer5][i]);
+        printf("channel %u\t%lu us\tmicros - Timer 5 %.2f us\n", i,
+            (unsigned long) sensors.width(i), diff);
+        if (diff > maxDiff) maxDiff = diff;
+    }
+    if (maxDiff > tolerance[tsMicros]) ok = false;
+    fprintf(stderr, "micros %lu echoes %lu errors, Timer 5 %lu echoes %lu errors, "
+        "averages %.2f us apart%s\n",
+        (unsigned long) samples[tsMicros], (unsigned long) errors[tsMicros],
+        (unsigned long) samples[tsTimer5], (unsigned long) errors[tsTimer5],
+        maxDiff, ok? "": "  FAIL");
+    return ok? 0: 1;
+}
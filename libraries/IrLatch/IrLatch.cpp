@@ -0,0 +1,156 @@
+/**
+ *  File: IrLatch.cpp
+ *
+ *  Snapshot and latching of the eight FC-51 IR collision inputs
+ *
+ *  On the Mega 2560 the IR pins are on two ports
+ *      pins 18, 19, 20, 21     PD3, PD2, PD1, PD0  (INT3 .. INT0)
+ *      pins 22, 23, 24, 25     PA0, PA1, PA2, PA3  (no interrupts)
+ *  The outputs are active low.
+ *
+ *  read() takes PIND and PINA right after each other, so all eight inputs
+ *  are from the same moment, and returns bit 0 for pin 18 ... bit 7 for
+ *  pin 25.  Eight digitalRead() calls would take about 40 us.
+ *
+ *  A short bump between two reads of the application is not lost
+ *  - Pins 18 .. 21 latch on the falling edge in their external interrupts
+ *  - Pins 22 .. 25 are polled in the AdcSampler tick, about every 100 us
+ *    when the sampler is free running, and in every read()
+ *  - The first activation after acknowledge() stores its time in ms
+ *  - latched() returns the bits until acknowledge() clears them.  An input
+ *    that is still active is latched again only on a new activation
+ *
+ *  The latches are shared, so a consumer that reads them periodically,
+ *  like the telemetry or a planner, would see only the first bump after
+ *  an acknowledge() of the application.  Instead each consumer keeps its
+ *  own IrEdges, and activatedSince() returns the inputs that have been
+ *  activated after the previous call with the same IrEdges
+ *  - Every activation counts up an 8 bit edge counter of the input
+ *  - activatedSince() compares the counters to the ones the consumer saw
+ *    last time and copies them, so it is not affected by acknowledge()
+ *  - A zeroed IrEdges before begin() sees all activations.  A call right
+ *    after begin() skips the earlier ones
+ *  - An input would be missed only if it is activated exactly 256 times
+ *    between two calls
+ *
+ *  attachCallback() sets a function that gets the bits of every new
+ *  activation, also when they are already latched.  It is called with
+ *  interrupts disabled, in the pin interrupt, in the ADC tick, or in
+ *  read() and latch(), so it must be short.  WH_Rover uses it to brake
+ *  the motors without waiting for the main loop.
+ */
+
+#include <IrLatch.h>
+#include <AdcSampler.h>
+
+static volatile uint8_t     irLatched;
+static volatile uint8_t     irEdges[IRLATCH_COUNT];     // Activations, wraps around
+static volatile uint8_t     irPrevA;            // Active bits 4 .. 7 at the last poll
+static volatile uint32_t    irTime[IRLATCH_COUNT];
+static IrLatchCallback      irCallback;
+
+static const uint8_t        reverse4[16] = {    // PD3..0 to bits 0..3
+    0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+    0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF};
+
+static void latchBits(uint8_t bits) {           // Interrupts disabled
+    if (bits == 0) return;
+    if (irCallback) irCallback(bits);
+    uint8_t     fresh   = bits & ~irLatched;
+    uint32_t    now     = millis();
+    irLatched   |= bits;
+    for (uint8_t i=0;i<IRLATCH_COUNT;i++) {
+        if (!(bits & (1 << i))) continue;
+        irEdges[i]++;
+        if (fresh & (1 << i)) irTime[i] = now;
+    }
+}
+
+static void edge0() {latchBits(1 << 0);}        // Pin 18, INT3
+static void edge1() {latchBits(1 << 1);}        // Pin 19, INT2
+static void edge2() {latchBits(1 << 2);}        // Pin 20, INT1
+static void edge3() {latchBits(1 << 3);}        // Pin 21, INT0
+
+static void pollA(uint8_t activeA) {            // Interrupts disabled
+    latchBits(activeA & ~irPrevA);
+    irPrevA     = activeA;
+}
+
+void IrLatch::begin() {
+    static void (*const edges[4])(void) = {edge0, edge1, edge2, edge3};
+    for (uint8_t i=0;i<IRLATCH_COUNT;i++) {
+        pinMode(IRLATCH_FIRSTPIN + i, INPUT_PULLUP);
+    }
+    uint8_t sreg    = SREG;
+    cli();
+    irLatched   = 0;
+    irPrevA     = (~PINA & 0x0F) << 4;
+    SREG        = sreg;
+    for (uint8_t i=0;i<4;i++) {
+        attachInterrupt(digitalPinToInterrupt(IRLATCH_FIRSTPIN + i), edges[i], FALLING);
+    }
+    AdcSampler::attachTick(poll);
+}
+
+uint8_t IrLatch::read() {
+    uint8_t d       = PIND;                     // Snapshot
+    uint8_t a       = PINA;
+    uint8_t activeA = (~a & 0x0F) << 4;
+    uint8_t sreg    = SREG;
+    cli();
+    pollA(activeA);
+    SREG    = sreg;
+    return reverse4[~d & 0x0F] | activeA;
+}
+
+uint8_t IrLatch::latched() {
+    return irLatched;
+}
+
+uint32_t IrLatch::latchTime(uint8_t index) {
+    if (index >= IRLATCH_COUNT) return 0;
+    uint8_t     sreg    = SREG;
+    cli();
+    uint32_t    time    = irTime[index];
+    SREG    = sreg;
+    return time;
+}
+
+void IrLatch::acknowledge(uint8_t mask) {
+    uint8_t sreg    = SREG;
+    cli();
+    irLatched   &= ~mask;
+    SREG        = sreg;
+}
+
+uint8_t IrLatch::activatedSince(IrEdges *seen) {
+    uint8_t edges[IRLATCH_COUNT];
+    uint8_t sreg    = SREG;
+    cli();
+    for (uint8_t i=0;i<IRLATCH_COUNT;i++) edges[i] = irEdges[i];
+    SREG    = sreg;
+    uint8_t bits    = 0;
+    for (uint8_t i=0;i<IRLATCH_COUNT;i++) {
+        if (edges[i] != seen->edges[i]) bits |= 1 << i;
+        seen->edges[i]  = edges[i];
+    }
+    return bits;
+}
+
+void IrLatch::latch(uint8_t mask) {
+    uint8_t sreg    = SREG;
+    cli();
+    latchBits(mask);
+    SREG        = sreg;
+}
+
+void IrLatch::poll() {                          // In the ADC interrupt
+    pollA((~PINA & 0x0F) << 4);
+}
+
+void IrLatch::attachCallback(IrLatchCallback callback) {
+    uint8_t sreg    = SREG;
+    cli();
+    irCallback  = callback;
+    SREG        = sreg;
+}
@@ -0,0 +1,28 @@
+#ifndef IRLATCH_H
+#define IRLATCH_H
+
+#include <Arduino.h>
+
+#define IRLATCH_FIRSTPIN    18      // Pins 18 .. 25, bit 0 .. 7
+#define IRLATCH_COUNT       8
+
+typedef void (*IrLatchCallback)(uint8_t bits);
+
+typedef struct {
+    uint8_t     edges[IRLATCH_COUNT];   // Activation counts seen by one consumer
+} IrEdges;
+
+class IrLatch {
+public:
+    static void     begin();                    // Pull-ups, interrupts, and ADC tick
+    static uint8_t  read();                     // Active inputs, one snapshot
+    static uint8_t  latched();                  // Activated since acknowledge
+    static uint32_t latchTime(uint8_t index);   // [ms] of the latch, 0 .. 7
+    static void     acknowledge(uint8_t mask);
+    static uint8_t  activatedSince(IrEdges *seen);  // New activations since the last call with seen
+    static void     latch(uint8_t mask);        // Latch simulated activations
+    static void     poll();                     // Pins 22 .. 25, in the ADC tick
+    static void     attachCallback(IrLatchCallback callback);   // Every activation, in interrupts
+};
+
+#endif
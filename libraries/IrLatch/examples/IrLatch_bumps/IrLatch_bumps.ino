@@ -0,0 +1,55 @@
+/**
+ * Show the IR bumps to two consumers with their own edge counters
+ *  - Eight FC-51 IR sensors on pins 18 .. 25, active low
+ *  - The application acknowledges the latches every 100 ms, as a sketch
+ *    that reacts to the bumps would
+ *  - The "fast" consumer reads every 100 ms and the "slow" one every
+ *    second.  Both see every bump, also the ones that were acknowledged
+ *    before they read
+ *  - AdcSampler runs free, so pins 22 .. 25 are polled every ~100 us
+ *
+ *  Use Serial Monitor to see the active inputs and the bumps as bits,
+ *  bit 0 = pin 18 ... bit 7 = pin 25
+ */
+
+#include <IrLatch.h>
+#include <AdcSampler.h>
+
+IrEdges     fastSeen, slowSeen;
+uint32_t    fastTime, slowTime;
+
+void setup() {
+    Serial.begin(115200);
+    IrLatch::begin();
+    AdcSampler::addChannel(A0);     // The tick runs with sampling
+    AdcSampler::start();
+    IrLatch::activatedSince(&fastSeen);     // Skip the activations at start
+    IrLatch::activatedSince(&slowSeen);
+    fastTime    = millis();
+    slowTime    = fastTime;
+}
+
+void loop() {
+    uint32_t    now     = millis();
+    if (now - fastTime >= 100) {
+        fastTime    += 100;
+        uint8_t bumps   = IrLatch::activatedSince(&fastSeen);
+        if (bumps) {
+            Serial.print("fast\t");
+            Serial.print(IrLatch::read(), BIN);
+            Serial.print("\t");
+            Serial.println(bumps, BIN);
+        }
+        IrLatch::acknowledge(0xFF);         // The application is done with them
+    }
+    if (now - slowTime >= 1000) {
+        slowTime    += 1000;
+        uint8_t bumps   = IrLatch::activatedSince(&slowSeen);
+        if (bumps) {
+            Serial.print("slow\t");
+            Serial.print(IrLatch::read(), BIN);
+            Serial.print("\t");
+            Serial.println(bumps, BIN);
+        }
+    }
+}
@@ -0,0 +1,351 @@
+/**
+ *  File: MPU9255.cpp
+ *
+ *  InvenSense MPU9255 gyroscope and accelerometer with the AK8963
+ *  magnetometer, read through the FIFO
+ *
+ *  The chip samples the gyro and the accelerometer at 1 kHz and the
+ *  sample rate divider gives the FIFO rate (100 Hz by default)
+ *  - DLPF 41 Hz for gyro and accel, gyro +-500 deg/s, accel +-2 g
+ *  - FIFO_EN has accel and gyro, 12 bytes per sample, no temperature
+ *  - FIFO mode stops when full.  A full FIFO is reset and counted in
+ *    overflows(), so the frames never get out of step
+ *  - The magnetometer is read directly at 0x0C in the bypass mode, in
+ *    16 bit continuous mode 2 (100 Hz).  The factory sensitivity
+ *    adjustment (ASA) is read from the fuse ROM in begin()
+ *
+ *  update() is paced by the INT pin and does not wait for data
+ *  - The INT pin is latched high on every sample until any register
+ *    read.  On an external interrupt pin the rising edge sets a flag,
+ *    on other pins the level is read.  Without the INT pin the FIFO is
+ *    polled once per sample period
+ *  - Nothing is read from the bus until there is a sample
+ *  - One burst reads the FIFO count and one more reads up to 2 frames
+ *    (24 bytes, the Wire buffer is 32 bytes).  More frames are left for
+ *    the next update(), so each call takes a bounded time, about 1 ms
+ *    at 400 kHz
+ *  - The bursts are blocking Wire transfers on purpose.  There is a
+ *    sample every 10 ms at 100 Hz, so the loop waits about 1 ms in every
+ *    10 ms, and the driver runs unchanged on the stand-in device.  An
+ *    interrupt driven TWI transfer would free that 1 ms, but it would
+ *    need its own bus state machine instead of Wire
+ *  - The magnetometer status, data, and ST2 are one 8 byte burst, at
+ *    most every 10 ms
+ *
+ *  The samples are calibrated integers
+ *  - accel [mg] = count * 1000 / 16384 = count * 125 / 2048
+ *  - gyro [0.1 deg/s] = (count - bias) * 10 / 65.5, the bias is the
+ *    average of calibrateGyro() samples taken at rest
+ *  - mag [0.1 uT] = (count * (ASA + 128) / 256 - offset) * 1.5.  The
+ *    hard iron offset is the middle of the min and max during a turn
+ *    between startMagCalibration() and stopMagCalibration().  The AK8963
+ *    keeps running, and the next sample uses the new offset
+ *  - The AK8963 axes are turned to the gyro axes: x = AK y, y = AK x,
+ *    z = - AK z
+ *
+ *  heading() integrates the z gyro with 32 bits (2^32 = 360 deg), so the
+ *  rounding does not drift.  With setMagGain() every magnetometer sample
+ *  corrects gain / 256 of the error to the magnetic heading (complementary
+ *  filter), and the first one sets the heading directly.  The magnetic
+ *  heading assumes a level rover: atan2(-my, mx), 0 = north, CCW.
+ *
+ *  The registers are accessed through MPU9255Bus, so the same driver
+ *  runs with Wire (MPU9255Wire) or with the stand-in device MPU9255Sim,
+ *  also on a PC.
+ */
+
+#include <MPU9255.h>
+
+#define SMPLRT_DIV      0x19
+#define CONFIG          0x1A
+#define GYRO_CONFIG     0x1B
+#define ACCEL_CONFIG    0x1C
+#define ACCEL_CONFIG2   0x1D
+#define FIFO_EN         0x23
+#define INT_PIN_CFG     0x37
+#define INT_ENABLE      0x38
+#define INT_STATUS      0x3A
+#define USER_CTRL       0x6A
+#define PWR_MGMT_1      0x6B
+#define FIFO_COUNTH     0x72
+#define FIFO_R_W        0x74
+#define WHO_AM_I        0x75
+
+#define AK_WIA          0x00
+#define AK_ST1          0x02
+#define AK_CNTL1        0x0A
+#define AK_ASAX         0x10
+
+#define ID_MPU9255      0x73
+#define ID_MPU9250      0x71
+#define ID_AK8963       0x48
+#define FIFO_SIZE       512
+#define FIFO_OFLOW      0x10        // INT_STATUS
+#define FIFO_ACCELGYRO  0x78        // GYRO_XOUT, YOUT, ZOUT, ACCEL
+#define FIFO_MODE       0x40        // CONFIG, no overwrite
+#define DLPF_41HZ       0x03
+#define GYRO_500DPS     0x08
+#define INT_CFG         0x32        // LATCH_INT_EN, INT_ANYRD_2CLEAR, BYPASS_EN
+#define RAW_RDY_EN      0x01
+#define USER_FIFO_EN    0x40
+#define USER_FIFO_RST   0x04
+#define AK_FUSEROM      0x0F
+#define AK_CONT100HZ    0x16        // 16 bit, continuous mode 2
+#define AK_HOFL         0x08        // ST2 overflow
+#define MAGPERIOD       10          // [ms]
+#define GYROTURN        182145UL    // 2^32 / (360 * 65.5) at 1 Hz
+
+static volatile bool intFlag;       // Rising edge of the INT pin
+
+static void intEdge() {
+    intFlag = true;
+}
+
+static int16_t bigEndian(const uint8_t *data) {
+    return (int16_t) ((data[0] << 8) | data[1]);
+}
+
+MPU9255::MPU9255(MPU9255Bus *bus, uint8_t intPin, uint8_t address) {
+    _bus        = bus;
+    _intPin     = intPin;
+    _address    = address;
+    _interrupt  = false;
+    _magGain    = 0;
+    _heading    = 0;
+    _calLeft    = 0;
+    _magCal     = false;
+    _magPresent = false;
+    memset(&_latest, 0, sizeof(_latest));
+    for (int i=0;i<3;i++) {
+        _gyroBias[i]    = 0;
+        _magOffset[i]   = 0;
+        _asa[i]         = 128;      // No adjustment
+    }
+}
+
+bool MPU9255::writeReg(uint8_t reg, uint8_t value) {
+    return _bus->write(_address, reg, value);
+}
+
+bool MPU9255::begin(uint16_t rate) {
+    uint8_t id;
+    if (!_bus->read(_address, WHO_AM_I, &id, 1)) return false;
+    if ((id != ID_MPU9255) && (id != ID_MPU9250)) return false;
+    if (rate < 4)    rate = 4;
+    if (rate > 1000) rate = 1000;
+    uint8_t div = 1000 / rate - 1;
+    _period     = div + 1;
+    _gyroScale  = GYROTURN * _period / 1000;
+
+    writeReg(PWR_MGMT_1, 0x80);             // Reset
+    delay(100);
+    writeReg(PWR_MGMT_1, 0x01);             // Gyro PLL clock
+    writeReg(CONFIG, FIFO_MODE | DLPF_41HZ);
+    writeReg(SMPLRT_DIV, div);
+    writeReg(GYRO_CONFIG, GYRO_500DPS);
+    writeReg(ACCEL_CONFIG, 0x00);           // +-2 g
+    writeReg(ACCEL_CONFIG2, DLPF_41HZ);
+    writeReg(INT_PIN_CFG, INT_CFG);
+    writeReg(INT_ENABLE, RAW_RDY_EN);
+
+    _magPresent = _bus->read(MPU9255_MAGADDRESS, AK_WIA, &id, 1) && (id == ID_AK8963);
+    if (_magPresent) {
+        _bus->write(MPU9255_MAGADDRESS, AK_CNTL1, 0x00);
+        delay(10);
+        _bus->write(MPU9255_MAGADDRESS, AK_CNTL1, AK_FUSEROM);
+        delay(10);
+        _bus->read(MPU9255_MAGADDRESS, AK_ASAX, _asa, 3);
+        _bus->write(MPU9255_MAGADDRESS, AK_CNTL1, 0x00);
+        delay(10);
+        _bus->write(MPU9255_MAGADDRESS, AK_CNTL1, AK_CONT100HZ);
+    }
+
+    writeReg(USER_CTRL, USER_FIFO_RST);
+    writeReg(FIFO_EN, FIFO_ACCELGYRO);
+    writeReg(USER_CTRL, USER_FIFO_EN);
+
+    _samples    = 0;
+    _overflows  = 0;
+    _more       = false;
+    _magLocked  = false;
+    _pollTime   = millis();
+    _magTime    = _pollTime;
+    if (_intPin != MPU9255_NOINT) {
+        pinMode(_intPin, INPUT);
+        int irq     = digitalPinToInterrupt(_intPin);
+        _interrupt  = irq != NOT_AN_INTERRUPT;
+        intFlag     = false;
+        if (_interrupt) attachInterrupt(irq, intEdge, RISING);
+    }
+    return true;
+}
+
+bool MPU9255::update() {
+    uint32_t    now     = millis();
+    bool        isNew   = false;
+    if (_magPresent && (now - _magTime >= MAGPERIOD)) {
+        _magTime    = now;
+        isNew       = readMag();
+    }
+
+    if (!_more) {                           // Wait for a sample, no bus traffic
+        if (_intPin == MPU9255_NOINT) {
+            if (now - _pollTime < _period) return isNew;
+            _pollTime   = now;
+        } else if (_interrupt) {
+            if (!intFlag) return isNew;
+            intFlag     = false;            // Before the read that clears INT
+        } else if (!digitalRead(_intPin)) {
+            return isNew;
+        }
+    }
+
+    uint8_t     data[MPU9255_FRAME * MPU9255_BURST];
+    if (!_bus->read(_address, FIFO_COUNTH, data, 2)) return isNew;
+    uint16_t    count   = bigEndian(data) & 0x1FFF;
+    if (count > FIFO_SIZE - MPU9255_FRAME) {    // Full, the frames would be lost
+        writeReg(USER_CTRL, USER_FIFO_RST | USER_FIFO_EN);
+        _overflows++;
+        _more   = false;
+        return isNew;
+    }
+    uint8_t     frames  = count / MPU9255_FRAME;
+    if (frames > MPU9255_BURST) frames = MPU9255_BURST;
+    _more   = count / MPU9255_FRAME > frames;
+    if (frames == 0) return isNew;
+    if (!_bus->read(_address, FIFO_R_W, data, frames * MPU9255_FRAME)) return isNew;
+    _latest.time    = now;
+    for (uint8_t i=0;i<frames;i++) frame(&data[i * MPU9255_FRAME]);
+    return true;
+}
+
+void MPU9255::frame(const uint8_t *data) {
+    int16_t     accel[3], gyro[3];
+    for (int i=0;i<3;i++) {
+        accel[i]    = bigEndian(&data[2 * i]);
+        gyro[i]     = bigEndian(&data[6 + 2 * i]);
+    }
+    if (_calLeft) {                         // Average at rest
+        for (int i=0;i<3;i++) _gyroSum[i] += gyro[i];
+        if (--_calLeft == 0) {
+            for (int i=0;i<3;i++) _gyroBias[i] = _gyroSum[i] / _gyroCount;
+        }
+    }
+    for (int i=0;i<3;i++) gyro[i] -= _gyroBias[i];
+    _latest.ax  = ((int32_t) accel[0] * 125) >> 11;
+    _latest.ay  = ((int32_t) accel[1] * 125) >> 11;
+    _latest.az  = ((int32_t) accel[2] * 125) >> 11;
+    _latest.gx  = (int32_t) gyro[0] * 20 / 131;
+    _latest.gy  = (int32_t) gyro[1] * 20 / 131;
+    _latest.gz  = (int32_t) gyro[2] * 20 / 131;
+    if (_calLeft == 0) _heading += (int32_t) gyro[2] * _gyroScale;
+    _samples++;
+}
+
+bool MPU9255::readMag() {
+    uint8_t     data[8];                    // ST1, HXL .. HZH, ST2
+    if (!_bus->read(MPU9255_MAGADDRESS, AK_ST1, data, 8)) return false;
+    if (!(data[0] & 0x01) || (data[7] & AK_HOFL)) return false;
+    int16_t     m[3];
+    for (int i=0;i<3;i++) {                 // Little endian, adjusted
+        int16_t raw = (int16_t) ((data[2 + 2 * i] << 8) | data[1 + 2 * i]);
+        m[i]        = ((int32_t) raw * (_asa[i] + 128)) >> 8;
+        if (_magCal) {
+            if (m[i] < _magMin[i]) _magMin[i] = m[i];
+            if (m[i] > _magMax[i]) _magMax[i] = m[i];
+        }
+        m[i]        -= _magOffset[i];
+    }
+    _latest.mx  = (int32_t) m[1] * 3 / 2;   // Gyro axes
+    _latest.my  = (int32_t) m[0] * 3 / 2;
+    _latest.mz  = (int32_t) -m[2] * 3 / 2;
+    if (_magGain && !_magCal) {
+        uint16_t    magHeading  = iatan2(-_latest.my, _latest.mx);
+        if (!_magLocked) {
+            _heading    = (uint32_t) magHeading << 16;
+            _magLocked  = true;
+        } else {
+            int16_t error   = magHeading - heading();
+            _heading    += (int32_t) error * _magGain * 256;
+        }
+    }
+    return true;
+}
+
+void MPU9255::sample(MPU9255Sample *latest) {
+    *latest = _latest;
+}
+
+uint16_t MPU9255::sampleCount() {
+    return _samples;
+}
+
+uint16_t MPU9255::overflows() {
+    return _overflows;
+}
+
+void MPU9255::calibrateGyro(uint16_t samples) {
+    for (int i=0;i<3;i++) _gyroSum[i] = 0;
+    _gyroCount  = samples;
+    _calLeft    = samples;
+}
+
+bool MPU9255::isCalibrating() {
+    return (_calLeft != 0) || _magCal;
+}
+
+void MPU9255::startMagCalibration() {
+    for (int i=0;i<3;i++) {
+        _magMin[i]  = 32767;
+        _magMax[i]  = -32768;
+    }
+    _magCal     = true;
+}
+
+void MPU9255::stopMagCalibration() {
+    if (!_magCal) return;
+    _magCal     = false;
+    for (int i=0;i<3;i++) {
+        if (_magMax[i] >= _magMin[i]) _magOffset[i] = ((int32_t) _magMin[i] + _magMax[i]) / 2;
+    }
+    _magLocked  = false;
+}
+
+void MPU9255::setMagOffset(int16_t x, int16_t y, int16_t z) {
+    _magOffset[0]   = x;
+    _magOffset[1]   = y;
+    _magOffset[2]   = z;
+    _magLocked      = false;
+}
+
+void MPU9255::magOffset(int16_t *xyz) {
+    for (int i=0;i<3;i++) xyz[i] = _magOffset[i];
+}
+
+void MPU9255::setMagGain(uint8_t gain) {
+    _magGain    = gain;
+    _magLocked  = false;
+}
+
+uint16_t MPU9255::heading() {
+    return _heading >> 16;
+}
+
+void MPU9255::setHeading(uint16_t heading) {
+    _heading    = (uint32_t) heading << 16;
+}
+
+uint16_t MPU9255::iatan2(int16_t y, int16_t x) {
+    // Octant approximation atan(r) = pi/4 * r + 0.273 * r * (1 - r), error 0.2 deg
+    uint16_t    ax  = (x < 0)? -(int32_t) x: x;
+    uint16_t    ay  = (y < 0)? -(int32_t) y: y;
+    if ((ax == 0) && (ay == 0)) return 0;
+    bool        steep   = ay > ax;
+    uint32_t    r       = steep? ((uint32_t) ax << 15) / ay: ((uint32_t) ay << 15) / ax;
+    uint32_t    bend    = (r * (32768 - r)) >> 15;
+    uint16_t    angle   = ((r * 8192) >> 15) + ((bend * 2847) >> 15);
+    if (steep)  angle   = 16384 - angle;
+    if (x < 0)  angle   = 32768 - angle;
+    if (y < 0)  angle   = -angle;
+    return angle;
+}
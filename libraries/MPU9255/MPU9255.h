@@ -0,0 +1,72 @@
+#ifndef MPU9255_H
+#define MPU9255_H
+
+#include <Arduino.h>
+
+#define MPU9255_ADDRESS     0x68    // AD0 low, 0x69 with AD0 high
+#define MPU9255_MAGADDRESS  0x0C    // AK8963 in the bypass mode
+#define MPU9255_NOINT       0xFF    // No INT pin, poll at the sample rate
+#define MPU9255_FRAME       12      // FIFO bytes per sample, accel and gyro
+#define MPU9255_BURST       2       // Frames per I2C read, 24 bytes of the 32 byte Wire buffer
+
+typedef struct {
+    int16_t     ax, ay, az;         // [mg]
+    int16_t     gx, gy, gz;         // [0.1 deg/s], bias removed
+    int16_t     mx, my, mz;         // [0.1 uT], offset removed, in the same axes
+    uint32_t    time;               // [ms] when read from the FIFO
+} MPU9255Sample;
+
+class MPU9255Bus {                  // Register access, Wire or a stand-in device
+public:
+    virtual bool write(uint8_t address, uint8_t reg, uint8_t value) = 0;
+    virtual bool read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t count) = 0;  // Burst
+};
+
+class MPU9255 {
+public:
+    MPU9255(MPU9255Bus *bus, uint8_t intPin = MPU9255_NOINT, uint8_t address = MPU9255_ADDRESS);
+    bool        begin(uint16_t rate = 100);                 // [Hz] 4 .. 1000, false if no chip
+    bool        update();                                   // True if new samples
+    void        sample(MPU9255Sample *latest);
+    uint16_t    sampleCount();                              // Wraps around
+    uint16_t    overflows();                                // FIFO resets
+    void        calibrateGyro(uint16_t samples);            // At rest, in background
+    bool        isCalibrating();
+    void        startMagCalibration();                      // Turn a full circle
+    void        stopMagCalibration();
+    void        setMagOffset(int16_t x, int16_t y, int16_t z);  // Chip axes, counts
+    void        magOffset(int16_t *xyz);
+    void        setMagGain(uint8_t gain);                   // gain / 256, 0 = gyro only
+    uint16_t    heading();                                  // 65536 = 360 deg, CCW
+    void        setHeading(uint16_t heading);
+    static uint16_t iatan2(int16_t y, int16_t x);           // 65536 = 360 deg
+private:
+    bool        writeReg(uint8_t reg, uint8_t value);
+    bool        readMag();
+    void        frame(const uint8_t *data);
+    MPU9255Bus  *_bus;
+    uint8_t     _intPin;
+    uint8_t     _address;
+    bool        _interrupt;         // INT pin has an external interrupt
+    bool        _more;              // Frames left after the last burst
+    uint16_t    _period;            // [ms] between samples
+    uint32_t    _pollTime, _magTime;
+    uint32_t    _gyroScale;         // [2^-32 turn] per gyro count and sample
+    bool        _magPresent;        // AK8963 answered in begin()
+    uint8_t     _asa[3];            // AK8963 sensitivity adjustment
+    int16_t     _gyroBias[3];       // [counts]
+    int32_t     _gyroSum[3];
+    uint16_t    _gyroCount;         // Gyro calibration samples
+    uint16_t    _calLeft;           // Gyro calibration samples left
+    bool        _magCal;
+    int16_t     _magMin[3], _magMax[3];
+    int16_t     _magOffset[3];      // [counts] chip axes, adjusted
+    uint8_t     _magGain;
+    bool        _magLocked;         // Heading set from the magnetometer
+    uint32_t    _heading;           // 2^32 = 360 deg
+    MPU9255Sample _latest;
+    uint16_t    _samples;
+    uint16_t    _overflows;
+};
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ *  File: MPU9255Sim.cpp
+ *
+ *  Register level stand-in of the MPU9255 and its AK8963 magnetometer
+ *
+ *  MPU9255Sim is an MPU9255Bus, so the driver talks to it with the same
+ *  register reads and writes as to the chip through Wire.  The sketch,
+ *  or a test program on a PC, sets the motion and the magnetic field in
+ *  physical units and advances the chip clock with run()
+ *  - The sample rate is 1 kHz / (1 + SMPLRT_DIV).  Each sample updates
+ *    the data registers and pushes the FIFO_EN selected values to the
+ *    512 byte FIFO in the register order: accel, temperature, gyro
+ *  - A full FIFO drops the new samples in the FIFO mode of CONFIG,
+ *    otherwise the oldest bytes are overwritten.  Both set FIFO_OFLOW
+ *  - The full scales of GYRO_CONFIG and ACCEL_CONFIG are used for the
+ *    raw values, and setGyroOffset() adds a zero rate error
+ *  - RAW_RDY_EN sets INT_STATUS and the INT level.  The level stays high
+ *    only with LATCH_INT_EN, and it is cleared by reading INT_STATUS or,
+ *    with INT_ANYRD_2CLEAR, by any read
+ *  - FIFO_COUNTH and FIFO_COUNTL are the count at the read, FIFO_R_W
+ *    pops one byte per read without incrementing the register address
+ *  - PWR_MGMT_1 H_RESET sets the reset values, USER_CTRL FIFO_RST empties
+ *    the FIFO, and the sleep bit stops the sampling
+ *  - The AK8963 answers at 0x0C only in the bypass mode.  The data
+ *    registers are little endian, 0.15 uT per count, ASA 128 (no
+ *    adjustment).  Mode 2 gives a sample every 10 ms and mode 1 every
+ *    125 ms, with DRDY in ST1 until ST2 is read
+ */
+
+#include <MPU9255Sim.h>
+
+#define ACCEL_XOUT_H    0x3B
+#define INT_PIN_CFG     0x37
+#define INT_ENABLE      0x38
+#define INT_STATUS      0x3A
+#define CONFIG          0x1A
+#define SMPLRT_DIV      0x19
+#define GYRO_CONFIG     0x1B
+#define ACCEL_CONFIG    0x1C
+#define FIFO_EN         0x23
+#define USER_CTRL       0x6A
+#define PWR_MGMT_1      0x6B
+#define FIFO_COUNTH     0x72
+#define FIFO_COUNTL     0x73
+#define FIFO_R_W        0x74
+#define WHO_AM_I        0x75
+
+#define AK_ADDRESS      0x0C
+#define AK_ST1          0x02
+#define AK_HXL          0x03
+#define AK_ST2          0x09
+#define AK_CNTL1        0x0A
+#define AK_ASAX         0x10
+
+MPU9255Sim::MPU9255Sim(uint8_t address) {
+    _address    = address;
+    for (int i=0;i<3;i++) {
+        _accel[i]       = 0;
+        _gyro[i]        = 0;
+        _field[i]       = 0;
+        _gyroOffset[i]  = 0;
+    }
+    _accel[2]   = 1000;             // Level, 1 g up
+    reset();
+}
+
+void MPU9255Sim::reset() {
+    for (int i=0;i<128;i++) _regs[i] = 0;
+    for (int i=0;i<19;i++)  _mag[i]  = 0;
+    _regs[PWR_MGMT_1]   = 0x01;
+    _regs[WHO_AM_I]     = 0x73;
+    _mag[0]             = 0x48;     // WIA
+    _mag[1]             = 0x9A;     // INFO
+    _mag[AK_ASAX]       = 128;
+    _mag[AK_ASAX + 1]   = 128;
+    _mag[AK_ASAX + 2]   = 128;
+    _fifoHead   = 0;
+    _fifoCount  = 0;
+    _sampleTime = 0;
+    _magTime    = 0;
+    _int        = false;
+}
+
+void MPU9255Sim::setMotion(int16_t ax, int16_t ay, int16_t az,
+                           int16_t gx, int16_t gy, int16_t gz) {
+    _accel[0]   = ax;
+    _accel[1]   = ay;
+    _accel[2]   = az;
+    _gyro[0]    = gx;
+    _gyro[1]    = gy;
+    _gyro[2]    = gz;
+}
+
+void MPU9255Sim::setGyroOffset(int16_t x, int16_t y, int16_t z) {
+    _gyroOffset[0]  = x;
+    _gyroOffset[1]  = y;
+    _gyroOffset[2]  = z;
+}
+
+void MPU9255Sim::setField(int16_t mx, int16_t my, int16_t mz) {
+    _field[0]   = mx;
+    _field[1]   = my;
+    _field[2]   = mz;
+}
+
+void MPU9255Sim::setHeading(uint16_t heading, int16_t field) {
+    // North at heading 0, the body sees it turned by -heading
+    float   a   = heading * (2 * PI / 65536.0);
+    setField(field * cos(a), -field * sin(a), -2 * field);
+}
+
+void MPU9255Sim::push(int16_t value) {
+    for (int i=0;i<2;i++) {
+        uint8_t b   = (i == 0)? value >> 8: value & 0xFF;
+        if (_fifoCount >= MPU9255SIM_FIFOSIZE) {
+            _regs[INT_STATUS]   |= 0x10;        // FIFO_OFLOW
+            if (_regs[CONFIG] & 0x40) return;   // No overwrite
+            _fifoHead   = (_fifoHead + 1) % MPU9255SIM_FIFOSIZE;
+            _fifoCount--;
+        }
+        _fifo[(_fifoHead + _fifoCount) % MPU9255SIM_FIFOSIZE] = b;
+        _fifoCount++;
+    }
+}
+
+uint8_t MPU9255Sim::pop() {
+    if (_fifoCount == 0) return 0xFF;
+    uint8_t b   = _fifo[_fifoHead];
+    _fifoHead   = (_fifoHead + 1) % MPU9255SIM_FIFOSIZE;
+    _fifoCount--;
+    return b;
+}
+
+void MPU9255Sim::sample() {
+    uint8_t     accelShift  = (_regs[ACCEL_CONFIG] >> 3) & 3;  // 16384 >> fs per g
+    uint8_t     gyroShift   = (_regs[GYRO_CONFIG] >> 3) & 3;   // 131 >> fs per deg/s
+    int16_t     values[7];
+    for (int i=0;i<3;i++) {
+        int32_t a   = ((int32_t) _accel[i] * 16384 / 1000) >> accelShift;
+        int32_t g   = (((int32_t) _gyro[i] * 131 / 10) >> gyroShift) + _gyroOffset[i];
+        values[i]       = constrain(a, -32768, 32767);
+        values[4 + i]   = constrain(g, -32768, 32767);
+    }
+    values[3]   = 0;                // Temperature 21 C
+    for (int i=0;i<7;i++) {         // ACCEL_XOUT_H .. GYRO_ZOUT_L
+        _regs[ACCEL_XOUT_H + 2 * i]     = values[i] >> 8;
+        _regs[ACCEL_XOUT_H + 2 * i + 1] = values[i] & 0xFF;
+    }
+    if (_regs[USER_CTRL] & 0x40) {  // FIFO enabled
+        uint8_t en  = _regs[FIFO_EN];
+        if (en & 0x08) for (int i=0;i<3;i++) push(values[i]);
+        if (en & 0x80) push(values[3]);
+        if (en & 0x40) push(values[4]);
+        if (en & 0x20) push(values[5]);
+        if (en & 0x10) push(values[6]);
+    }
+    if (_regs[INT_ENABLE] & 0x01) { // RAW_RDY_EN
+        _regs[INT_STATUS]   |= 0x01;
+        _int    = true;
+    }
+}
+
+void MPU9255Sim::magSample() {
+    int16_t     ak[3]   = {_field[1], _field[0], (int16_t) -_field[2]};    // AK8963 axes
+    for (int i=0;i<3;i++) {
+        int16_t raw     = (int32_t) ak[i] * 2 / 3;                         // 0.15 uT
+        _mag[AK_HXL + 2 * i]        = raw & 0xFF;
+        _mag[AK_HXL + 2 * i + 1]    = raw >> 8;
+    }
+    if (_mag[AK_ST1] & 0x01) _mag[AK_ST1] |= 0x02;      // DOR, previous not read
+    _mag[AK_ST1]    |= 0x01;                            // DRDY
+    _mag[AK_ST2]    = _mag[AK_CNTL1] & 0x10;            // BITM, no overflow
+}
+
+void MPU9255Sim::run(uint16_t duration) {
+    uint8_t     mode    = _mag[AK_CNTL1] & 0x0F;
+    uint16_t    magPeriod   = (mode == 0x06)? 10: (mode == 0x02)? 125: 0;
+    for (uint16_t t=0;t<duration;t++) {
+        if (!(_regs[PWR_MGMT_1] & 0x40)) {          // Not sleeping
+            if (++_sampleTime >= 1 + _regs[SMPLRT_DIV]) {
+                _sampleTime = 0;
+                sample();
+            }
+        }
+        if (magPeriod && (++_magTime >= magPeriod)) {
+            _magTime    = 0;
+            magSample();
+        }
+    }
+}
+
+bool MPU9255Sim::intLevel() {
+    return _int && (_regs[INT_PIN_CFG] & 0x20);     // LATCH_INT_EN
+}
+
+uint16_t MPU9255Sim::fifoCount() {
+    return _fifoCount;
+}
+
+bool MPU9255Sim::write(uint8_t address, uint8_t reg, uint8_t value) {
+    if (address == AK_ADDRESS) {
+        if (!(_regs[INT_PIN_CFG] & 0x02) || (reg > 0x12)) return false;    // Not in bypass
+        if (reg == AK_CNTL1) {
+            _mag[AK_CNTL1]  = value;
+            _magTime        = 0;
+        }
+        return true;
+    }
+    if ((address != _address) || (reg > 127)) return false;
+    if (reg == WHO_AM_I) return true;               // Read only
+    if ((reg == PWR_MGMT_1) && (value & 0x80)) {    // H_RESET
+        reset();
+        return true;
+    }
+    if ((reg == USER_CTRL) && (value & 0x04)) {     // FIFO_RST
+        _fifoHead   = 0;
+        _fifoCount  = 0;
+        value       &= ~0x04;
+    }
+    _regs[reg]  = value;
+    return true;
+}
+
+bool MPU9255Sim::read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t count) {
+    if (address == AK_ADDRESS) {
+        if (!(_regs[INT_PIN_CFG] & 0x02)) return false;
+        for (uint8_t i=0;i<count;i++,reg++) {
+            data[i] = (reg < 19)? _mag[reg]: 0;
+            if (reg == AK_ST2) _mag[AK_ST1] = 0;    // Data read
+        }
+        return true;
+    }
+    if ((address != _address) || (reg > 127)) return false;
+    _regs[FIFO_COUNTH]  = _fifoCount >> 8;
+    _regs[FIFO_COUNTL]  = _fifoCount & 0xFF;
+    for (uint8_t i=0;i<count;i++) {
+        if (reg == FIFO_R_W) {
+            data[i] = pop();                        // No increment
+            continue;
+        }
+        data[i] = _regs[reg];
+        if (reg == INT_STATUS) {
+            _regs[INT_STATUS]   = 0;
+            _int    = false;
+        }
+        if (reg < 127) reg++;
+    }
+    if (_regs[INT_PIN_CFG] & 0x10) {                // INT_ANYRD_2CLEAR
+        _regs[INT_STATUS]   = 0;
+        _int    = false;
+    }
+    return true;
+}
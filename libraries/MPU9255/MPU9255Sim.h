@@ -0,0 +1,39 @@
+#ifndef MPU9255SIM_H
+#define MPU9255SIM_H
+
+#include <Arduino.h>
+#include <MPU9255.h>
+
+#define MPU9255SIM_FIFOSIZE 512
+
+class MPU9255Sim : public MPU9255Bus {      // Register level stand-in of the chip
+public:
+    MPU9255Sim(uint8_t address = MPU9255_ADDRESS);
+    void        setMotion(int16_t ax, int16_t ay, int16_t az,      // [mg]
+                          int16_t gx, int16_t gy, int16_t gz);     // [0.1 deg/s]
+    void        setGyroOffset(int16_t x, int16_t y, int16_t z);    // [counts] zero rate error
+    void        setField(int16_t mx, int16_t my, int16_t mz);      // [0.1 uT] gyro axes
+    void        setHeading(uint16_t heading, int16_t field = 200); // Level, north field [0.1 uT]
+    void        run(uint16_t duration);                             // [ms]
+    bool        intLevel();                                         // INT pin
+    uint16_t    fifoCount();
+    bool        write(uint8_t address, uint8_t reg, uint8_t value);
+    bool        read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t count);
+private:
+    void        reset();
+    void        sample();
+    void        magSample();
+    void        push(int16_t value);
+    uint8_t     pop();
+    uint8_t     _address;
+    uint8_t     _regs[128];         // MPU9255 registers
+    uint8_t     _mag[19];           // AK8963 registers
+    uint8_t     _fifo[MPU9255SIM_FIFOSIZE];
+    uint16_t    _fifoHead, _fifoCount;
+    int16_t     _accel[3], _gyro[3], _field[3];
+    int16_t     _gyroOffset[3];
+    uint16_t    _sampleTime, _magTime;      // [ms] since the last sample
+    bool        _int;               // Latched INT level
+};
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ *  File: MPU9255Wire.cpp
+ *
+ *  Register access of MPU9255 and AK8963 with the Wire library
+ *  - read() writes the register address and reads the burst with a
+ *    repeated start, so the register pointer is not lost in between
+ *  - The Wire receive buffer is 32 bytes, so a burst is at most 32 bytes
+ *  - Wire waits for the transfer to finish.  A 24 byte FIFO burst takes
+ *    about 0.7 ms at 400 kHz, and MPU9255::update() keeps the wait to
+ *    one such burst per sample
+ */
+
+#include <MPU9255Wire.h>
+#include <Wire.h>
+
+void MPU9255Wire::begin(uint32_t clock) {
+    Wire.begin();
+    Wire.setClock(clock);
+}
+
+bool MPU9255Wire::write(uint8_t address, uint8_t reg, uint8_t value) {
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    Wire.write(value);
+    return Wire.endTransmission() == 0;
+}
+
+bool MPU9255Wire::read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t count) {
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0) return false;     // Repeated start
+    if (Wire.requestFrom(address, count) != count) return false;
+    for (uint8_t i=0;i<count;i++) data[i] = Wire.read();
+    return true;
+}
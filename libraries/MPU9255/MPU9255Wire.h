@@ -0,0 +1,14 @@
+#ifndef MPU9255WIRE_H
+#define MPU9255WIRE_H
+
+#include <Arduino.h>
+#include <MPU9255.h>
+
+class MPU9255Wire : public MPU9255Bus {     // I2C on SDA 20 and SCL 21 of the Mega
+public:
+    void        begin(uint32_t clock = 400000);     // [Hz]
+    bool        write(uint8_t address, uint8_t reg, uint8_t value);
+    bool        read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t count);   // Up to 32 bytes
+};
+
+#endif
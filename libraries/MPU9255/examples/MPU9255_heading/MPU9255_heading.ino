@@ -0,0 +1,61 @@
+/**
+ * Read the MPU9255 FIFO in I2C bursts and print the samples and the heading
+ *  - The INT pin of the module is on pin 26, which has no external
+ *    interrupt on the Mega, so update() reads the latched INT level
+ *  - The gyro bias is calibrated from 200 samples, keep the module still
+ *  - Send 'm' and turn the module a full circle, then 'm' again, for the
+ *    magnetometer offset.  The heading is then corrected towards north
+ *  - On the Wissahickon Rover SDA 20 and SCL 21 are the IR_FR and IR_RF
+ *    inputs, so those IR sensors must be moved to use the IMU with Wire
+ */
+
+#include <Wire.h>
+#include <MPU9255.h>
+#include <MPU9255Wire.h>
+
+#define IMU_INT     26
+
+MPU9255Wire bus;
+MPU9255     imu(&bus, IMU_INT);
+uint32_t    printTime;
+bool        magCal;
+
+void setup() {
+    Serial.begin(115200);
+    bus.begin();
+    if (!imu.begin(100)) {
+        Serial.println("No MPU9255");
+        while (1);
+    }
+    imu.calibrateGyro(200);
+    imu.setMagGain(4);
+    printTime = millis();
+}
+
+void loop() {
+    imu.update();
+    if (Serial.available() && (Serial.read() == 'm')) {
+        magCal  = !magCal;
+        if (!magCal) {
+            imu.stopMagCalibration();
+            Serial.println("Magnetometer calibrated");
+        } else {
+            imu.startMagCalibration();
+            Serial.println("Turn a full circle and send m");
+        }
+    }
+    if (millis() - printTime >= 100) {
+        printTime += 100;
+        MPU9255Sample s;
+        imu.sample(&s);
+        Serial.print(s.ax);  Serial.print("\t");
+        Serial.print(s.ay);  Serial.print("\t");
+        Serial.print(s.az);  Serial.print("\t");
+        Serial.print(s.gz);  Serial.print("\t");
+        Serial.print(s.mx);  Serial.print("\t");
+        Serial.print(s.my);  Serial.print("\t");
+        Serial.print((int16_t) imu.heading() * 360L / 65536);
+        Serial.print("\t");
+        Serial.println(imu.overflows());
+    }
+}
@@ -0,0 +1,80 @@
+/**
+ * Run the MPU9255 driver against the stand-in device, no chip needed
+ *  - MPU9255Sim answers the same register reads and writes as the chip
+ *  - The simulated module turns at 45 deg/s with a 300 counts zero rate
+ *    error, which the gyro calibration removes
+ *  - The first full turn after the gyro calibration is the magnetometer
+ *    calibration, and after it the magnetometer values must keep changing
+ *    as the module turns, otherwise "mag stopped" is printed
+ *  - The stand-in is advanced by the elapsed ms in every loop
+ *  - The true heading, the driver heading, and the samples are printed
+ *    every 500 ms
+ */
+
+#include <MPU9255.h>
+#include <MPU9255Sim.h>
+
+#define TURNRATE    450             // [0.1 deg/s]
+#define MAGCALTIME  8000            // [ms] full turn at 45 deg/s
+
+MPU9255Sim  chip;
+MPU9255     imu(&chip);             // No INT pin, polled
+uint32_t    chipTime, printTime;
+uint32_t    trueHeading;            // 2^32 = 360 deg
+uint32_t    turnStart;
+bool        turning, magCalibrated;
+int16_t     lastMx, lastMy;
+
+void setup() {
+    Serial.begin(115200);
+    chip.setGyroOffset(0, 0, 300);
+    chip.setHeading(0);
+    if (!imu.begin(100)) Serial.println("No MPU9255");
+    imu.calibrateGyro(100);
+    imu.setMagGain(4);
+    chipTime    = millis();
+    printTime   = chipTime;
+}
+
+void loop() {
+    uint32_t    now     = millis();
+    uint16_t    elapsed = now - chipTime;
+    chipTime    = now;
+    if (!turning && !imu.isCalibrating()) {     // Start turning after the gyro calibration
+        turning     = true;
+        turnStart   = now;
+        imu.startMagCalibration();
+    }
+    if (turning) {
+        trueHeading += elapsed * (TURNRATE * 1193UL);  // 2^32 / 3600000 per 0.1 deg/s and ms
+        chip.setMotion(0, 0, 1000, 0, 0, TURNRATE);
+        if (!magCalibrated && (now - turnStart >= MAGCALTIME)) {
+            imu.stopMagCalibration();
+            magCalibrated   = true;
+        }
+    }
+    chip.setHeading(trueHeading >> 16);
+    chip.run(elapsed);
+    imu.update();
+
+    if (now - printTime >= 500) {
+        printTime += 500;
+        MPU9255Sample s;
+        imu.sample(&s);
+        Serial.print((int16_t) (trueHeading >> 16) * 360L / 65536);
+        Serial.print("\t");
+        Serial.print((int16_t) imu.heading() * 360L / 65536);
+        Serial.print("\t");
+        Serial.print(s.gz);
+        Serial.print("\t");
+        Serial.print(s.mx);
+        Serial.print("\t");
+        Serial.print(s.my);
+        Serial.print("\t");
+        Serial.print(imu.sampleCount());
+        if (magCalibrated && (s.mx == lastMx) && (s.my == lastMy)) Serial.print("\tmag stopped");
+        Serial.println();
+        lastMx      = s.mx;
+        lastMy      = s.my;
+    }
+}
@@ -0,0 +1,88 @@
+/**
+ *  File: MPU9255_heading.cpp
+ *
+ *  Host test of the MPU9255 heading against the stand-in device
+ *
+ *  MPU9255Sim turns at 45 deg/s with a 300 counts zero rate error, and
+ *  the driver polls it at 100 Hz (no INT pin) in 1 ms steps
+ *  - Gyro only, after calibrateGyro(): after a 360 deg turn and a stop
+ *    the heading must be within 1 deg of the true heading
+ *  - After a magnetometer calibration turn, with setMagGain(16) and the
+ *    zero rate error grown by 600 counts (9 deg/s of drift), the heading
+ *    must stay within 2.5 deg: the drift of a 10 ms magnetometer period
+ *    over the gain is 1.5 deg, the magnetometer sample can be 10 ms old
+ *    (0.45 deg at 45 deg/s), and iatan2() is within 0.2 deg.  The
+ *    correction steps are negative, the gyro runs ahead
+ *  - Every sample must be read, one per 10 ms, without FIFO overflows
+ *
+ *      ./MPU9255_heading               (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <MPU9255.h>
+#include <MPU9255Sim.h>
+#include <stdio.h>
+
+#define TURNRATE    450             // [0.1 deg/s]
+#define TURNTIME    8000            // [ms] full turn at 45 deg/s
+#define MAGGAIN     16
+#define DRIFT       600             // [counts] zero rate error after the calibration
+
+MPU9255Sim  chip;
+MPU9255     imu(&chip);             // No INT pin, polled
+uint32_t    trueHeading;            // 2^32 = 360 deg
+uint32_t    chipTime;               // [ms] run in the stand-in
+
+static double error() {             // [deg] driver - true
+    return (int16_t) (imu.heading() - (trueHeading >> 16)) * 360.0 / 65536;
+}
+
+static double run(uint32_t duration, int16_t rate, uint32_t from) {  // Worst error after from
+    double      worst   = 0;
+    chip.setMotion(0, 0, 1000, 0, 0, rate);
+    for (uint32_t t=0;t<duration;t++) {
+        trueHeading += rate * 1193046UL / 1000;     // 2^32 / 3600000 per 0.1 deg/s and ms
+        chip.setHeading(trueHeading >> 16);
+        delay(1);
+        chip.run(1);
+        chipTime++;
+        imu.update();
+        if ((t >= from) && (fabs(error()) > worst)) worst = fabs(error());
+    }
+    return worst;
+}
+
+int main() {
+    bool        ok          = true;
+
+    hostSetCallTime(0);
+    chip.setGyroOffset(0, 0, 300);
+    chip.setHeading(0);
+    if (!imu.begin(100)) ok = false;
+    uint16_t    start       = imu.sampleCount();
+    chipTime    = 0;
+    imu.calibrateGyro(100);
+    run(1100, 0, 0);
+    imu.setHeading(trueHeading >> 16);
+    run(TURNTIME, TURNRATE, 0);
+    run(1000, 0, 0);
+    double      gyroError   = fabs(error());
+    if (gyroError > 1) ok = false;
+
+    imu.startMagCalibration();
+    run(TURNTIME, TURNRATE, 0);
+    imu.stopMagCalibration();
+    imu.setMagGain(MAGGAIN);
+    chip.setGyroOffset(0, 0, 300 + DRIFT);
+    double      magError    = run(2 * TURNTIME, TURNRATE, TURNTIME);
+    if (magError > 2.5) ok = false;
+
+    uint16_t    samples     = imu.sampleCount() - start;
+    uint16_t    expected    = chipTime / 10;
+    if ((samples + 1 < expected) || (samples > expected) || imu.overflows()) ok = false;
+    printf("gyro %.2f deg, magnetometer %.2f deg, %u samples of %u, %u overflows\n",
+        gyroError, magError, samples, expected, imu.overflows());
+    fprintf(stderr, "heading %.2f deg gyro, %.2f deg with drift, %u samples%s\n",
+        gyroError, magError, samples, ok? "": "  FAIL");
+    return ok? 0: 1;
+}
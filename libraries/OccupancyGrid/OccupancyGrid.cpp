@@ -0,0 +1,163 @@
+/**
+ *  File: OccupancyGrid.cpp
+ *
+ *  Local occupancy grid around the rover
+ *
+ *  The grid is a window of 32 x 32 cells of 100 mm (3.2 m x 3.2 m) on the
+ *  Mega, and 128 x 128 cells on a PC.  Each cell has 2 bits
+ *      CELL_UNKNOWN    never seen
+ *      CELL_FREE       a beam has passed through
+ *      CELL_PROBABLE   a beam has ended here once more than passed through
+ *      CELL_OCCUPIED   two or more hits
+ *  A hit steps the cell up (UNKNOWN goes to PROBABLE) and a beam passing
+ *  through steps it down (UNKNOWN goes to FREE), so the cells are a
+ *  saturating 2 bit log-odds with a separate unknown state.
+ *
+ *  The window is aligned with the world axes and the cells are stored by
+ *  their world cell index modulo the size
+ *  - recenter() moves the window with the rover.  The column or row that
+ *    leaves the window is cleared and reused for the one that enters,
+ *    so a move by one cell costs one column (32 cells) or one row (8 bytes)
+ *  - Moves of a full window clear the grid
+ *
+ *  addBeam() traces the beam from the sensor with integer line stepping
+ *  (Bresenham) through the cells.  The cells before the distance are free
+ *  and the last one is a hit, unless the distance is at or over the range.
+ *  The trace stops at the window edge, so a sample costs at most one
+ *  window diagonal of cell updates (64 on the Mega).
+ *
+ *  addSensor() places the beam with the sensor position (getMount) and
+ *  the rover pose.  addHit() marks a contact, for example from an IR.
+ */
+
+#include <OccupancyGrid.h>
+#include <FixedTrig.h>
+
+#define SIZE        OCCUPANCYGRID_SIZE
+#define MASK        (OCCUPANCYGRID_SIZE - 1)
+#define ROWBYTES    (OCCUPANCYGRID_SIZE / 4)
+
+static int16_t toCell(int16_t v) {      // Floor division by the cell size
+    return (v >= 0)? v / OCCUPANCYGRID_CELL: -((OCCUPANCYGRID_CELL - 1 - v) / OCCUPANCYGRID_CELL);
+}
+
+OccupancyGrid::OccupancyGrid() {
+    _ox = -SIZE / 2;
+    _oy = -SIZE / 2;
+    clear();
+}
+
+void OccupancyGrid::clear() {
+    memset(_cells, 0, sizeof(_cells));
+}
+
+bool OccupancyGrid::inside(int16_t cx, int16_t cy) {
+    return ((uint16_t) (cx - _ox) < SIZE) && ((uint16_t) (cy - _oy) < SIZE);
+}
+
+void OccupancyGrid::update(int16_t cx, int16_t cy, bool hit) {
+    uint16_t    i       = (cy & MASK) * ROWBYTES + ((cx & MASK) >> 2);
+    uint8_t     shift   = (cx & 3) << 1;
+    uint8_t     value   = (_cells[i] >> shift) & 3;
+    if (hit) {
+        if (value == CELL_UNKNOWN) value = CELL_PROBABLE;
+        else if (value < CELL_OCCUPIED) value++;
+    } else {
+        if (value == CELL_UNKNOWN) value = CELL_FREE;
+        else if (value > CELL_FREE) value--;
+    }
+    _cells[i]   = (_cells[i] & ~(3 << shift)) | (value << shift);
+}
+
+void OccupancyGrid::clearColumn(int16_t cx) {
+    uint8_t     *p      = &_cells[(cx & MASK) >> 2];
+    uint8_t     keep    = ~(3 << ((cx & 3) << 1));
+    for (uint16_t r=0;r<SIZE;r++) {
+        *p  &= keep;
+        p   += ROWBYTES;
+    }
+}
+
+void OccupancyGrid::clearRow(int16_t cy) {
+    memset(&_cells[(cy & MASK) * ROWBYTES], 0, ROWBYTES);
+}
+
+void OccupancyGrid::recenter(int16_t x, int16_t y) {
+    int16_t     tx      = toCell(x) - SIZE / 2;
+    int16_t     ty      = toCell(y) - SIZE / 2;
+    if ((abs(tx - _ox) >= SIZE) || (abs(ty - _oy) >= SIZE)) {
+        clear();
+        _ox = tx;
+        _oy = ty;
+        return;
+    }
+    while (_ox < tx) clearColumn(_ox++);    // Left column becomes the right one
+    while (_ox > tx) clearColumn(--_ox);
+    while (_oy < ty) clearRow(_oy++);
+    while (_oy > ty) clearRow(--_oy);
+}
+
+void OccupancyGrid::addBeam(int16_t x, int16_t y, uint16_t angle,
+                            int16_t distance, int16_t range) {
+    bool        hit     = distance < range;
+    if (!hit) distance = range;
+    int16_t     x1      = x + (((int32_t) icos(angle) * distance) >> 14);
+    int16_t     y1      = y + (((int32_t) isin(angle) * distance) >> 14);
+    int16_t     cx      = toCell(x);
+    int16_t     cy      = toCell(y);
+    int16_t     ex      = toCell(x1);
+    int16_t     ey      = toCell(y1);
+    int16_t     dx      = abs(ex - cx);
+    int16_t     dy      = -abs(ey - cy);
+    int8_t      sx      = (cx < ex)? 1: -1;
+    int8_t      sy      = (cy < ey)? 1: -1;
+    int16_t     err     = dx + dy;
+    while (inside(cx, cy)) {
+        if ((cx == ex) && (cy == ey)) {
+            update(cx, cy, hit);
+            return;
+        }
+        update(cx, cy, false);
+        int16_t e2      = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            cx  += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            cy  += sy;
+        }
+    }
+}
+
+void OccupancyGrid::addSensor(const SensorMount *mount, int16_t x, int16_t y,
+                              uint16_t heading, int16_t distance, int16_t range) {
+    int16_t     c       = icos(heading);
+    int16_t     s       = isin(heading);
+    int16_t     sx      = x + (((int32_t) mount->x * c - (int32_t) mount->y * s) >> 14);
+    int16_t     sy      = y + (((int32_t) mount->x * s + (int32_t) mount->y * c) >> 14);
+    addBeam(sx, sy, heading + mount->angle, distance, range);
+}
+
+void OccupancyGrid::addHit(int16_t x, int16_t y) {
+    int16_t     cx      = toCell(x);
+    int16_t     cy      = toCell(y);
+    if (inside(cx, cy)) update(cx, cy, true);
+}
+
+OccupancyCell OccupancyGrid::cell(int16_t x, int16_t y) {
+    int16_t     cx      = toCell(x);
+    int16_t     cy      = toCell(y);
+    if (!inside(cx, cy)) return CELL_UNKNOWN;
+    return cellAt(cx - _ox, cy - _oy);
+}
+
+OccupancyCell OccupancyGrid::cellAt(uint8_t col, uint8_t row) {
+    int16_t     cx      = _ox + col;
+    int16_t     cy      = _oy + row;
+    uint8_t     byte    = _cells[(cy & MASK) * ROWBYTES + ((cx & MASK) >> 2)];
+    return (OccupancyCell) ((byte >> ((cx & 3) << 1)) & 3);
+}
+
+int16_t OccupancyGrid::originX() {return _ox * OCCUPANCYGRID_CELL;}
+int16_t OccupancyGrid::originY() {return _oy * OCCUPANCYGRID_CELL;}
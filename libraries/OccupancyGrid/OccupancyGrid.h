@@ -0,0 +1,50 @@
+#ifndef OCCUPANCYGRID_H
+#define OCCUPANCYGRID_H
+
+#include <Arduino.h>
+#include <WH_Rover.h>
+
+#ifndef OCCUPANCYGRID_SIZE          // Cells per side, a power of 2
+#if defined(__AVR__)
+#define OCCUPANCYGRID_SIZE  32      // 256 bytes
+#else
+#define OCCUPANCYGRID_SIZE  128     // 4 kB on a PC
+#endif
+#endif
+
+#ifndef OCCUPANCYGRID_CELL
+#define OCCUPANCYGRID_CELL  100     // [mm] Cell side
+#endif
+
+typedef enum OccupancyCells {
+    CELL_UNKNOWN    = 0,
+    CELL_FREE       = 1,
+    CELL_PROBABLE   = 2,            // One more hit than misses
+    CELL_OCCUPIED   = 3
+} OccupancyCell;
+
+class OccupancyGrid {
+public:
+    OccupancyGrid();
+    void            clear();
+    void            recenter(int16_t x, int16_t y);         // [mm] rover position
+    void            addBeam(int16_t x, int16_t y, uint16_t angle,
+                            int16_t distance, int16_t range);   // [mm]
+    void            addSensor(const SensorMount *mount, int16_t x, int16_t y,
+                            uint16_t heading, int16_t distance, int16_t range);
+    void            addHit(int16_t x, int16_t y);           // [mm]
+    OccupancyCell   cell(int16_t x, int16_t y);             // [mm]
+    OccupancyCell   cellAt(uint8_t col, uint8_t row);       // 0 .. SIZE - 1
+    int16_t         originX();                              // [mm] corner of cell 0, 0
+    int16_t         originY();
+private:
+    bool            inside(int16_t cx, int16_t cy);
+    void            update(int16_t cx, int16_t cy, bool hit);
+    void            clearColumn(int16_t cx);
+    void            clearRow(int16_t cy);
+
+    uint8_t         _cells[OCCUPANCYGRID_SIZE * OCCUPANCYGRID_SIZE / 4];
+    int16_t         _ox, _oy;       // World cell of the window corner
+};
+
+#endif
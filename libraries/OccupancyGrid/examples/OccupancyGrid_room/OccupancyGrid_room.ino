@@ -0,0 +1,115 @@
+/**
+ * Map a simulated room into an occupancy grid
+ *
+ *  The rover wanders in RoverSim as in the example RoverSim_room, and the
+ *  sensors are added to the grid every 100 ms
+ *  - US_FL, US_FF, US_FR, ODS_L, and ODS_R as beams
+ *  - An active IR as a hit 50 mm outside the body
+ *  - The simulated pose places the beams, the rover has no own pose yet
+ *
+ *  Every 3 s the grid is printed with the rover in the middle
+ *      ' ' unknown, '.' free, '+' probable, '#' occupied, '@' rover
+ */
+
+#include <WH_Rover.h>
+#include <RoverSim.h>
+#include <OccupancyGrid.h>
+#include <FixedTrig.h>
+
+#define USRANGE     3000            // [mm]
+#define ODSRANGE    800
+#define IRREACH     50
+
+RoverSim        room;
+OccupancyGrid   grid;
+uint32_t        mapTime, printTime;
+
+bool blocked() {
+    return getIR(IR_FL) || getIR(IR_FR) || (getDistance(DIR_F) < 250);
+}
+
+void wander() {
+    queueForward(600,300);
+    queueUntil(blocked,0);
+    queueBrake(200);
+    queueBackward(400,300);
+    queueBrake(200);
+    if (getDistance(DIR_L) < getDistance(DIR_R)) {
+        queueTurnRight(100,400);
+    } else {
+        queueTurnLeft(100,400);
+    }
+    queueBrake(200);
+}
+
+void mapSensors() {
+    SensorMount mount;
+    int16_t     x       = room.x();
+    int16_t     y       = room.y();
+    uint16_t    h       = room.heading();
+    grid.recenter(x, y);
+    for (int i=0;i<3;i++) {                 // US_FL, US_FF, US_FR
+        USChannel ch    = (USChannel) (US_FL + i);
+        getMount(ch, &mount);
+        grid.addSensor(&mount, x, y, h, getUS(ch), USRANGE);
+    }
+    for (int i=0;i<2;i++) {
+        ODSPin pin      = (ODSPin) (ODS_L + i);
+        getMount(pin, &mount);
+        grid.addSensor(&mount, x, y, h, getODS(pin), ODSRANGE);
+    }
+    for (int i=0;i<8;i++) {
+        IRPin pin       = (IRPin) (IR_LF + i);
+        if (!getIR(pin)) continue;
+        getMount(pin, &mount);
+        mount.x     += ((int32_t) IRREACH * icos(mount.angle)) >> 14;
+        mount.y     += ((int32_t) IRREACH * isin(mount.angle)) >> 14;
+        int16_t c   = icos(h);
+        int16_t s   = isin(h);
+        grid.addHit(x + (((int32_t) mount.x * c - (int32_t) mount.y * s) >> 14),
+                    y + (((int32_t) mount.x * s + (int32_t) mount.y * c) >> 14));
+    }
+}
+
+void printGrid() {
+    const char  symbols[] = " .+#";
+    int16_t     rc  = (room.x() - grid.originX()) / OCCUPANCYGRID_CELL;
+    int16_t     rr  = (room.y() - grid.originY()) / OCCUPANCYGRID_CELL;
+    for (int row=OCCUPANCYGRID_SIZE-1;row>=0;row--) {   // +y up
+        for (int col=0;col<OCCUPANCYGRID_SIZE;col++) {
+            if ((col == rc) && (row == rr)) {
+                Serial.print('@');
+            } else {
+                Serial.print(symbols[grid.cellAt(col, row)]);
+            }
+        }
+        Serial.println();
+    }
+    Serial.println();
+}
+
+void setup() {
+    Serial.begin(115200);
+    initWH_Rover();
+    room.addBox(-1500,-1000,1500,1000);     // Walls [mm]
+    room.addBox(600,-300,900,300);          // Obstacle
+    room.setPose(-1000,0,0);
+    attachSimulator(&room);
+    onMotionIdle(wander);
+    wander();
+    mapTime     = millis();
+    printTime   = mapTime;
+}
+
+void loop() {
+    updateWH_Rover();
+    uint32_t now = millis();
+    if (now - mapTime >= 100) {
+        mapTime     += 100;
+        mapSensors();
+    }
+    if (now - printTime >= 3000) {
+        printTime   += 3000;
+        printGrid();
+    }
+}
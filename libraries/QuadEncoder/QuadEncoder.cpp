@@ -0,0 +1,173 @@
+/**
+ *  File: QuadEncoder.cpp
+ *
+ *  Quadrature encoder counting with external interrupts on Arduino Mega 2560
+ *
+ *  The encoder has two outputs A and B, 90 degrees apart.  The direction is
+ *  the order of the edges
+ *  - Edge on A: forward if A and B are different after the edge
+ *  - Edge on B: forward if A and B are the same after the edge
+ *
+ *  Pins 2, 3, 18, 19, 20, and 21 have external interrupts (INT4, INT5,
+ *  INT3 .. INT0).  On Wissahickon Rover 18 - 21 are used by the IR sensors.
+ *  - If A and B both have interrupts, all 4 edges of a cycle are counted
+ *  - If only A has an interrupt, B is read in the A interrupt and
+ *    2 edges of a cycle are counted
+ *  The input registers and masks are resolved in begin(), so the interrupt
+ *  reads the pins without digitalRead().
+ *
+ *  The count is 32 bits, so reading it takes 4 instructions and the interrupt
+ *  can change it in between.  Instead of disabling the interrupts, the
+ *  interrupt increments a sequence number after every change, and count()
+ *  reads again if the sequence number changed during the read.
+ *
+ *  Speed is estimated in update(), which should be called more often than
+ *  the interval (default 20 ms)
+ *      speed [counts/s] = change in count * 1000 / elapsed ms
+ *  At 20 ms one count is 50 counts/s, so the interval is a compromise between
+ *  resolution and delay.
+ *
+ *  write() sets the count without a jump in the speed.  addCounts() changes
+ *  the count as if the edges came from the encoder, so simulated movement
+ *  can be fed to the speed estimator (example QuadEncoder_speedSim).
+ */
+
+#include <QuadEncoder.h>
+
+#define DEFAULTINTERVAL 20          // [ms]
+
+typedef struct {
+    volatile uint8_t    *aReg, *bReg;       // Input registers
+    uint8_t             aMask, bMask;
+    int8_t              step;               // 1, or -1 if reversed
+    volatile int32_t    count;
+    volatile uint8_t    seq;                // Incremented after every change
+} EncoderState;
+
+static EncoderState     encoders[QUADENCODER_MAX];
+static uint8_t          encoderCount;
+
+//---------------------------------------------------- Interrupt Routines ----
+
+static inline void edgeA(EncoderState *e) {
+    bool a = *e->aReg & e->aMask;
+    bool b = *e->bReg & e->bMask;
+    e->count += (a != b)? e->step: -e->step;
+    e->seq++;
+}
+
+static inline void edgeB(EncoderState *e) {
+    bool a = *e->aReg & e->aMask;
+    bool b = *e->bReg & e->bMask;
+    e->count += (a == b)? e->step: -e->step;
+    e->seq++;
+}
+
+static void edgeA0() {edgeA(&encoders[0]);}
+static void edgeA1() {edgeA(&encoders[1]);}
+static void edgeA2() {edgeA(&encoders[2]);}
+static void edgeA3() {edgeA(&encoders[3]);}
+static void edgeB0() {edgeB(&encoders[0]);}
+static void edgeB1() {edgeB(&encoders[1]);}
+static void edgeB2() {edgeB(&encoders[2]);}
+static void edgeB3() {edgeB(&encoders[3]);}
+
+static void (* const edgeAIsr[QUADENCODER_MAX])(void) = {edgeA0, edgeA1, edgeA2, edgeA3};
+static void (* const edgeBIsr[QUADENCODER_MAX])(void) = {edgeB0, edgeB1, edgeB2, edgeB3};
+
+//---------------------------------------------------- Class Methods ---------
+
+QuadEncoder::QuadEncoder(uint8_t aPin, uint8_t bPin, bool reverse) {
+    _aPin       = aPin;
+    _bPin       = bPin;
+    _reverse    = reverse;
+    _index      = QUADENCODER_MAX;
+    _fullQuad   = false;
+    _interval   = DEFAULTINTERVAL;
+    _lastTime   = 0;
+    _lastCount  = 0;
+    _speed      = 0;
+}
+
+bool QuadEncoder::begin() {
+    if (_index < QUADENCODER_MAX) return true;      // Already started
+    int8_t  aInt    = digitalPinToInterrupt(_aPin);
+    int8_t  bInt    = digitalPinToInterrupt(_bPin);
+    if ((aInt == NOT_AN_INTERRUPT) || (encoderCount >= QUADENCODER_MAX)) return false;
+
+    _index  = encoderCount++;
+    EncoderState *e = &encoders[_index];
+    pinMode(_aPin, INPUT_PULLUP);
+    pinMode(_bPin, INPUT_PULLUP);
+    e->aReg     = portInputRegister(digitalPinToPort(_aPin));
+    e->bReg     = portInputRegister(digitalPinToPort(_bPin));
+    e->aMask    = digitalPinToBitMask(_aPin);
+    e->bMask    = digitalPinToBitMask(_bPin);
+    e->step     = _reverse? -1: 1;
+    e->count    = 0;
+    e->seq      = 0;
+
+    attachInterrupt(aInt, edgeAIsr[_index], CHANGE);
+    _fullQuad   = bInt != NOT_AN_INTERRUPT;
+    if (_fullQuad) attachInterrupt(bInt, edgeBIsr[_index], CHANGE);
+
+    _lastTime   = millis();
+    _lastCount  = 0;
+    return true;
+}
+
+int32_t QuadEncoder::count() {
+    if (_index >= QUADENCODER_MAX) return 0;
+    EncoderState *e = &encoders[_index];
+    uint8_t     seq;
+    int32_t     value;
+    do {
+        seq     = e->seq;
+        value   = e->count;
+    } while (seq != e->seq);        // An edge came during the read
+    return value;
+}
+
+void QuadEncoder::write(int32_t newCount) {
+    if (_index >= QUADENCODER_MAX) return;
+    EncoderState *e = &encoders[_index];
+    uint8_t sreg = SREG;
+    cli();
+    _lastCount  += newCount - e->count;     // No speed jump from the write
+    e->count    = newCount;
+    e->seq++;
+    SREG        = sreg;
+}
+
+void QuadEncoder::addCounts(int16_t counts) {
+    if (_index >= QUADENCODER_MAX) return;
+    EncoderState *e = &encoders[_index];
+    uint8_t sreg = SREG;
+    cli();
+    e->count    += counts;
+    e->seq++;
+    SREG        = sreg;
+}
+
+bool QuadEncoder::isFullQuadrature() {return _fullQuad;}
+
+void QuadEncoder::setInterval(uint16_t interval) {
+    _interval   = (interval == 0)? DEFAULTINTERVAL: interval;
+}
+
+bool QuadEncoder::update() {
+    uint32_t    now     = millis();
+    uint16_t    elapsed = now - _lastTime;
+    if (elapsed < _interval) return false;
+
+    int32_t     value   = count();
+    int32_t     speed   = (value - _lastCount) * 1000 / elapsed;
+    if (speed >  32767) speed =  32767;
+    if (speed < -32767) speed = -32767;
+    _speed      = speed;
+    _lastCount  = value;
+    _lastTime   = now;
+    return true;
+}
+
+int16_t QuadEncoder::speed() {return _speed;}
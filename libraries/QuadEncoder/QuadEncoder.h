@@ -0,0 +1,30 @@
+#ifndef QUADENCODER_H
+#define QUADENCODER_H
+
+#include <Arduino.h>
+
+#define QUADENCODER_MAX     4       // Encoders with interrupt routines
+
+class QuadEncoder {
+public:
+    QuadEncoder(uint8_t aPin, uint8_t bPin, bool reverse = false);
+    bool        begin();            // Call in setup(), false if A has no interrupt
+    int32_t     count();            // Consistent snapshot, no interrupt blocking
+    void        write(int32_t newCount);
+    void        addCounts(int16_t counts);  // Simulated edges
+    bool        isFullQuadrature(); // Both A and B have interrupts
+    void        setInterval(uint16_t interval);
+    bool        update();           // True when a new speed is calculated
+    int16_t     speed();            // [counts/s]
+private:
+    uint8_t     _aPin, _bPin;
+    bool        _reverse;
+    uint8_t     _index;             // Interrupt slot, QUADENCODER_MAX = none
+    bool        _fullQuad;
+    uint16_t    _interval;          // [ms] between speed estimates
+    uint32_t    _lastTime;
+    int32_t     _lastCount;
+    int16_t     _speed;
+};
+
+#endif
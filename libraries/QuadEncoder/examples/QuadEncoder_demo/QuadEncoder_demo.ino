@@ -0,0 +1,34 @@
+/**
+ * Show the count and speed of two quadrature encoders
+ *  - Left encoder A on pin 2 (INT4), B on pin 30
+ *  - Right encoder A on pin 3 (INT5), B on pin 31, mounted reversed
+ *  - B pins have no interrupt, so 2 edges of each cycle are counted
+ *
+ *  Turn the wheels by hand and use Serial Monitor to see
+ *    count and speed [counts/s] of both encoders every 100 ms
+ */
+
+#include <QuadEncoder.h>
+
+QuadEncoder encL(2, 30);
+QuadEncoder encR(3, 31, true);
+
+uint32_t    printTime;
+
+void setup() {
+    Serial.begin(230400);
+    if (!encL.begin() || !encR.begin()) Serial.println("Encoder pin without interrupt");
+    Serial.println("countL\tspeedL\tcountR\tspeedR");
+}
+
+void loop() {
+    encL.update();
+    encR.update();
+    if (millis() - printTime >= 100) {
+        printTime = millis();
+        Serial.print(encL.count());     Serial.print('\t');
+        Serial.print(encL.speed());     Serial.print('\t');
+        Serial.print(encR.count());     Serial.print('\t');
+        Serial.println(encR.speed());
+    }
+}
@@ -0,0 +1,84 @@
+/**
+ * Wheel speed control loop against a simulated motor
+ *
+ *  The chain is the same as on the rover, but the motor and the encoder
+ *  edges are simulated, so no hardware is needed
+ *  - iPID calculates the motor power (CV, -1023 .. 1023) from the speed
+ *    setpoint (SP) and the estimated speed (PV)
+ *  - ProcSimulator models the wheel speed [counts/s] for the power
+ *  - The simulated speed is integrated into counts, which are fed to
+ *    QuadEncoder with addCounts()
+ *  - QuadEncoder estimates the speed every 20 ms, as from real edges
+ *
+ *  The loop runs every 2 ms.  The setpoint steps to 1000 counts/s, a load
+ *  is applied, and the setpoint reverses to -500 counts/s.  The simulated
+ *  wheel is a spring and a mass, so the speed overshoots a few times before
+ *  it settles.
+ *
+ *  The results are shown in Serial Plotter.
+ */
+
+#include <QuadEncoder.h>
+#include <ProcSimulator.h>
+#include <iPID.h>
+
+#define LOOPTIME    2               // [ms]
+
+//  ProcSimulator
+//  uint16_t actLag, int16_t actGainPct,
+//  uint16_t mass=1, uint16_t frictionPct=0, uint16_t procLag=0,
+//  int16_t initCV=0, int16_t minCV=0, int16_t maxCV=100,
+//  int16_t initPV=0, int16_t minPV=0, int16_t maxPV=100
+
+ProcSimulator wheel(
+    0, 100,
+    1000, 1000, 0,
+    0, -1023, 1023,
+    0, -2000, 2000);
+
+QuadEncoder enc(2, 30);             // Only used for the counting
+
+int16_t     speedPV, powerCV, speedSP;
+
+iPID ctrl(&speedPV, &powerCV, &speedSP,
+    20, 20, 0,
+    20);
+
+uint16_t    count;
+int32_t     countMs;                // Simulated counts * 1000
+
+void setup() {
+    Serial.begin(230400);
+    Serial.print("SP\tPV\tCV\n");
+    enc.begin();
+    ctrl.SetCvLimits(-1023, 1023);
+    ctrl.SetMode(true);
+    speedSP = 0;
+}
+
+void synch(uint32_t timeMs) {
+    uint32_t now = millis();
+    while (millis() == now);
+    while(millis() % timeMs);
+}
+
+void loop() {
+    count++;
+    if (count == 50)    speedSP = 1000;
+    if (count == 500)   wheel.SetLoad(-200);
+    if (count == 1000)  speedSP = -500;
+
+    countMs     += (int32_t) wheel.PV() * LOOPTIME;     // Simulated edges
+    enc.addCounts(countMs / 1000);
+    countMs     %= 1000;
+
+    if (enc.update()) speedPV = enc.speed();
+    if (ctrl.Execute()) wheel.SetCV(powerCV);
+
+    Serial.print(speedSP);          Serial.print("\t");
+    Serial.print(speedPV);          Serial.print("\t");
+    Serial.print(powerCV);          Serial.println();
+
+    synch(LOOPTIME);
+    if (count > 1500) while(1);     // Stop after 3 seconds
+}
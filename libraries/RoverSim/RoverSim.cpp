@@ -0,0 +1,306 @@
+/**
+ *  File: RoverSim.cpp
+ *
+ *  2D world for running WH_Rover behaviors without the rover
+ *
+ *  The world is a set of wall segments in mm, for example a room with boxes
+ *  - Coordinates are from -10 m to 10 m, so the ray and wall calculations
+ *    fit into 32 bit integers
+ *  - The pose is x and y in um, and the heading as a binary angle
+ *    (2^32 = 360 deg, 0 = +x axis, counter clockwise is positive)
+ *
+ *  Differential drive model
+ *  - The wheel speed follows power * 1000 mm/s / 1023 with a 150 ms lag
+ *  - The rover moves with the average speed and turns with the speed
+ *    difference divided by the 200 mm track
+ *  - The body is a 150 mm circle.  If it would move closer to a wall that
+ *    it touches, it does not move, the wheels stall, and the collision is
+ *    counted.  Turning in place and moving away are always possible
+ *  - The wheel travel is reported as 1000 encoder counts per meter
+ *  - The time is stepped in 10 ms slices, so the model is the same for
+ *    any call rate
+ *
+ *  The sensors are rays from their mounting points on the body (getMount)
+ *  - HC_SR04: the shortest of three rays in a +-12 deg cone, up to 3 m.
+ *    No echo is HC_SR04_CLEAR.  New echoes every 60 ms
+ *  - GP2Y0A21: one ray up to 1.5 m, converted back to the ADC reading
+ *    with the same curve that getODS() uses
+ *  - FC-51: active if a wall is closer than 100 mm
+ *  - The ODS and IR readings are refreshed every 20 ms.  A reading is
+ *    calculated only when it is read after the refresh, so the unused
+ *    sensors cost nothing
+ *
+ *  With attachSimulator(&sim), WH_Rover steps the world with millis() and
+ *  the motor powers, so a sketch runs in real time on the Mega without the
+ *  motors or sensors.  run() steps the world by any duration, so the same
+ *  model can run faster than real time with a host millis().
+ *
+ *  extras/host runs the unmodified sketches on a PC.  A small Arduino core
+ *  (HostCore.cpp) simulates the time, and run.sh builds the scenarios of
+ *  scenarios.txt and runs them in parallel on all cores.  A 120 s room
+ *  scenario takes about 0.15 s.
+ */
+
+#include <RoverSim.h>
+#include <FixedTrig.h>
+#include <GP2Y0A21.h>
+#include <HC_SR04.h>
+
+#define STEPTIME        10          // [ms] Integration slice
+#define FASTTIME        20          // [ms] ODS and IR refresh
+#define USTIME          60          // [ms] US echo interval
+#define MAXSTEP         1000        // [ms] Longest step() after a pause
+#define USRANGE         3000        // [mm]
+#define USMIN           30
+#define USSPREAD        FIXEDTRIG_DEG(12)
+#define ODSRANGE        1500
+#define IRRANGE         100
+#define CONTACTGAP      10          // [mm] To count a new collision
+#define SENSE_FAST      1           // Dirty bits
+#define SENSE_US        2
+#define HEADINGGAIN     ((int32_t) (4294967296.0 / (2000.0 * 3.14159265 * ROVERSIM_TRACK)))
+
+static int16_t odsReading(int16_t distance, uint8_t sensorId) {    // Inverse of GP2Y0A21distance
+    int16_t lo = 0;
+    int16_t hi = 700;
+    while (lo < hi) {                   // Smallest reading at or under the distance
+        int16_t mid = (lo + hi) / 2;
+        if (GP2Y0A21distance(mid, sensorId) > distance) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+RoverSim::RoverSim() {
+    _wallCount  = 0;
+    _collisions = 0;
+    _started    = false;
+    for (int i=0;i<2;i++) {
+        _power[i]   = 0;
+        _speed[i]   = 0;
+        _travel[i]  = 0;
+    }
+    setPose(0, 0, 0);
+}
+
+void RoverSim::clearWorld() {
+    _wallCount  = 0;
+    _dirty      = SENSE_FAST | SENSE_US;
+}
+
+bool RoverSim::addWall(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+    if (_wallCount >= ROVERSIM_MAXWALLS) return false;
+    int16_t     p[4]    = {x1, y1, x2, y2};
+    for (int i=0;i<4;i++) {
+        if ((p[i] < -ROVERSIM_WORLD) || (p[i] > ROVERSIM_WORLD)) return false;
+    }
+    for (int i=0;i<4;i++) _walls[_wallCount][i] = p[i];
+    _wallCount++;
+    _dirty      = SENSE_FAST | SENSE_US;
+    return true;
+}
+
+bool RoverSim::addBox(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+    if (_wallCount + 4 > ROVERSIM_MAXWALLS) return false;
+    return addWall(x1, y1, x2, y1) && addWall(x2, y1, x2, y2) &&
+           addWall(x2, y2, x1, y2) && addWall(x1, y2, x1, y1);
+}
+
+void RoverSim::setPose(int16_t x, int16_t y, uint16_t heading) {
+    _x          = 1000L * x;
+    _y          = 1000L * y;
+    _heading    = (uint32_t) heading << 16;
+    _contact    = false;
+    _fastTime   = 0;
+    _usTime     = 0;
+    _dirty      = SENSE_FAST | SENSE_US;
+}
+
+void RoverSim::setMotors(int16_t leftPower, int16_t rightPower) {
+    _power[WHEEL_L] = constrain(leftPower,  -1023, 1023);
+    _power[WHEEL_R] = constrain(rightPower, -1023, 1023);
+}
+
+void RoverSim::run(uint16_t duration) {
+    while (duration > 0) {
+        uint16_t dt = (duration > STEPTIME)? STEPTIME: duration;
+        duration    -= dt;
+        move(dt);
+        _fastTime   += dt;
+        if (_fastTime >= FASTTIME) {
+            _fastTime   -= FASTTIME;
+            _dirty      |= SENSE_FAST;
+        }
+        _usTime     += dt;
+        if (_usTime >= USTIME) {
+            _usTime     -= USTIME;
+            _dirty      |= SENSE_US;
+        }
+    }
+}
+
+void RoverSim::move(uint16_t dt) {
+    int16_t     v[2];                   // [mm/s]
+    for (int i=0;i<2;i++) {
+        int32_t target  = (int32_t) _power[i] * ROVERSIM_MAXSPEED * 16 / 1023;
+        _speed[i]   += (target - _speed[i]) * dt / ROVERSIM_LAG;
+        v[i]        = _speed[i] / 16;
+    }
+    int32_t     turn    = (int32_t) (v[WHEEL_R] - v[WHEEL_L]) * dt * HEADINGGAIN;
+    uint16_t    mid     = (_heading + turn / 2) >> 16;      // Heading in the middle of the slice
+    int32_t     speed   = (v[WHEEL_L] + v[WHEEL_R]) / 2;
+    int32_t     x       = _x + ((speed * icos(mid) * dt) >> 14);   // mm/s * ms = um
+    int32_t     y       = _y + ((speed * isin(mid) * dt) >> 14);
+    _heading    += turn;
+
+    int32_t     clear   = clearance(x / 1000, y / 1000);
+    if (clear <= (int32_t) ROVERSIM_RADIUS * ROVERSIM_RADIUS) {
+        if (clear < clearance(_x / 1000, _y / 1000)) {  // Moving into a wall
+            if (!_contact) _collisions++;
+            _contact    = true;
+            _speed[WHEEL_L] = 0;        // Stalled against the wall
+            _speed[WHEEL_R] = 0;
+            return;
+        }
+    } else if (clear > (int32_t) (ROVERSIM_RADIUS + CONTACTGAP) * (ROVERSIM_RADIUS + CONTACTGAP)) {
+        _contact    = false;            // Clearly away from the wall
+    }
+    _x          = x;
+    _y          = y;
+    _travel[WHEEL_L]    += (int32_t) v[WHEEL_L] * dt;
+    _travel[WHEEL_R]    += (int32_t) v[WHEEL_R] * dt;
+}
+
+int32_t RoverSim::clearance(int16_t x, int16_t y) {    // [mm^2] to the nearest wall
+    int32_t     nearest = 0x7FFFFFFFL;
+    for (uint8_t i=0;i<_wallCount;i++) {
+        int16_t *w      = _walls[i];
+        int32_t sx      = w[2] - w[0];
+        int32_t sy      = w[3] - w[1];
+        int32_t qx      = x - w[0];
+        int32_t qy      = y - w[1];
+        int32_t dot     = qx * sx + qy * sy;
+        int32_t len2    = sx * sx + sy * sy;
+        int32_t d2;
+        if (dot <= 0) {                 // Closest to the first end
+            d2  = qx * qx + qy * qy;
+        } else if (dot >= len2) {       // Closest to the second end
+            qx  = x - w[2];
+            qy  = y - w[3];
+            d2  = qx * qx + qy * qy;
+        } else {                        // Perpendicular distance
+            int64_t cross   = qx * sy - qy * sx;
+            d2  = cross * cross / len2;
+        }
+        if (d2 < nearest) nearest = d2;
+    }
+    return nearest;
+}
+
+int16_t RoverSim::castRay(int16_t x, int16_t y, uint16_t angle, int16_t range) {
+    int32_t     rx      = ((int32_t) icos(angle) * range) >> 14;
+    int32_t     ry      = ((int32_t) isin(angle) * range) >> 14;
+    int16_t     nearest = range;
+    for (uint8_t i=0;i<_wallCount;i++) {
+        int16_t *w      = _walls[i];
+        int32_t sx      = w[2] - w[0];
+        int32_t sy      = w[3] - w[1];
+        int32_t qx      = w[0] - x;
+        int32_t qy      = w[1] - y;
+        int32_t denom   = rx * sy - ry * sx;
+        if (denom == 0) continue;       // Parallel
+        int32_t t       = qx * sy - qy * sx;        // Along the ray, 0 .. denom
+        int32_t u       = qx * ry - qy * rx;        // Along the wall, 0 .. denom
+        if (denom < 0) {
+            denom   = -denom;
+            t       = -t;
+            u       = -u;
+        }
+        if ((t < 0) || (t > denom) || (u < 0) || (u > denom)) continue;
+        int16_t d       = (int64_t) range * t / denom;
+        if (d < nearest) nearest = d;
+    }
+    return nearest;
+}
+
+int16_t RoverSim::sensorRay(const SensorMount *mount, int16_t range, uint16_t spread) {
+    int16_t     mx      = mount->x;
+    int16_t     my      = mount->y;
+    uint16_t    h       = _heading >> 16;
+    uint16_t    angle   = h + mount->angle;
+    int16_t     c       = icos(h);
+    int16_t     s       = isin(h);
+    int16_t     x       = _x / 1000 + (((int32_t) mx * c - (int32_t) my * s) >> 14);
+    int16_t     y       = _y / 1000 + (((int32_t) mx * s + (int32_t) my * c) >> 14);
+    int16_t     d       = castRay(x, y, angle, range);
+    if (spread) {
+        int16_t dl      = castRay(x, y, angle + spread, range);
+        int16_t dr      = castRay(x, y, angle - spread, range);
+        if (dl < d) d = dl;
+        if (dr < d) d = dr;
+    }
+    return d;
+}
+
+void RoverSim::updateSensors(uint8_t mask) {
+    SensorMount mount;
+    if (mask & SENSE_FAST) {
+        for (int i=0;i<2;i++) {
+            getMount((ODSPin) (ODS_L + i), &mount);
+            _ods[i]     = odsReading(sensorRay(&mount, ODSRANGE), i);
+        }
+        _ir = 0;
+        for (int i=0;i<8;i++) {
+            getMount((IRPin) (IR_LF + i), &mount);
+            if (sensorRay(&mount, IRRANGE) < IRRANGE) _ir |= 1 << i;
+        }
+    }
+    if (mask & SENSE_US) {
+        for (int i=0;i<6;i++) {
+            getMount((USChannel) (US_FL + i), &mount);
+            int16_t d   = sensorRay(&mount, USRANGE, USSPREAD);
+            if (d >= USRANGE) d = HC_SR04_CLEAR;
+            else if (d < USMIN) d = USMIN;
+            _us[i]      = d;
+        }
+    }
+    _dirty  &= ~mask;
+}
+
+int16_t RoverSim::x() {return _x / 1000;}
+int16_t RoverSim::y() {return _y / 1000;}
+uint16_t RoverSim::heading() {return _heading >> 16;}
+int16_t RoverSim::wheelSpeed(Wheel wheelNr) {return _speed[wheelNr] / 16;}
+uint16_t RoverSim::collisions() {return _collisions;}
+
+uint8_t RoverSim::step(uint32_t now, int16_t leftPower, int16_t rightPower) {
+    if (!_started) {
+        _started    = true;
+        _lastTime   = now;
+    }
+    uint32_t    dt      = now - _lastTime;
+    _lastTime   = now;
+    if (dt > MAXSTEP) dt = MAXSTEP;
+    setMotors(leftPower, rightPower);
+    uint16_t    usTime  = _usTime;
+    run(dt);
+    return (dt > 0 && _usTime < usTime + dt)? 0x3F: 0;     // US_FL .. US_BL
+}
+
+int32_t RoverSim::count(Wheel wheelNr) {
+    return _travel[wheelNr] / (1000000L / ROVERSIM_COUNTSPERM);
+}
+
+int16_t RoverSim::ods(ODSPin pinNr) {
+    if (_dirty & SENSE_FAST) updateSensors(SENSE_FAST);
+    return _ods[pinNr - ODS_L];
+}
+
+int16_t RoverSim::us(USChannel channelNr) {
+    if (_dirty & SENSE_US) updateSensors(SENSE_US);
+    return _us[channelNr];
+}
+
+bool RoverSim::ir(IRPin pinNr) {
+    if (_dirty & SENSE_FAST) updateSensors(SENSE_FAST);
+    return _ir & (1 << (pinNr - IR_LF));
+}
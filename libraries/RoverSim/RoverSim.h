@@ -0,0 +1,60 @@
+#ifndef ROVERSIM_H
+#define ROVERSIM_H
+
+#include <Arduino.h>
+#include <WH_Rover.h>
+
+#define ROVERSIM_MAXWALLS   32      // Wall segments in the world
+#define ROVERSIM_WORLD      10000   // [mm] Coordinates are -WORLD .. WORLD
+#define ROVERSIM_RADIUS     150     // [mm] Body radius for collisions
+#define ROVERSIM_TRACK      200     // [mm] Distance between the wheels
+#define ROVERSIM_MAXSPEED   1000    // [mm/s] Wheel speed at power 1023
+#define ROVERSIM_LAG        150     // [ms] Motor time constant
+#define ROVERSIM_COUNTSPERM 1000    // Encoder counts per meter of travel
+
+class RoverSim : public RoverSimHook {
+public:
+    RoverSim();
+    void        clearWorld();
+    bool        addWall(int16_t x1, int16_t y1, int16_t x2, int16_t y2);   // [mm]
+    bool        addBox(int16_t x1, int16_t y1, int16_t x2, int16_t y2);    // [mm]
+    void        setPose(int16_t x, int16_t y, uint16_t heading);    // 65536 = 360 deg
+    void        setMotors(int16_t leftPower, int16_t rightPower);
+    void        run(uint16_t duration);                             // [ms]
+    int16_t     x();                                                // [mm]
+    int16_t     y();                                                // [mm]
+    uint16_t    heading();                                          // 0 = +x, CCW
+    int16_t     wheelSpeed(Wheel wheelNr);                          // [mm/s]
+    uint16_t    collisions();
+    int16_t     castRay(int16_t x, int16_t y, uint16_t angle, int16_t range);  // [mm]
+
+    uint8_t     step(uint32_t now, int16_t leftPower, int16_t rightPower);
+    int32_t     count(Wheel wheelNr);
+    int16_t     ods(ODSPin pinNr);
+    int16_t     us(USChannel channelNr);
+    bool        ir(IRPin pinNr);
+private:
+    void        move(uint16_t dt);
+    int32_t     clearance(int16_t x, int16_t y);
+    int16_t     sensorRay(const SensorMount *mount, int16_t range, uint16_t spread = 0);
+    void        updateSensors(uint8_t mask);
+
+    int16_t     _walls[ROVERSIM_MAXWALLS][4];
+    uint8_t     _wallCount;
+    int32_t     _x, _y;             // [um]
+    uint32_t    _heading;           // 2^32 = 360 deg
+    int16_t     _power[2];
+    int32_t     _speed[2];          // [mm/s * 16]
+    int32_t     _travel[2];         // [um]
+    uint16_t    _collisions;
+    bool        _contact;
+    bool        _started;
+    uint32_t    _lastTime;
+    uint16_t    _fastTime, _usTime; // [ms] since the sensor updates
+    int16_t     _ods[2];            // ADC readings
+    int16_t     _us[6];             // [mm]
+    uint8_t     _ir;                // Bit per IR sensor
+    uint8_t     _dirty;             // Readings to recalculate
+};
+
+#endif
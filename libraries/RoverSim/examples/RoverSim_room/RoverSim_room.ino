@@ -0,0 +1,65 @@
+/**
+ * Run a WH_Rover behavior in a simulated room
+ *
+ *  The Mega runs the same code as on the rover, but the motors, encoders,
+ *  and the distance sensors are replaced by RoverSim.  The motor shield
+ *  can be left unpowered.
+ *  - The room is 3 m x 2 m with a box in the middle of the right half
+ *  - The rover wanders: forward until the front distance is under 250 mm
+ *    or a front IR is active, then backs up and turns away from the
+ *    closer side
+ *  - The pose, the front distance, and the collisions are printed every
+ *    500 ms
+ */
+
+#include <WH_Rover.h>
+#include <RoverSim.h>
+
+RoverSim    room;
+uint32_t    printTime;
+
+bool blocked() {
+    return getIR(IR_FL) || getIR(IR_FR) || (getDistance(DIR_F) < 250);
+}
+
+void wander() {
+    queueForward(600,300);
+    queueUntil(blocked,0);
+    queueBrake(200);
+    queueBackward(400,300);
+    queueBrake(200);
+    if (getDistance(DIR_L) < getDistance(DIR_R)) {
+        queueTurnRight(100,400);
+    } else {
+        queueTurnLeft(100,400);
+    }
+    queueBrake(200);
+}
+
+void setup() {
+    Serial.begin(115200);
+    initWH_Rover();
+    room.addBox(-1500,-1000,1500,1000);     // Walls [mm]
+    room.addBox(600,-300,900,300);          // Obstacle
+    room.setPose(-1000,0,0);                // Facing +x
+    attachSimulator(&room);
+    onMotionIdle(wander);
+    wander();
+    printTime = millis();
+}
+
+void loop() {
+    updateWH_Rover();
+    if (millis() - printTime >= 500) {
+        printTime += 500;
+        Serial.print(room.x());
+        Serial.print("\t");
+        Serial.print(room.y());
+        Serial.print("\t");
+        Serial.print(room.heading() * 360L / 65536);
+        Serial.print("\t");
+        Serial.print(getDistance(DIR_F));
+        Serial.print("\t");
+        Serial.println(room.collisions());
+    }
+}
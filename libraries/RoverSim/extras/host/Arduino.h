@@ -0,0 +1,259 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ *  Arduino core for running the rover sketches on a PC (HostCore.cpp)
+ *
+ *  Only what the rover libraries use is declared.  The AVR registers are
+ *  plain variables, the pins do nothing, and only Timer 5 counts and
+ *  interrupts (HostCore.cpp), so HostMain.cpp attaches a RoverSim world
+ *  before the sketch starts.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef uint8_t     byte;
+typedef bool        boolean;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define DEC             10
+#define HEX             16
+#define OCT             8
+#define BIN             2
+
+#define A0              54
+#define A1              55
+#define A2              56
+#define A3              57
+#define A4              58
+#define A5              59
+#define A6              60
+#define A7              61
+#define A8              62
+#define LED_BUILTIN     13
+
+#define F_CPU           16000000UL
+#define PI              3.1415926535897932384626433832795
+#define NOT_A_PIN       0
+#define NOT_ON_TIMER    0
+#define NOT_AN_INTERRUPT -1
+
+#define PROGMEM
+#define pgm_read_byte(p)    (*(const uint8_t *) (p))
+#define pgm_read_word(p)    (*(const uint16_t *) (p))
+#define pgm_read_dword(p)   (*(const uint32_t *) (p))
+#define ISR(vector)         extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector) extern "C" void vector(void) {}
+#define _BV(b)              (1 << (b))
+#define bit(b)              (1UL << (b))
+#define constrain(x,a,b)    ((x) < (a)? (a): ((x) > (b)? (b): (x)))
+#define digitalPinToInterrupt(p)    (p)
+
+void        pinMode(uint8_t pin, uint8_t mode);
+void        digitalWrite(uint8_t pin, uint8_t value);
+int         digitalRead(uint8_t pin);
+int         analogRead(uint8_t pin);
+void        analogWrite(uint8_t pin, int value);
+void        attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+void        cli();
+void        sei();
+
+unsigned long millis();             // Simulated time, see HostCore.cpp
+unsigned long micros();
+void        delay(unsigned long ms);
+void        delayMicroseconds(unsigned int us);
+uint64_t    hostTime();             // [us] since the start, does not advance
+void        hostAdvance(uint32_t us);
+void        hostStopAt(uint64_t time, void (*stop)(void));   // Called once at time
+void        hostSetCallTime(uint16_t us);   // [us] per millis() and micros() call
+void        hostInterrupt(uint8_t interrupt);   // Calls the attached isr
+
+uint8_t     digitalPinToPort(uint8_t pin);
+uint8_t     digitalPinToBitMask(uint8_t pin);
+uint8_t     digitalPinToTimer(uint8_t pin);
+volatile uint8_t *portOutputRegister(uint8_t port);
+volatile uint8_t *portInputRegister(uint8_t port);
+volatile uint8_t *portModeRegister(uint8_t port);
+
+#define R8(n)   extern volatile uint8_t n;
+#define R16(n)  extern volatile uint16_t n;
+#define T16(n)  R8(TCCR##n##A) R8(TCCR##n##B) R8(TCCR##n##C) R16(OCR##n##A) R16(OCR##n##B) \
+                R16(OCR##n##C) R16(ICR##n) R16(TCNT##n) R8(TIMSK##n) R8(TIFR##n)
+#include <HostRegisters.h>
+#undef R8
+#undef R16
+#undef T16
+
+#define TIMER3A 1                   // digitalPinToTimer() values
+#define TIMER3B 2
+#define TIMER3C 3
+#define TIMER4A 4
+#define TIMER4B 5
+#define TIMER4C 6
+#define TIMER5A 7
+#define TIMER5B 8
+#define TIMER5C 9
+#define TIMER1A 10
+#define TIMER1B 11
+#define TIMER1C 12
+
+#define SREG_I  7                   // Register bits, 2560 datasheet
+#define CS00    0
+#define CS01    1
+#define CS02    2
+#define WGM00   0
+#define WGM01   1
+#define WGM02   3
+#define OCIE0A  1
+#define OCIE0B  2
+#define TOV0    0
+#define CS20    0
+#define CS21    1
+#define CS22    2
+#define WGM20   0
+#define WGM21   1
+#define WGM22   3
+#define OCIE2A  1
+#define OCIE2B  2
+#define TOIE2   0
+#define TOV2    0
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define CS30    0
+#define CS31    1
+#define CS32    2
+#define CS40    0
+#define CS41    1
+#define CS42    2
+#define CS50    0
+#define CS51    1
+#define CS52    2
+#define WGM10   0
+#define WGM11   1
+#define WGM12   3
+#define WGM13   4
+#define WGM30   0
+#define WGM31   1
+#define WGM32   3
+#define WGM33   4
+#define WGM40   0
+#define WGM41   1
+#define WGM42   3
+#define WGM43   4
+#define WGM50   0
+#define WGM51   1
+#define WGM52   3
+#define WGM53   4
+#define COM1A1  7
+#define COM1B1  5
+#define COM1C1  3
+#define COM3A0  6
+#define COM3A1  7
+#define COM3B1  5
+#define COM3C1  3
+#define COM4A1  7
+#define COM4B1  5
+#define COM4C1  3
+#define COM5A1  7
+#define COM5B1  5
+#define COM5C1  3
+#define TOIE1   0
+#define TOIE3   0
+#define TOIE4   0
+#define TOIE5   0
+#define TOV1    0
+#define TOV3    0
+#define TOV4    0
+#define TOV5    0
+#define OCIE1A  1
+#define OCIE1B  2
+#define OCIE3A  1
+#define OCIE3B  2
+#define OCIE4A  1
+#define OCIE4B  2
+#define OCIE5A  1
+#define OCIE5B  2
+#define ICIE5   5
+#define ICF5    5
+#define REFS0   6
+#define REFS1   7
+#define ADLAR   5
+#define ADEN    7
+#define ADSC    6
+#define ADATE   5
+#define ADIF    4
+#define ADIE    3
+#define ADPS2   2
+#define ADPS1   1
+#define ADPS0   0
+#define MUX5    3
+#define ADTS2   2
+#define ADTS1   1
+#define ADTS0   0
+#define ISC00   0
+#define ISC01   1
+#define ISC10   2
+#define ISC11   3
+#define ISC20   4
+#define ISC21   5
+#define ISC30   6
+#define ISC31   7
+#define INT0    0
+#define INT1    1
+#define INT2    2
+#define INT3    3
+#define INT4    4
+#define INT5    5
+#define PCIE0   0
+#define PCIE1   1
+#define PCIE2   2
+
+class Print {
+public:
+    virtual size_t  write(uint8_t c) = 0;
+    virtual size_t  write(const uint8_t *buffer, size_t size);
+    virtual int     availableForWrite();
+    size_t      print(const char *s);
+    size_t      print(char c);
+    size_t      print(int n, int base = DEC);
+    size_t      print(unsigned int n, int base = DEC);
+    size_t      print(long n, int base = DEC);
+    size_t      print(unsigned long n, int base = DEC);
+    size_t      print(double n, int digits = 2);
+    size_t      println();
+    template <typename T> size_t println(T value) {return print(value) + println();}
+    template <typename T> size_t println(T value, int base) {return print(value, base) + println();}
+};
+
+class Stream : public Print {
+public:
+    virtual int     available();
+    virtual int     read();
+    virtual void    flush();
+};
+
+class HostSerial : public Stream {  // Serial output goes to stdout
+public:
+    void        begin(long baud);
+    size_t      write(uint8_t c);
+    size_t      write(const uint8_t *buffer, size_t size);
+    int         availableForWrite();
+    operator    bool();
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ *  File: HostCore.cpp
+ *
+ *  Arduino core functions for the rover sketches on a PC
+ *
+ *  The time is simulated, so a sketch runs as fast as the PC can run it
+ *  - The clock is a 64 bit count of us from the start
+ *  - Every call of millis() or micros() advances it by HOST_CALLTIME us,
+ *    about the time of a short task on the Mega, so the wait loops of
+ *    the sketches and the libraries advance the time.  The host tests
+ *    that emulate the interrupts in us steps set it to 0 (hostSetCallTime)
+ *  - delay() and delayMicroseconds() advance it by their duration
+ *  - micros() and millis() wrap around at 32 bits as on the Mega, and
+ *    micros() has the same 4 us resolution
+ *  - hostStopAt() gives a function that is called when the time passes
+ *    the end of the run, so also a sketch that never returns from loop()
+ *    stops
+ *
+ *  The registers are variables and the pins read high, so the interrupts
+ *  never fire by themselves.  A host test fires an attachInterrupt() isr
+ *  with hostInterrupt().  Only Timer 5 runs with the clock: TCNT5 counts
+ *  in normal mode at the prescaler of TCCR5B and calls the overflow
+ *  interrupt, as the HC_SR04 timestamps use it.  digitalPinToTimer() gives
+ *  the 16 bit timers of the Mega pins, so the Vnh2sp30 PWM writes go to
+ *  the OCR variables.  HostMain.cpp attaches a RoverSim world, which gives
+ *  the encoder counts and the sensor readings.  Serial writes to stdout,
+ *  and EEPROM is 4 kB of RAM erased to 0xFF.
+ */
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <stdio.h>
+
+#ifndef HOST_CALLTIME
+#define HOST_CALLTIME   10          // [us] per millis() and micros() call
+#endif
+
+#define R8(n)   volatile uint8_t n;
+#define R16(n)  volatile uint16_t n;
+#define T16(n)  R8(TCCR##n##A) R8(TCCR##n##B) R8(TCCR##n##C) R16(OCR##n##A) R16(OCR##n##B) \
+                R16(OCR##n##C) R16(ICR##n) R16(TCNT##n) R8(TIMSK##n) R8(TIFR##n)
+#include <HostRegisters.h>
+
+HostSerial      Serial;
+
+static uint64_t         hostClock;          // [us]
+static volatile uint8_t ports[16];
+static uint8_t          eeprom[E2END + 1];
+static bool             eepromErased;
+static uint64_t         stopTime    = UINT64_MAX;
+static void             (*stopRun)(void);
+static uint16_t         callTime    = HOST_CALLTIME;
+static uint32_t         timer5Cycles;       // [1/16 us] not yet counted
+static void             (*pinInterrupts[A0 + 16])(void);   // digitalPinToInterrupt() = pin
+
+extern "C" void TIMER5_OVF_vect(void) __attribute__((weak));
+
+static void runTimer5(uint32_t us) {
+    static const uint16_t prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+    uint16_t    prescaler   = prescalers[TCCR5B & 7];
+    if (prescaler == 0) return;             // Stopped or external clock
+    if (TIMSK5 & (1 << TOIE5)) {            // Served at once.  Writing 1 to
+        TIFR5   &= ~(1 << TOV5);            //  clear it sets the variable
+    }
+    uint64_t    cycles      = (uint64_t) us * (F_CPU / 1000000) + timer5Cycles;
+    uint64_t    ticks       = cycles / prescaler;
+    timer5Cycles    = cycles % prescaler;
+    while (ticks) {
+        uint32_t    left    = 0x10000 - TCNT5;
+        if (ticks < left) {
+            TCNT5   += ticks;
+            break;
+        }
+        ticks   -= left;
+        TCNT5   = 0;
+        TIFR5   |= 1 << TOV5;
+        if ((TIMSK5 & (1 << TOIE5)) && TIMER5_OVF_vect) {
+            TIFR5   &= ~(1 << TOV5);
+            TIMER5_OVF_vect();
+        }
+    }
+}
+
+uint64_t hostTime() {return hostClock;}
+
+void hostAdvance(uint32_t us) {
+    hostClock   += us;
+    runTimer5(us);
+    if ((hostClock >= stopTime) && stopRun) {
+        stopTime    = UINT64_MAX;       // Once
+        stopRun();
+    }
+}
+
+void hostStopAt(uint64_t time, void (*stop)(void)) {
+    stopTime    = time;
+    stopRun     = stop;
+}
+
+void hostSetCallTime(uint16_t us) {callTime = us;}
+
+void hostInterrupt(uint8_t interrupt) {
+    if ((interrupt < A0 + 16) && pinInterrupts[interrupt]) pinInterrupts[interrupt]();
+}
+
+unsigned long millis() {
+    hostAdvance(callTime);
+    return (uint32_t) (hostClock / 1000);
+}
+
+unsigned long micros() {
+    hostAdvance(callTime);
+    return (uint32_t) hostClock & ~3UL;
+}
+
+void delay(unsigned long ms) {
+    while (ms--) hostAdvance(1000);     // Stops in the middle of a long delay
+}
+
+void delayMicroseconds(unsigned int us)     {hostAdvance(us);}
+
+void pinMode(uint8_t, uint8_t)              {}
+void digitalWrite(uint8_t, uint8_t)         {}
+int  digitalRead(uint8_t)                   {return HIGH;}
+int  analogRead(uint8_t)                    {return 0;}
+void analogWrite(uint8_t, int)              {}
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int) {
+    if (interrupt < A0 + 16) pinInterrupts[interrupt] = isr;
+}
+void cli()                                  {}
+void sei()                                  {}
+
+uint8_t digitalPinToPort(uint8_t pin)       {return pin & 15;}
+uint8_t digitalPinToBitMask(uint8_t pin)    {return 1 << (pin & 7);}
+uint8_t digitalPinToTimer(uint8_t pin) {    // The 16 bit timer pins of the Mega
+    switch (pin) {
+        case 2:     return TIMER3B;
+        case 3:     return TIMER3C;
+        case 5:     return TIMER3A;
+        case 6:     return TIMER4A;
+        case 7:     return TIMER4B;
+        case 8:     return TIMER4C;
+        case 11:    return TIMER1A;
+        case 12:    return TIMER1B;
+        case 44:    return TIMER5C;
+        case 45:    return TIMER5B;
+        case 46:    return TIMER5A;
+        default:    return NOT_ON_TIMER;    // Timers 0 and 2 or no PWM
+    }
+}
+volatile uint8_t *portOutputRegister(uint8_t port)  {return &ports[port & 15];}
+volatile uint8_t *portInputRegister(uint8_t port)   {return &ports[port & 15];}
+volatile uint8_t *portModeRegister(uint8_t port)    {return &ports[port & 15];}
+
+static uint8_t *eepromByte(uintptr_t address) {
+    if (!eepromErased) {
+        memset(eeprom, 0xFF, sizeof(eeprom));
+        eepromErased    = true;
+    }
+    return &eeprom[address & E2END];
+}
+
+uint8_t eeprom_read_byte(const uint8_t *address) {
+    return *eepromByte((uintptr_t) address);
+}
+
+uint16_t eeprom_read_word(const uint16_t *address) {
+    return eeprom_read_byte((const uint8_t *) address)
+        | (eeprom_read_byte((const uint8_t *) address + 1) << 8);
+}
+
+void eeprom_update_byte(uint8_t *address, uint8_t value) {
+    *eepromByte((uintptr_t) address) = value;
+}
+
+void eeprom_update_word(uint16_t *address, uint16_t value) {
+    eeprom_update_byte((uint8_t *) address, value);
+    eeprom_update_byte((uint8_t *) address + 1, value >> 8);
+}
+
+//---------------------------------------------------- Print -----------------
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t  n   = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+int Print::availableForWrite() {return 0;}
+
+size_t Print::print(const char *s) {
+    return write((const uint8_t *) s, strlen(s));
+}
+
+size_t Print::print(char c) {return write((uint8_t) c);}
+
+size_t Print::print(unsigned long n, int base) {
+    char    buffer[8 * sizeof(long) + 1];
+    char    *s  = &buffer[sizeof(buffer) - 1];
+    if (base < 2) base = DEC;
+    *s  = 0;
+    do {
+        uint8_t digit   = n % base;
+        *--s    = (digit < 10)? '0' + digit: 'A' + digit - 10;
+        n       /= base;
+    } while (n);
+    return print(s);
+}
+
+size_t Print::print(long n, int base) {
+    if ((base == DEC) && (n < 0)) return print('-') + print((unsigned long) -n, DEC);
+    return print((unsigned long) n, base);
+}
+
+size_t Print::print(int n, int base) {
+    if (base != DEC) return print((unsigned long) (uint16_t) n, base);    // 16 bit as on the Mega
+    return print((long) n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {return print((unsigned long) n, base);}
+
+size_t Print::print(double n, int digits) {
+    char    buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+    return print(buffer);
+}
+
+size_t Print::println() {return print("\r\n");}
+
+int  Stream::available()            {return 0;}
+int  Stream::read()                 {return -1;}
+void Stream::flush()                {}
+
+void HostSerial::begin(long)        {}
+
+size_t HostSerial::write(uint8_t c) {
+    putchar(c);
+    return 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+int HostSerial::availableForWrite() {return 63;}
+
+HostSerial::operator bool() {return true;}
@@ -0,0 +1,68 @@
+/**
+ *  File: HostMain.cpp
+ *
+ *  Run an unmodified rover sketch on a PC in simulated time
+ *
+ *  The sketch is included as it is, with setup() and loop() renamed
+ *      g++ -DSKETCH='"path/sketch.ino"' ...
+ *      ./scenario seconds [maxCollisions]
+ *  - The host room, 3 m x 2 m with a box in the right half, is attached
+ *    before setup(), so the WH_Rover sketches run without changes.  A
+ *    sketch that attaches its own RoverSim replaces it
+ *  - setup() is called once and loop() until the simulated time is over,
+ *    also when the sketch stops in a loop of its own (stopAll)
+ *  - The Serial output of the sketch goes to stdout
+ *  - The summary goes to stderr: simulated and real time, and the pose
+ *    and the collisions of the attached RoverSim
+ *  - The exit status is 1 when the collisions are over maxCollisions
+ *
+ *  run.sh builds and runs the scenarios of scenarios.txt in parallel.
+ */
+
+#include <Arduino.h>
+#include <WH_Rover.h>
+#include <RoverSim.h>
+#include <stdio.h>
+#include <time.h>
+
+#define setup   sketchSetup
+#define loop    sketchLoop
+#include SKETCH
+#undef setup
+#undef loop
+
+static RoverSim hostRoom;
+static long     maxCollisions;
+static clock_t  startClock;
+
+static void stopScenario() {
+    int         status      = 0;
+    fflush(stdout);
+    double      elapsed     = (double) (clock() - startClock) / CLOCKS_PER_SEC;
+    fprintf(stderr, "%6.1f s in %6.3f s", hostTime() / 1e6, elapsed);
+    RoverSim    *room       = (RoverSim *) getSimulator();  // The worlds are RoverSim
+    if (room) {
+        long    collisions  = room->collisions();
+        fprintf(stderr, "  x %5d  y %5d  heading %4ld  collisions %ld",
+            room->x(), room->y(), room->heading() * 360L / 65536, collisions);
+        if ((maxCollisions >= 0) && (collisions > maxCollisions)) {
+            fprintf(stderr, "  FAIL, max %ld", maxCollisions);
+            status  = 1;
+        }
+    }
+    fprintf(stderr, "\n");
+    exit(status);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t    duration    = (uint64_t) ((argc > 1)? atol(argv[1]): 60) * 1000000;
+    maxCollisions   = (argc > 2)? atol(argv[2]): -1;
+    startClock      = clock();
+    hostRoom.addBox(-1500,-1000,1500,1000);
+    hostRoom.addBox(600,-300,900,300);
+    hostRoom.setPose(-1000,0,0);
+    attachSimulator(&hostRoom);
+    hostStopAt(duration, stopScenario);
+    sketchSetup();
+    while (1) sketchLoop();
+}
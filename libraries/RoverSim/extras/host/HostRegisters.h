@@ -0,0 +1,15 @@
+// AVR registers used by the rover libraries, expanded with R8, R16, and T16
+
+R8(SREG)
+R8(PCICR)   R8(PCIFR)   R8(PCMSK0)  R8(PCMSK1)  R8(PCMSK2)
+R8(EIMSK)   R8(EIFR)    R8(EICRA)   R8(EICRB)
+R8(PINA)    R8(PINB)    R8(PINC)    R8(PIND)    R8(PINE)    R8(PINF)
+R8(PING)    R8(PINH)    R8(PINJ)    R8(PINK)    R8(PINL)
+R8(PORTA)   R8(PORTB)   R8(PORTC)   R8(PORTD)   R8(PORTE)   R8(PORTF)
+R8(PORTG)   R8(PORTH)   R8(PORTJ)   R8(PORTK)   R8(PORTL)
+R8(DDRA)    R8(DDRB)    R8(DDRK)    R8(DDRL)
+R8(TCCR0A)  R8(TCCR0B)  R8(OCR0A)   R8(OCR0B)   R8(TIMSK0)  R8(TCNT0)   R8(TIFR0)
+R8(TCCR2A)  R8(TCCR2B)  R8(OCR2A)   R8(OCR2B)   R8(TIMSK2)  R8(TCNT2)   R8(TIFR2)
+T16(1)      T16(3)      T16(4)      T16(5)
+R8(ADMUX)   R8(ADCSRA)  R8(ADCSRB)  R8(DIDR0)   R8(DIDR2)   R8(ADCL)    R8(ADCH)
+R16(ADC)
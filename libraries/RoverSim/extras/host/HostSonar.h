@@ -0,0 +1,99 @@
+#ifndef HOST_SONAR_H
+#define HOST_SONAR_H
+
+/**
+ *  HC_SR04 sensors and Timer 2 for the host tests
+ *
+ *  run() advances the host clock in 1 us steps and serves the interrupts
+ *  of the HC_SR04 library as the Mega would
+ *  - Timer 2 counts every 16 us while it has a clock, calls the compare B
+ *    interrupt at OCR2B and the compare A interrupt at OCR2A, where it
+ *    clears (CTC)
+ *  - A sensor starts its echo HOSTSONAR_DELAY us after the end of its
+ *    trigger pulse, and the echo lasts the round trip to the target at
+ *    20 C.  The echo pin change calls the PCINT2 interrupt
+ *  - The pins are those of the default HC_SR04_PINMAP, echoes on Port K
+ *  - millis() and micros() do not advance the clock (hostSetCallTime)
+ */
+
+#include <Arduino.h>
+#include <HC_SR04_PinMap.h>
+
+#define HOSTSONAR_DELAY     460     // [us] from the trigger to the echo
+#define HOSTSONAR_NOECHO    38000   // [us] echo of a sensor without a target
+#define HOSTSONAR_NMPERUS   170150UL    // Half of the speed of sound at 20 C
+
+extern "C" void TIMER2_COMPA_vect(void);
+extern "C" void TIMER2_COMPB_vect(void);
+extern "C" void PCINT2_vect(void);
+
+class HostSonar {
+public:
+    HostSonar() {
+        hostSetCallTime(0);
+        memset(_width, 0, sizeof(_width));
+        memset(_trigger, 0, sizeof(_trigger));
+        memset(_rise, 0, sizeof(_rise));
+        memset(_fall, 0, sizeof(_fall));
+        _prescaler  = 0;
+        for (uint8_t i=0;i<CHANNELS;i++) setRange(i, 0);
+    }
+
+    void setRange(uint8_t channel, uint16_t range) {    // [mm], 0 = no target
+        if (channel >= CHANNELS) return;
+        _width[channel] = range? range * 1000000UL / HOSTSONAR_NMPERUS: HOSTSONAR_NOECHO;
+    }
+
+    uint32_t width(uint8_t channel) {                  // [us]
+        return (channel < CHANNELS)? _width[channel]: 0;
+    }
+
+    void run(uint32_t duration) {                      // [us]
+        while (duration--) step();
+    }
+
+private:
+    static constexpr HC_SR04Pins pins[] = HC_SR04_PINMAP;
+    static const uint8_t CHANNELS = sizeof(pins) / sizeof(pins[0]);
+
+    void step() {
+        hostAdvance(1);
+        uint64_t    now     = hostTime();
+        for (uint8_t i=0;i<CHANNELS;i++) {
+            uint8_t     pin     = pins[i].trigPin;
+            bool        level   = *portOutputRegister(digitalPinToPort(pin))
+                                & digitalPinToBitMask(pin);
+            if (_trigger[i] && !level) {                // End of the trigger pulse
+                _rise[i]    = now + HOSTSONAR_DELAY;
+                _fall[i]    = _rise[i] + _width[i];
+            }
+            _trigger[i] = level;
+            uint8_t     echo    = 1 << (pins[i].echoPcint & 7);
+            if (now == _rise[i]) {
+                PINK    |= echo;
+                PCINT2_vect();
+            } else if (now == _fall[i]) {
+                PINK    &= ~echo;
+                PCINT2_vect();
+            }
+        }
+        if ((TCCR2B & 7) && (++_prescaler >= 16)) {    // 256 prescaler, 16 us
+            _prescaler  = 0;
+            if (TCNT2 == OCR2A) TCNT2 = 0;
+            else                TCNT2++;
+            if ((TCNT2 == OCR2B) && (TIMSK2 & (1 << OCIE2B))) TIMER2_COMPB_vect();
+            if ((TCNT2 == OCR2A) && (TIMSK2 & (1 << OCIE2A)) && (TCCR2B & 7)) {
+                TIMER2_COMPA_vect();
+            }
+        }
+    }
+
+    uint32_t    _width[CHANNELS];   // [us]
+    bool        _trigger[CHANNELS];
+    uint64_t    _rise[CHANNELS], _fall[CHANNELS];  // [us] host time of the echo edges
+    uint8_t     _prescaler;
+};
+
+constexpr HC_SR04Pins HostSonar::pins[];
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <stdint.h>
+
+#define E2END   4095                // 4 kB, erased to 0xFF at the start
+
+uint8_t     eeprom_read_byte(const uint8_t *address);
+uint16_t    eeprom_read_word(const uint16_t *address);
+void        eeprom_update_byte(uint8_t *address, uint8_t value);
+void        eeprom_update_word(uint16_t *address, uint16_t value);
+
+#endif
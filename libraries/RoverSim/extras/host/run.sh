@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# Build and run the rover scenarios on a PC, in parallel on all cores
+#
+#   libraries/RoverSim/extras/host/run.sh [scenarios.txt]
+#
+# The libraries are compiled once with the host core (HostCore.cpp) into
+# one archive, then every scenario links its unmodified sketch with
+# HostMain.cpp and runs it in simulated time.  A scenario can also be a
+# host test, a .cpp file with its own main() that gets the seconds and the
+# limit as arguments.  The output of scenario name is in $OUT/name.log
+# (default OUT=/tmp/roversim), and one summary line per scenario is
+# printed.  The exit status is 1 if a build failed, a scenario had more
+# collisions than allowed, or a host test failed.
+#
+# CXX and CXXFLAGS select the compiler, JOBS the parallel jobs.
+
+HOST=$(cd "$(dirname "$0")" && pwd)
+LIBS=$(cd "$HOST/../../.." && pwd)
+OUT=${OUT:-/tmp/roversim}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=gnu++11 -O2 -Wall -Wextra}
+JOBS=${JOBS:-$(nproc 2>/dev/null || echo 4)}
+export HOST LIBS OUT CXX CXXFLAGS
+
+INC="-I$HOST"
+for d in "$LIBS"/*/; do INC="$INC -I$d"; done
+export INC
+
+if [ "$1" = "--scenario" ]; then    # One scenario: name sketch seconds max
+    name=$2; sketch=$3; seconds=$4; max=$5
+    [ "$max" = "-" ] && max=-1
+    if [ "${sketch%.cpp}" != "$sketch" ]; then
+        set -- "$LIBS/$sketch"          # Host test with its own main()
+    else
+        set -- "-DSKETCH=\"$LIBS/$sketch\"" -x c++ "$HOST/HostMain.cpp" -x none
+    fi
+    if ! $CXX $CXXFLAGS $INC "$@" "$OUT/libhost.a" -o "$OUT/$name" 2> "$OUT/$name.err"; then
+        printf "%-12s build failed, see %s\n" "$name" "$OUT/$name.err"
+        exit 1
+    fi
+    summary=$("$OUT/$name" "$seconds" "$max" 2>&1 > "$OUT/$name.log")
+    status=$?
+    printf "%-12s %s\n" "$name" "$summary"
+    exit $status
+fi
+
+LIST=${1:-$HOST/scenarios.txt}
+mkdir -p "$OUT/obj"
+rm -f "$OUT"/obj/*.o
+
+for f in "$HOST/HostCore.cpp" "$LIBS"/*/*.cpp; do
+    grep -q '<Wire.h>' "$f" && continue             # No I2C on the host
+    echo "$f"
+done | xargs -P "$JOBS" -I{} sh -c \
+    '$CXX $CXXFLAGS $INC -c "{}" -o "$OUT/obj/$(basename "{}" .cpp).o"' || exit 1
+rm -f "$OUT/libhost.a"
+ar rcs "$OUT/libhost.a" "$OUT"/obj/*.o || exit 1  # Links only what is used
+
+grep -v '^#' "$LIST" | grep -v '^[[:space:]]*$' | \
+    xargs -P "$JOBS" -L 1 "$0" --scenario || exit 1
@@ -25,8 +25,71 @@
  *
  *  The current sense has negative voltage when the motor is autogenerating.
  *
+ *  The current sense input is sampled in background by AdcSampler.
+ *
  *  In this library, the PWM signal is controlled with a timer with values
  *  from 0 (no power) to 1023 (full power)
+ *
+ *  run() is called in tight loops during ramping, so it writes only what
+ *  changes
+ *  - The pins are resolved to output register and bit mask in the constructor
+ *  - The direction and the PWM value are cached
+ *    > A new power with the same sign only updates the PWM value
+ *    > The direction pins are written only when the sign changes
+ *    > The PWM is written only when the value changes
+ *  - Ports G - L are outside the bit instruction range, so the direction
+ *    bits are updated with interrupts disabled
+ *  The example Vnh2sp30_timing compares the cost to digitalWrite/analogWrite.
+ *
+ *  analogWrite() is 8 bit PWM at 490 Hz (980 Hz on pins 4 and 13), so power
+ *  values above 255 are all full power and the motors whine.  When the PWM
+ *  pin is on Timer 1, 3, or 4, the timer is set up instead for
+ *  - phase correct PWM with TOP in ICRn (mode 10), no prescaling
+ *  - TOP = VNH2SP30_PWMTOP, 400 gives 20 kHz, the limit of VNH2SP30
+ *  - power 0 .. 1023 is scaled linearly to OCRnx 0 .. TOP
+ *  The Arduino init() sets the timers for analogWrite after the global
+ *  constructors, so the constructor only brakes with the PWM pin low, and
+ *  begin() in setup() sets up the timer and writes the PWM.  writeDuty()
+ *  checks the mode and the prescaler of the timer and sets it up again if
+ *  begin() was not called or something else changed the timer.  The other
+ *  pins of the same timer get
+ *  the same frequency, so analogWrite on them is limited to 0 .. 255 of TOP.
+ *  Timer 5 is not used, it is the HC_SR04 timestamp clock.  Other pins,
+ *  like 9 and 10 on Timer 2, fall back to analogWrite with power / 4.
+ *
+ *  Current limiting is done in update(), which should be called every ms
+ *  or so.  The current values are ADC counts, same as current()
+ *  - The current sense input is oversampled with 1 bit, so there is a new
+ *    value about every 2 ms with four sampled inputs
+ *  - Foldback: while the current is over the limit, the power is reduced
+ *    by 1/8 in every 2 ms, about once per new current value.  Under the
+ *    limit the full power is restored in 64 steps, 128 ms.  The steps are
+ *    counted from millis(), so the time constants do not depend on how
+ *    often update() is called.  After a gap of more than 16 steps the
+ *    missed steps are not repeated
+ *  - Trip: if the current stays over the trip current for the trip time,
+ *    the motor is turned to coast and the state is isTripped.  run(),
+ *    stop(), and coast() are ignored until resetTrip()
+ *  - The limits are off until setCurrentLimit is called
+ *
+ *  run() changes the power immediately.  setTarget() lets update() change
+ *  the power gradually, so the program does not wait during the ramp
+ *  - setAcceleration(maxAcc) sets the time in ms for 1023 steps of power,
+ *    0 = no slew limit
+ *  - For every elapsed ms the power moves 1023 / maxAcc steps.  The
+ *    remainder is added with a DDA accumulator, so there is no division
+ *    in update()
+ *  - run(), stop(), and coast() cancel the slew
+ *
+ *  halt() is the emergency brake for interrupt routines
+ *  - Both direction pins low and PWM 0, same as stop(), in a few us
+ *  - The state is isHalted, and run(), stop(), coast(), and the slew are
+ *    ignored until resetTrip()
+ *  - update() does nothing while halted or tripped, so current() keeps
+ *    the last value before the halt.  Read AdcSampler for the live value
+ *  - drive(), stop(), and coast() check the state and write the pins with
+ *    interrupts disabled, so a halt() can not come between the check and
+ *    the writes and be overwritten when the interrupt returns
  * 
  *  A typical Vnh2sp30 boards are
  *  1. Single motor http://www.aliexpress.com/item/30A-Mini-VNH2SP30-Stepper-Motor-Driver-Monster-Moto-Shield-module-For-Arduino/32464304011.html
@@ -34,11 +97,23 @@
  */
  
 #include <Vnh2sp30.h>
+#include <AdcSampler.h>
 
 #define MAXDIGPIN 53
 #define MINANAPIN A0
 #define MAXENAPIN A1
 
+#define FOLDFULL    1024                          // Power scale for full power
+#define FOLDSHIFT   3                             // Reduce by 1/8 over the limit
+#define FOLDRECOVER (FOLDFULL / 64)               // Recover in 64 steps
+#define FOLDPERIOD  2                             // [ms] per foldback step
+#define FOLDSTEPS   16                            // Max steps in one update
+                                          // See 2560 datasheet section 17.11
+                                          // The bits are the same for all 16 bit timers
+#define PWMTCCRA  (1 << WGM11)                        // Mode 10, phase correct, TOP = ICRn
+#define PWMTCCRB  (1 << WGM13) | (1 << CS10)          // No prescaling
+#define WGMTCCRA  ((1 << WGM11) | (1 << WGM10))       // Mode bits in TCCRnA
+
 Vnh2sp30::Vnh2sp30( const uint8_t enaPin,   const uint8_t aPin,   const uint8_t bPin, 
                     const uint8_t pwmPin,   const uint8_t csPin,  const uint8_t inv) {
   _enaPin   = enaPin;                             // Store the Enable pin number
@@ -58,21 +133,122 @@ Vnh2sp30::Vnh2sp30( const uint8_t enaPin,   const uint8_t aPin,   const uint8_t
   }
 
   _power       = 0;                               // Init local variables
+  _target      = 0;
+  _maxAcc      = 0;
+  _slewSteps   = 0;
+  _slewRemainder = 0;
+  _slewAcc     = 0;
+  _slewTime    = 0;
+  _direction   = 0;
+  _duty        = -1;
   _current     = 0;
   _maxCurrent  = 0;
+  _limit       = 0;
+  _tripCurrent = 0;
+  _tripTime    = 0;
+  _over        = false;
+  _fold        = FOLDFULL;
+  _foldTime    = 0;
+  _limitCount  = 0;
+  _tripCount   = 0;
 
   if (_state != initError) {
     pinMode(_enaPin, OUTPUT);                     // set the output pins
     pinMode(_aPin,   OUTPUT);
     pinMode(_bPin,   OUTPUT);
     pinMode(_pwmPin, OUTPUT);
+    _enaPort  = portOutputRegister(digitalPinToPort(_enaPin));
+    _aPort    = portOutputRegister(digitalPinToPort(_aPin));
+    _bPort    = portOutputRegister(digitalPinToPort(_bPin));
+    _enaMask  = digitalPinToBitMask(_enaPin);
+    _aMask    = digitalPinToBitMask(_aPin);
+    _bMask    = digitalPinToBitMask(_bPin);
+    _timer    = digitalPinToTimer(_pwmPin);
+    switch (_timer) {                             // Resolve the PWM registers
+      case TIMER1A: _tccrA = &TCCR1A; _tccrB = &TCCR1B; _ocr = &OCR1A; _comMask = 1 << COM1A1; break;
+      case TIMER1B: _tccrA = &TCCR1A; _tccrB = &TCCR1B; _ocr = &OCR1B; _comMask = 1 << COM1B1; break;
+      case TIMER1C: _tccrA = &TCCR1A; _tccrB = &TCCR1B; _ocr = &OCR1C; _comMask = 1 << COM1C1; break;
+      case TIMER3A: _tccrA = &TCCR3A; _tccrB = &TCCR3B; _ocr = &OCR3A; _comMask = 1 << COM3A1; break;
+      case TIMER3B: _tccrA = &TCCR3A; _tccrB = &TCCR3B; _ocr = &OCR3B; _comMask = 1 << COM3B1; break;
+      case TIMER3C: _tccrA = &TCCR3A; _tccrB = &TCCR3B; _ocr = &OCR3C; _comMask = 1 << COM3C1; break;
+      case TIMER4A: _tccrA = &TCCR4A; _tccrB = &TCCR4B; _ocr = &OCR4A; _comMask = 1 << COM4A1; break;
+      case TIMER4B: _tccrA = &TCCR4A; _tccrB = &TCCR4B; _ocr = &OCR4B; _comMask = 1 << COM4B1; break;
+      case TIMER4C: _tccrA = &TCCR4A; _tccrB = &TCCR4B; _ocr = &OCR4C; _comMask = 1 << COM4C1; break;
+      default:      _ocr = NULL;                  // analogWrite
+    }
+    AdcSampler::addChannel(_csPin, 1);            // Sample current in background
+
+    _state  = isBreaking;                         // Brake, PWM pin low until begin()
+    writeEnable(true);
+    writeDirection(0);
+  }
+}
+
+void Vnh2sp30::begin() {                // In setup(), after the Arduino init()
+  if (_state == initError) return;
+  uint8_t sreg = SREG;
+  cli();
+  if (_ocr) connectPwm();
+  _duty = -1;                           // Write the PWM again
+  writeDuty(((uint32_t) abs(_power) * _fold) >> 10);
+  SREG = sreg;
+}
+
+void Vnh2sp30::writeEnable(bool enable) {
+  uint8_t sreg = SREG;
+  cli();
+  if (enable) *_enaPort |=  _enaMask;
+  else        *_enaPort &= ~_enaMask;
+  SREG = sreg;
+}
+
+void Vnh2sp30::writeDirection(int8_t direction) {
+  uint8_t sreg = SREG;
+  cli();                                // Read-modify-write of shared ports
+  if (direction > 0)  *_aPort |=  _aMask;
+  else                *_aPort &= ~_aMask;
+  if (direction < 0)  *_bPort |=  _bMask;
+  else                *_bPort &= ~_bMask;
+  SREG = sreg;
+  _direction = direction;
+}
+
+void Vnh2sp30::connectPwm() {
+  uint8_t sreg = SREG;
+  cli();
+  if ((*_tccrB != (PWMTCCRB))           // Timer as set by Arduino init()
+  ||  ((*_tccrA & WGMTCCRA) != PWMTCCRA)) {
+    *_tccrB   = 0;                      // Stop the timer
+    *_tccrA   = (*_tccrA & ~((1 << WGM11) | (1 << WGM10))) | PWMTCCRA;
+    switch (_timer) {
+      case TIMER1A: case TIMER1B: case TIMER1C: ICR1 = VNH2SP30_PWMTOP; TCNT1 = 0; break;
+      case TIMER3A: case TIMER3B: case TIMER3C: ICR3 = VNH2SP30_PWMTOP; TCNT3 = 0; break;
+      default:                                  ICR4 = VNH2SP30_PWMTOP; TCNT4 = 0; break;
+    }
+    *_tccrB   = PWMTCCRB;
+  }
+  *_tccrA |= _comMask;                  // Connect the pin, non-inverting
+  SREG = sreg;
+}
 
-    stop();                                       // Stop the motor
+void Vnh2sp30::writeDuty(int16_t duty) {
+  if (duty == _duty) return;
+  if (_ocr) {
+    if ((*_tccrB != (PWMTCCRB))         // Mode, prescaler, or pin not set up
+    ||  ((*_tccrA & (WGMTCCRA | _comMask)) != (PWMTCCRA | _comMask))) connectPwm();
+    uint16_t ocr = ((uint32_t) duty * VNH2SP30_PWMTOP + 512) >> 10;
+    uint8_t sreg = SREG;
+    cli();                              // 16 bit register uses the TEMP register
+    *_ocr = ocr;
+    SREG = sreg;
+  } else {
+    analogWrite(_pwmPin, duty >> 2);    // 8 bit PWM
   }
+  _duty = duty;
 }
 
-void Vnh2sp30::readCurrent() {
-  _current    = analogRead(_csPin);
+void Vnh2sp30::readCurrent() {                   // Latest value, no waiting
+  _current    = AdcSampler::read(_csPin);
   if (_maxCurrent < _current) _maxCurrent = _current;
 }
 
@@ -80,49 +256,207 @@ uint16_t Vnh2sp30::current() {return _current;}
 
 uint16_t Vnh2sp30::maxCurrent() {return _maxCurrent;}
 
-void Vnh2sp30::run(int16_t power) {     // 0 = no power, 1023 = full power
-  if (_state  == initError) return;
-
-  if (_state  == isCoasting) {
-    _state    = isRunning;
-    digitalWrite(_enaPin, HIGH);
+void Vnh2sp30::apply() {                // Power scaled by the foldback
+  uint16_t duty = ((uint32_t) abs(_power) * _fold) >> 10;
+  uint8_t sreg = SREG;
+  cli();                                // No halt() between the check and the writes
+  if (_state == isRunning) {
+    writeDuty(duty);
+    if (_power > 0) {
+      if (_direction != 1)  writeDirection(1);    // Forward command
+    } else {
+      if (_direction != -1) writeDirection(-1);   // Backward command
+    }
   }
+  SREG = sreg;
+}
+
+bool Vnh2sp30::isBlocked() {            // No commands in these states
+  return (_state == initError) || (_state == isTripped) || (_state == isHalted);
+}
 
+void Vnh2sp30::run(int16_t power) {     // 0 = no power, 1023 = full power
   if (power > 1023)   power = 1023;     // Clamp the setpoints
   if (power < -1023)  power = -1023;
-  _power = power;
+  _target = power;
+  drive(power);
+}
 
-  if (_power > 0) {
-    analogWrite(_pwmPin, _power);       // Forward command
-    digitalWrite(_aPin, HIGH);
-    digitalWrite(_bPin, LOW);
-  } else {
-    analogWrite(_pwmPin, -_power);      // Backward command
-    digitalWrite(_aPin, LOW);
-    digitalWrite(_bPin, HIGH);
+void Vnh2sp30::drive(int16_t power) {
+  uint8_t sreg = SREG;
+  cli();
+  if (!isBlocked()) {
+    if (_state  == isCoasting) writeEnable(true);
+    _state    = isRunning;
+    _power    = power;
+    apply();
   }
+  SREG = sreg;
 }
 
 int16_t Vnh2sp30::power() {return _power;}
 
 void Vnh2sp30::stop() {
-  if (_state != initError) {
+  uint8_t sreg = SREG;
+  cli();
+  if (!isBlocked()) {
     _state    = isBreaking;
     _power    = 0;
-    digitalWrite(_enaPin, HIGH);
-    digitalWrite(_aPin, LOW);
-    digitalWrite(_bPin, LOW);       // Short circuit outputs together
-    analogWrite(_pwmPin,0);
+    _target   = 0;
+    writeEnable(true);
+    writeDirection(0);              // Short circuit outputs together
+    writeDuty(0);
   }
+  SREG = sreg;
 }
 
 void Vnh2sp30::coast() {
-  if (_state != initError) {
+  uint8_t sreg = SREG;
+  cli();
+  if (!isBlocked()) {
     _state    = isCoasting;
     _power    = 0;
-    digitalWrite(_enaPin, LOW);     // Turn outputs to high impedance
-    analogWrite(_pwmPin,0);
+    _target   = 0;
+    writeEnable(false);             // Turn outputs to high impedance
+    writeDuty(0);
   }
+  SREG = sreg;
+}
+
+void Vnh2sp30::halt() {             // Also from the main program
+  if (_state == initError) return;
+  uint8_t sreg = SREG;
+  cli();
+  writeDirection(0);                // Brake first, then enable if it was coasting
+  writeDuty(0);
+  writeEnable(true);
+  _state    = isHalted;
+  _power    = 0;
+  _target   = 0;
+  SREG = sreg;
 }
 
 MotorState  Vnh2sp30::state() {return _state;}
+
+void Vnh2sp30::slew() {
+  uint32_t now      = millis();
+  uint32_t elapsed  = now - _slewTime;
+  _slewTime = now;
+  if (_power == _target) return;
+  if (_maxAcc == 0) {
+    drive(_target);
+    return;
+  }
+
+  int16_t   step  = 0;
+  while (elapsed-- && (step < 2046)) {  // Steps for the elapsed time
+    step += _slewSteps;
+    _slewAcc += _slewRemainder;
+    if (_slewAcc >= _maxAcc) {
+      _slewAcc -= _maxAcc;
+      step++;
+    }
+  }
+  if (step == 0) return;
+
+  int16_t   power;
+  if (_target > _power) {
+    power = (_target - _power > step)? _power + step: _target;
+  } else {
+    power = (_power - _target > step)? _power - step: _target;
+  }
+  drive(power);
+}
+
+void Vnh2sp30::update() {
+  if (isBlocked()) return;
+  slew();
+  readCurrent();
+
+  if (_tripCurrent && (_current > _tripCurrent)) {
+    uint32_t now = millis();
+    if (!_over) {
+      _over       = true;
+      _overSince  = now;
+    } else if (now - _overSince >= _tripTime) {
+      uint8_t sreg = SREG;
+      cli();
+      coast();                      // Not if halted in between
+      if (_state == isCoasting) _state = isTripped;
+      SREG = sreg;
+      _over       = false;
+      _tripCount++;
+      return;
+    }
+  } else {
+    _over   = false;
+  }
+
+  if (_limit == 0) return;
+  uint32_t now    = millis();
+  uint8_t  steps  = 0;
+  while ((now - _foldTime >= FOLDPERIOD) && (steps < FOLDSTEPS)) {
+    _foldTime += FOLDPERIOD;
+    steps++;
+  }
+  if (steps == FOLDSTEPS) _foldTime = now;        // Long gap, no catch up
+  if (steps == 0) return;
+
+  uint16_t fold = _fold;
+  if (_current > _limit) {
+    if (fold == FOLDFULL) _limitCount++;
+    while (steps--) fold -= fold >> FOLDSHIFT;
+  } else if (fold < FOLDFULL) {
+    fold += steps * FOLDRECOVER;
+    if (fold > FOLDFULL) fold = FOLDFULL;
+  }
+  if (fold != _fold) {
+    _fold = fold;
+    if (_state == isRunning) apply();
+  }
+}
+
+void Vnh2sp30::setCurrentLimit(uint16_t limit, uint16_t tripCurrent, uint16_t tripTime) {
+  _limit        = limit;
+  _tripCurrent  = tripCurrent;
+  _tripTime     = tripTime;
+  _over         = false;
+  _fold         = FOLDFULL;
+  _foldTime     = millis();
+}
+
+void Vnh2sp30::resetTrip() {
+  uint8_t sreg = SREG;
+  cli();
+  if (_state == isTripped) {
+    _state  = isCoasting;
+    _fold   = FOLDFULL;
+  } else if (_state == isHalted) {
+    _state  = isBreaking;           // Still braking after halt()
+  }
+  SREG = sreg;
+}
+
+uint16_t Vnh2sp30::limitCount() {return _limitCount;}
+
+uint16_t Vnh2sp30::tripCount() {return _tripCount;}
+
+void Vnh2sp30::setTarget(int16_t power) {
+  if (power > 1023)   power = 1023;     // Clamp the setpoints
+  if (power < -1023)  power = -1023;
+  if (_target == _power) {              // Start a new slew
+    _slewTime = millis();
+    _slewAcc  = 0;
+  }
+  _target = power;
+}
+
+int16_t Vnh2sp30::target() {return _target;}
+
+void Vnh2sp30::setAcceleration(uint16_t maxAcc) {
+  _maxAcc         = maxAcc;
+  if (maxAcc == 0) return;
+  _slewSteps      = 1023 / maxAcc;
+  _slewRemainder  = 1023 % maxAcc;
+  _slewAcc        = 0;
+}
@@ -3,12 +3,17 @@
 
 #include <Arduino.h>
 
-typedef enum  motorStates {initError,isRunning,isBreaking,isCoasting} MotorState;
+#ifndef VNH2SP30_PWMTOP
+#define VNH2SP30_PWMTOP 400           // 16 MHz / (2 * 400) = 20 kHz
+#endif
+
+typedef enum  motorStates {initError,isRunning,isBreaking,isCoasting,isTripped,isHalted} MotorState;
 
 class Vnh2sp30 {
   public:
     Vnh2sp30(   const uint8_t enaPin,   const uint8_t aPin,   const uint8_t bPin, 
                 const uint8_t pwmPin,   const uint8_t csPin,  const uint8_t inv);
+    void        begin();              // Set up the PWM timer, call in setup()
     void        readCurrent();
     uint16_t    current();
     uint16_t    maxCurrent();
@@ -16,13 +21,52 @@ class Vnh2sp30 {
     int16_t     power();
     void        stop();
     void        coast();
+    void        halt();               // Brake in an interrupt, latched until resetTrip()
     MotorState  state();
+    void        update();             // Call every ms or so
+    void        setCurrentLimit(uint16_t limit, uint16_t tripCurrent, uint16_t tripTime);
+    void        resetTrip();
+    uint16_t    limitCount();
+    uint16_t    tripCount();
+    void        setTarget(int16_t power); // -1023 .. + 1023, reached in update()
+    int16_t     target();
+    void        setAcceleration(uint16_t maxAcc);
   private:
+    void        drive(int16_t power);
+    void        slew();
+    void        apply();
+    bool        isBlocked();
+    void        writeEnable(bool enable);
+    void        writeDirection(int8_t direction);
+    void        writeDuty(int16_t duty);
+    void        connectPwm();
     uint8_t     _enaPin, _aPin, _bPin, _pwmPin, _csPin;
+    volatile uint8_t  *_enaPort, *_aPort, *_bPort;  // Output registers
+    uint8_t     _enaMask, _aMask, _bMask;
+    int8_t      _direction;           // 1 = A, -1 = B, 0 = both low
+    int16_t     _duty;                // Last PWM value, -1 = not written
+    uint8_t     _timer;               // 16 bit timer of the PWM pin
+    volatile uint8_t  *_tccrA, *_tccrB;
+    volatile uint16_t *_ocr;          // NULL = analogWrite
+    uint8_t     _comMask;             // Output compare mode bit in TCCRnA
     uint16_t    _maxAcc;              // [ms] to accelerate 1023 steps in power
+    int16_t     _target;              // Power at the end of the slew
+    uint16_t    _slewSteps;           // 1023 / _maxAcc, steps in every ms
+    uint16_t    _slewRemainder;       // 1023 % _maxAcc, DDA increment
+    uint16_t    _slewAcc;             // DDA accumulator
+    uint32_t    _slewTime;            // [ms] of the last slew step
     int16_t     _power;               // -1023 .. + 1023
     uint16_t    _current;             // from CS input
     uint16_t    _maxCurrent;          // max current during run time
     MotorState  _state;               // motor state
+    uint16_t    _limit;               // Foldback current, 0 = no limit
+    uint16_t    _tripCurrent;         // Trip current, 0 = no trip
+    uint16_t    _tripTime;            // [ms] over trip current before trip
+    uint32_t    _overSince;           // [ms] when trip current was exceeded
+    bool        _over;                // Over trip current
+    uint16_t    _fold;                // Power scale, 1024 = full power
+    uint32_t    _foldTime;            // [ms] of the last foldback step
+    uint16_t    _limitCount;          // Times the limit started foldback
+    uint16_t    _tripCount;           // Times the motor was tripped
 };
 #endif
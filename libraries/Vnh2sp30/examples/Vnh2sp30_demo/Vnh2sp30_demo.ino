@@ -20,7 +20,9 @@
 Vnh2sp30  mtrL( A0, 7,  8,  5,    A2,   0);             // Left side straight
 Vnh2sp30  mtrR( A1, 4,  9,  6,    A3,   1);             // Right side reversed
 
-void setup() {                          // No setup required
+void setup() {
+  mtrL.begin();                         // 20 kHz PWM timers
+  mtrR.begin();
 }
 
 void loop() {
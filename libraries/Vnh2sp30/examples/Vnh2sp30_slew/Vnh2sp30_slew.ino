@@ -0,0 +1,43 @@
+/**
+ * Demonstrate the non-blocking slew limit of Vnh2sp30
+ *  - Both motors accelerate from full reverse to full forward and back
+ *  - Full scale (1023 steps) takes 1 second, so a reversal takes 2 seconds
+ *  - The loop keeps running during the ramps and blinks the LED
+ *
+ *  Use Serial Monitor to see the power every 100 ms
+ */
+
+#include <Vnh2sp30.h>
+
+//              ENA A   B   PWM   CS    inv
+Vnh2sp30  mtrL( A0, 7,  8,  5,    A2,   0);             // Left side straight
+Vnh2sp30  mtrR( A1, 4,  9,  6,    A3,   1);             // Right side reversed
+
+uint32_t  printTime;
+
+void setup() {
+  Serial.begin(230400);
+  pinMode(LED_BUILTIN, OUTPUT);
+  mtrL.begin();                         // 20 kHz PWM timers
+  mtrR.begin();
+  mtrL.setAcceleration(1000);           // 1 s for 1023 steps
+  mtrR.setAcceleration(1000);
+}
+
+void loop() {
+  mtrL.update();                        // Slew towards the target
+  mtrR.update();
+
+  if (mtrL.power() == mtrL.target()) {  // Reverse at the end of a ramp
+    int16_t target = (mtrL.target() > 0)? -1023: 1023;
+    mtrL.setTarget(target);
+    mtrR.setTarget(target);
+  }
+
+  if (millis() - printTime >= 100) {
+    printTime = millis();
+    Serial.print(mtrL.power());         Serial.print('\t');
+    Serial.println(mtrR.power());
+    digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+  }
+}
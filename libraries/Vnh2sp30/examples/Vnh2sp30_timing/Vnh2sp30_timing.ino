@@ -0,0 +1,67 @@
+/**
+ * Measure the cost of Vnh2sp30::run() during a ramp
+ *  - Same motor wiring as Vnh2sp30_demo, only the left motor is used
+ *  - The motor is powered, so lift the wheels or disconnect the motor
+ *  - The ramp calls run() 1000 times with power changing in small steps,
+ *    as the ramps in WH_Rover do
+ *    > "ramp" changes only the magnitude
+ *    > "same" repeats the same power
+ *    > "flip" changes the direction on every call
+ *  - "pins" is the earlier run() code with analogWrite and two digitalWrite
+ *
+ *  Use Serial Monitor to see the time of one call in CPU cycles
+ */
+
+#include <Vnh2sp30.h>
+
+#define CALLS 1000
+
+//              ENA A   B   PWM   CS    inv
+Vnh2sp30  mtrL( A0, 7,  8,  5,    A2,   0);
+
+void pinsRun(int16_t power) {         // Earlier implementation
+  if (power > 0) {
+    analogWrite(5, power);
+    digitalWrite(7, HIGH);
+    digitalWrite(8, LOW);
+  } else {
+    analogWrite(5, -power);
+    digitalWrite(7, LOW);
+    digitalWrite(8, HIGH);
+  }
+}
+
+void report(const char *name, uint32_t duration) {
+  Serial.print(name);                 Serial.print('\t');
+  Serial.println(duration * 16 / CALLS);  // 16 cycles per us
+}
+
+void setup() {
+  Serial.begin(230400);
+  mtrL.begin();
+  Serial.println("test\tcycles");
+}
+
+void loop() {
+  uint32_t  start;
+
+  start = micros();
+  for (int16_t i=0;i<CALLS;i++) pinsRun(i);
+  report("pins", micros() - start);
+
+  start = micros();
+  for (int16_t i=0;i<CALLS;i++) mtrL.run(i);
+  report("ramp", micros() - start);
+
+  start = micros();
+  for (int16_t i=0;i<CALLS;i++) mtrL.run(500);
+  report("same", micros() - start);
+
+  start = micros();
+  for (int16_t i=0;i<CALLS;i++) mtrL.run((i & 1)? 500: -500);
+  report("flip", micros() - start);
+
+  mtrL.coast();
+  Serial.println();
+  delay(2000);
+}
@@ -0,0 +1,113 @@
+/**
+ *  File: Vnh2sp30_writes.cpp
+ *
+ *  Host test of the Vnh2sp30 output writes
+ *
+ *  run() writes only what changes, so before every command the test puts
+ *  a sentinel into OCR3A and inverts the direction bits in the port
+ *  variables.  A register that was not written keeps the marker
+ *  - OCR3A must be TOP * power / 1024 when |power| changed, else untouched
+ *  - The direction bits must be written when the sign changed, else
+ *    untouched
+ *  - begin() sets Timer 3 to 20 kHz phase correct PWM, and writeDuty()
+ *    sets it up again when something else changed the timer
+ *  - stop() brakes with both direction bits low and OCR3A 0
+ *  The powers are a pseudo random walk over -1023 .. 1023 with repeats.
+ *
+ *      ./Vnh2sp30_writes               (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <Vnh2sp30.h>
+#include <stdio.h>
+
+#define ENAPIN      22
+#define APIN        23
+#define BPIN        25
+#define PWMPIN      5               // Timer 3 A
+#define COMMANDS    20000
+#define SENTINEL    0xBEEF
+
+Vnh2sp30    motor(ENAPIN, APIN, BPIN, PWMPIN, A2, 0);
+
+static volatile uint8_t *aPort  = portOutputRegister(digitalPinToPort(APIN));
+static volatile uint8_t *bPort  = portOutputRegister(digitalPinToPort(BPIN));
+static const uint8_t    aMask   = digitalPinToBitMask(APIN);
+static const uint8_t    bMask   = digitalPinToBitMask(BPIN);
+
+static uint16_t     errors;
+
+static void check(bool ok, const char *what, int16_t power) {
+    if (!ok && (errors++ < 20)) printf("%s at power %d\n", what, power);
+}
+
+static int8_t direction() {         // 1 = A, -1 = B, 0 = both low, 2 = both high
+    bool    a   = *aPort & aMask;
+    bool    b   = *bPort & bMask;
+    return (a && b)? 2: a? 1: b? -1: 0;
+}
+
+static uint16_t expectedOcr(int16_t power) {
+    return ((uint32_t) abs(power) * VNH2SP30_PWMTOP + 512) >> 10;
+}
+
+int main() {
+    uint32_t    ocrWrites   = 0;
+    uint32_t    directionWrites = 0;
+    int16_t     power       = 0;
+    int16_t     duty        = -1;
+    int8_t      sign        = 0;
+    uint32_t    seed        = 1;
+
+    motor.begin();
+    check(TCCR3B == ((1 << WGM13) | (1 << CS10)), "TCCR3B", 0);
+    check((TCCR3A & ((1 << WGM11) | (1 << WGM10) | (1 << COM3A1)))
+        == ((1 << WGM11) | (1 << COM3A1)), "TCCR3A", 0);
+    check(ICR3 == VNH2SP30_PWMTOP, "ICR3", 0);
+    check(direction() == 0, "brake", 0);
+
+    for (uint32_t i=0;i<COMMANDS;i++) {
+        seed    = seed * 1103515245 + 12345;
+        switch ((seed >> 16) & 7) {
+            case 0:     break;                              // Same power
+            case 1:     power = -power; break;              // Same duty
+            case 2:     power = ((seed >> 8) & 2047) - 1023; break;
+            default:    power += (int8_t) (seed >> 8) / 8;  // Small steps
+        }
+        power   = constrain(power, -1023, 1023);
+        if ((i % 1000) == 999) TCCR3B = 0;  // Timer changed behind the library
+        bool    reconnect   = TCCR3B == 0;
+
+        OCR3A   = SENTINEL;
+        *aPort  ^= aMask;
+        *bPort  ^= bMask;
+        int8_t  marked      = direction();
+        motor.run(power);
+
+        int8_t  newSign     = (power > 0)? 1: -1;
+        if (abs(power) != duty) {
+            check(OCR3A == expectedOcr(power), "OCR3A value", power);
+            if (reconnect) check(TCCR3B == ((1 << WGM13) | (1 << CS10)), "reconnect", power);
+            ocrWrites++;
+        } else {
+            check(OCR3A == SENTINEL, "OCR3A written", power);
+        }
+        if (newSign != sign) {
+            check(direction() == newSign, "direction", power);
+            directionWrites++;
+        } else {
+            check(direction() == marked, "direction written", power);
+            *aPort  ^= aMask;
+            *bPort  ^= bMask;
+        }
+        duty    = abs(power);
+        sign    = newSign;
+    }
+    motor.stop();
+    check((direction() == 0) && (OCR3A == 0), "stop", 0);
+
+    fprintf(stderr, "%u commands, %lu OCR writes, %lu direction writes, %u errors%s\n",
+        COMMANDS, (unsigned long) ocrWrites, (unsigned long) directionWrites,
+        errors, errors? "  FAIL": "");
+    return errors? 1: 0;
+}
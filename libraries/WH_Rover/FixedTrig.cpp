@@ -0,0 +1,39 @@
+/**
+ *  File: FixedTrig.cpp
+ *
+ *  Integer sine and cosine for headings and bearings
+ *
+ *  The angle is a binary angle, 65536 units is a full turn, so the angle
+ *  wraps around without any checks.  The result is scaled by 16384.
+ *  - A quarter wave of 65 points is stored in flash
+ *  - The point is selected with the top bits of the angle and the low
+ *    8 bits interpolate between two points
+ *  - The largest error is 2 / 16384, less than 0.01 %
+ */
+
+#include <FixedTrig.h>
+
+static const int16_t sineTable[65] PROGMEM = {
+    0, 402, 804, 1205, 1606, 2006, 2404, 2801, 3196, 3590, 3981, 4370, 4756,
+    5139, 5520, 5897, 6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765, 9102, 9434,
+    9760, 10080, 10394, 10702, 11003, 11297, 11585, 11866, 12140, 12406, 12665, 12916, 13160,
+    13395, 13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978, 15137, 15286, 15426, 15557,
+    15679, 15791, 15893, 15986, 16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379, 16384};
+
+int16_t isin(uint16_t angle) {
+    uint16_t    a       = angle & 0x3FFF;           // Angle in the quarter
+    if (angle & 0x4000) a = 0x4000 - a;             // 2nd and 4th quarters
+    uint8_t     i       = a >> 8;
+    uint8_t     frac    = a & 0xFF;
+    int16_t     y0      = pgm_read_word(&sineTable[i]);
+    int16_t     y       = y0;
+    if (frac) {
+        int16_t y1      = pgm_read_word(&sineTable[i + 1]);
+        y   += ((int32_t) (y1 - y0) * frac) >> 8;
+    }
+    return (angle & 0x8000)? -y: y;
+}
+
+int16_t icos(uint16_t angle) {
+    return isin(angle + 0x4000);
+}
@@ -0,0 +1,12 @@
+#ifndef FIXEDTRIG_H
+#define FIXEDTRIG_H
+
+#include <Arduino.h>
+
+#define FIXEDTRIG_ONE       16384   // 1.0 in the sine and cosine results
+#define FIXEDTRIG_DEG(d)    ((uint16_t) ((int32_t) (d) * 65536L / 360))
+
+int16_t isin(uint16_t angle);       // 65536 = 360 deg
+int16_t icos(uint16_t angle);
+
+#endif
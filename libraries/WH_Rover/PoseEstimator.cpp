@@ -0,0 +1,80 @@
+/**
+ *  File: PoseEstimator.cpp
+ *
+ *  Integer dead reckoning of the rover position and heading
+ *
+ *  The pose is x and y in mm with 8 fraction bits and the heading as a
+ *  binary angle (65536 = 360 deg, 0 = +x, counter clockwise) with 8
+ *  fraction bits, so the rounding of the small steps does not add up.
+ *  The heading is kept in 32 bits, which wrap at 256 turns, so the 16 bit
+ *  angle is always the upper part.
+ *
+ *  update() takes the wheel travel in encoder counts since the last call
+ *  - distance = (left + right) / 2 counts, scaled to mm
+ *  - turn = (right - left) / track, scaled to binary angle
+ *  - The step is taken along the heading at the middle of the turn,
+ *    with isin and icos from the flash table (FixedTrig.cpp)
+ *  The scales are calculated in the constructor, so there is no division
+ *  in update().  With 1000 counts/m and 200 mm track one count is 1 mm
+ *  and one count of difference is 0.29 deg.  The turn scale is 32 bits,
+ *  because countsPerM * track under 40745 (for example 100 counts/m and
+ *  300 mm) gives a scale over 65535.
+ *
+ *  correctHeading() is a complementary filter for an absolute heading,
+ *  for example from an IMU.  The wheels are trusted in the short term,
+ *  and gain / 256 of the heading error is corrected in every call.
+ *
+ *  The estimator has no hardware access.  WH_Rover feeds it every 20 ms
+ *  with the encoder counts or with counts from a power model.
+ */
+
+#include <PoseEstimator.h>
+#include <FixedTrig.h>
+
+#define RAD256          2670177UL   // 65536 * 256 / (2 * pi), binary angle [1/256] per rad
+#define MM65536         65536000UL  // 1000 mm * 65536
+
+PoseEstimator::PoseEstimator(uint16_t track, uint16_t countsPerM) {
+    _mmScale    = (countsPerM == 0)? 0: MM65536 / countsPerM;
+    uint32_t    base    = (uint32_t) countsPerM * track;    // Over 16 bits for a small rover
+    _turnScale  = (base == 0)? 0: RAD256 * 1000 / base;
+    reset();
+}
+
+void PoseEstimator::reset(int32_t x, int32_t y, uint16_t heading) {
+    _x          = x * 256;
+    _y          = y * 256;
+    _heading    = (uint32_t) heading << 8;
+    _distance   = 0;
+}
+
+void PoseEstimator::update(int16_t left, int16_t right) {
+    int32_t     step    = (((int32_t) left + right) * (int32_t) _mmScale) >> 9;   // [1/256 mm]
+    int32_t     turn    = ((int32_t) right - left) * (int32_t) _turnScale; // [1/256 binary angle]
+    uint16_t    mid     = (_heading + turn / 2) >> 8;
+    _x          += ((step >> 2) * icos(mid)) >> 12;     // No overflow up to 2 m
+    _y          += ((step >> 2) * isin(mid)) >> 12;
+    _heading    += turn;
+    _distance   += step;
+}
+
+void PoseEstimator::correctHeading(uint16_t heading, uint8_t gain) {
+    int16_t     error   = heading - (uint16_t) (_heading >> 8);
+    _heading    += (int32_t) error * gain;
+}
+
+int32_t PoseEstimator::x() {
+    return _x >> 8;
+}
+
+int32_t PoseEstimator::y() {
+    return _y >> 8;
+}
+
+uint16_t PoseEstimator::heading() {
+    return _heading >> 8;
+}
+
+int32_t PoseEstimator::distance() {
+    return _distance >> 8;
+}
@@ -0,0 +1,24 @@
+#ifndef POSEESTIMATOR_H
+#define POSEESTIMATOR_H
+
+#include <Arduino.h>
+
+class PoseEstimator {
+public:
+    PoseEstimator(uint16_t track, uint16_t countsPerM);     // [mm], encoder counts
+    void        reset(int32_t x = 0, int32_t y = 0, uint16_t heading = 0);
+    void        update(int16_t left, int16_t right);        // Counts since the last update
+    void        correctHeading(uint16_t heading, uint8_t gain);     // gain / 256 of the error
+    int32_t     x();                                        // [mm]
+    int32_t     y();
+    uint16_t    heading();                                  // 65536 = 360 deg, CCW
+    int32_t     distance();                                 // [mm] travelled, signed
+private:
+    int32_t     _x, _y;             // [1/256 mm]
+    uint32_t    _heading;           // [1/256 binary angle], wraps at 256 turns
+    int32_t     _distance;          // [1/256 mm]
+    uint32_t    _mmScale;           // [1/65536 mm] per count
+    uint32_t    _turnScale;         // [1/256 binary angle] per count of difference
+};
+
+#endif
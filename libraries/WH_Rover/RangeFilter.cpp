@@ -0,0 +1,84 @@
+/**
+ *  File: RangeFilter.cpp
+ *
+ *  Integer Kalman filter for a single distance
+ *
+ *  The state is the distance in mm and its variance in mm^2.
+ *  - predict() increases the variance by the process noise times the
+ *    elapsed time, because the rover or the target can move
+ *  - update() combines a measurement with its standard deviation (sigma)
+ *    > gain = variance / (variance + sigma^2), scaled by 256
+ *    > distance += gain * (measurement - distance)
+ *    > variance -= gain * variance
+ *  - Measurements with sigma 0 are ignored (out of the sensor range)
+ *
+ *  With several sensors, each sensor is an update with its own sigma, so
+ *  the sensor with the smallest sigma has the highest weight.
+ *
+ *  The confidence is 100 % * 20 mm / (20 mm + sigma), for example
+ *      sigma   5 mm    80 %
+ *      sigma  20 mm    50 %
+ *      sigma 180 mm    10 %
+ */
+
+#include <RangeFilter.h>
+
+#define MAXVARIANCE     4000000UL       // 2000 mm sigma, no information
+#define GAINSHIFT       8
+#define SIGMAREF        20              // [mm] sigma for 50 % confidence
+
+static uint16_t isqrt32(uint32_t x) {   // Integer square root
+    uint32_t    root    = 0;
+    uint32_t    bit     = 1UL << 30;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x       -= root + bit;
+            root    = (root >> 1) + bit;
+        } else {
+            root    >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+RangeFilter::RangeFilter(uint16_t processNoise) {
+    _processNoise   = processNoise;
+    reset();
+}
+
+void RangeFilter::reset() {
+    _distance   = 0;
+    _variance   = MAXVARIANCE;
+    _lastTime   = 0;
+}
+
+void RangeFilter::predict(uint32_t now) {
+    uint32_t    dt  = now - _lastTime;
+    _lastTime   = now;
+    if (dt > MAXVARIANCE / _processNoise) dt = MAXVARIANCE / _processNoise;
+    _variance   += dt * _processNoise;
+    if (_variance > MAXVARIANCE) _variance = MAXVARIANCE;
+}
+
+void RangeFilter::update(int16_t distance, uint16_t sigma) {
+    if (sigma == 0) return;             // Not a valid measurement
+    uint32_t    r       = (uint32_t) sigma * sigma;
+    uint32_t    gain    = (_variance << GAINSHIFT) / (_variance + r);
+    _distance   += ((int32_t) gain * (distance - _distance)) >> GAINSHIFT;
+    _variance   -= (gain * _variance) >> GAINSHIFT;
+    if (_variance < 1) _variance = 1;
+}
+
+int16_t RangeFilter::distance() {
+    return _distance;
+}
+
+uint16_t RangeFilter::sigma() {
+    return isqrt32(_variance);
+}
+
+uint8_t RangeFilter::confidence() {
+    return 100UL * SIGMAREF / (SIGMAREF + sigma());
+}
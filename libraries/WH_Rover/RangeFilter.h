@@ -0,0 +1,22 @@
+#ifndef RANGEFILTER_H
+#define RANGEFILTER_H
+
+#include <Arduino.h>
+
+class RangeFilter {
+public:
+    RangeFilter(uint16_t processNoise = 4);     // [mm^2 / ms]
+    void        reset();
+    void        predict(uint32_t now);          // [ms]
+    void        update(int16_t distance, uint16_t sigma);   // [mm]
+    int16_t     distance();                     // [mm]
+    uint16_t    sigma();                        // [mm]
+    uint8_t     confidence();                   // [%]
+private:
+    uint16_t    _processNoise;
+    int32_t     _distance;
+    uint32_t    _variance;
+    uint32_t    _lastTime;
+};
+
+#endif
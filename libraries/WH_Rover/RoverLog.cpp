@@ -0,0 +1,132 @@
+/**
+ *  File: RoverLog.cpp
+ *
+ *  Binary telemetry records in a RAM ring buffer
+ *
+ *  A text line for every 20 ms sample would take more time on Serial than
+ *  the control loop can wait.  The samples are stored as binary records,
+ *  and drain() writes a bounded number of bytes at the time.
+ *
+ *  Record formats, multi-byte values are little endian
+ *      Header  C3, field count, tab separated names, 0
+ *      Key     A5, time [ms] uint32_t, fieldCount * int16_t, checksum
+ *      Delta   5A, time change [ms] uint8_t, fieldCount * int8_t, checksum
+ *  The checksum is the low byte of the sum of the preceding record bytes.
+ *
+ *  A delta record has the change of every field from the previous record.
+ *  A key record is written
+ *  - for the first record and every 50th record, so the decoder can start
+ *    in the middle of a capture
+ *  - when the time change or a field change does not fit into a delta
+ *  - after a record was dropped because the ring was full
+ *
+ *  With 13 fields a key record is 32 bytes and a delta record 16 bytes,
+ *  so 50 records per second take about 830 bytes per second.
+ *
+ *  The host decoder extras/roverlog.py writes the records into columns.
+ */
+
+#include <RoverLog.h>
+
+#define KEYINTERVAL     50          // Records between the keys
+
+RoverLog::RoverLog(uint8_t fieldCount) {
+    if (fieldCount > ROVERLOG_MAXFIELDS) fieldCount = ROVERLOG_MAXFIELDS;
+    _fieldCount = fieldCount;
+    _dropped    = 0;
+    clear();
+}
+
+void RoverLog::clear() {
+    _head       = 0;
+    _count      = 0;
+    _lastTime   = 0;
+    _sinceKey   = 0;
+    _needKey    = true;
+}
+
+bool RoverLog::put(const uint8_t *data, uint8_t length) {
+    if (ROVERLOG_RINGSIZE - _count < length) return false;
+    uint16_t    tail    = (_head + _count) % ROVERLOG_RINGSIZE;
+    for (uint8_t i=0;i<length;i++) {
+        _ring[tail] = data[i];
+        if (++tail >= ROVERLOG_RINGSIZE) tail = 0;
+    }
+    _count  += length;
+    return true;
+}
+
+bool RoverLog::header(const char *names) {
+    uint16_t    length  = strlen(names) + 1;
+    if (ROVERLOG_RINGSIZE - _count < length + 2) return false;
+    uint8_t     start[2] = {ROVERLOG_HEADER, _fieldCount};
+    put(start, 2);
+    while (length) {                // Names in pieces of 255 bytes or less
+        uint8_t piece = (length > 255)? 255: length;
+        put((const uint8_t *) names, piece);
+        names   += piece;
+        length  -= piece;
+    }
+    _needKey = true;
+    return true;
+}
+
+bool RoverLog::record(uint32_t time, const int16_t *values) {
+    uint8_t     buffer[6 + 2 * ROVERLOG_MAXFIELDS];
+    uint8_t     length  = 0;
+    uint32_t    dt      = time - _lastTime;
+    bool        isKey   = _needKey || (_sinceKey >= KEYINTERVAL) || (dt > 255);
+
+    for (uint8_t i=0;(i<_fieldCount) && !isKey;i++) {
+        int16_t delta   = values[i] - _last[i];
+        if ((delta < -128) || (delta > 127)) isKey = true;
+    }
+
+    if (isKey) {
+        buffer[length++] = ROVERLOG_KEY;
+        for (uint8_t i=0;i<4;i++) buffer[length++] = time >> (8 * i);
+        for (uint8_t i=0;i<_fieldCount;i++) {
+            buffer[length++] = values[i];
+            buffer[length++] = values[i] >> 8;
+        }
+    } else {
+        buffer[length++] = ROVERLOG_DELTA;
+        buffer[length++] = dt;
+        for (uint8_t i=0;i<_fieldCount;i++) {
+            buffer[length++] = (int8_t) (values[i] - _last[i]);
+        }
+    }
+    uint8_t     sum     = 0;
+    for (uint8_t i=0;i<length;i++) sum += buffer[i];
+    buffer[length++] = sum;
+
+    if (!put(buffer, length)) {
+        _dropped++;
+        _needKey    = true;         // The next delta would be from a lost record
+        return false;
+    }
+    for (uint8_t i=0;i<_fieldCount;i++) _last[i] = values[i];
+    _lastTime   = time;
+    _sinceKey   = isKey? 0: _sinceKey + 1;
+    _needKey    = false;
+    return true;
+}
+
+uint16_t RoverLog::drain(Stream *out, uint16_t maxBytes) {
+    if (maxBytes > _count) maxBytes = _count;
+    uint16_t    written = 0;
+    while (written < maxBytes) {    // At most two pieces, before and after the wrap
+        uint16_t piece = ROVERLOG_RINGSIZE - _head;
+        if (piece > maxBytes - written) piece = maxBytes - written;
+        uint16_t n = out->write(&_ring[_head], piece);
+        _head   = (_head + n) % ROVERLOG_RINGSIZE;
+        _count  -= n;
+        written += n;
+        if (n < piece) break;       // Output is full
+    }
+    return written;
+}
+
+uint16_t RoverLog::pending() {return _count;}
+
+uint16_t RoverLog::dropped() {return _dropped;}
@@ -0,0 +1,34 @@
+#ifndef ROVERLOG_H
+#define ROVERLOG_H
+
+#include <Arduino.h>
+
+#define ROVERLOG_MAXFIELDS  16
+#define ROVERLOG_RINGSIZE   512     // Bytes
+
+#define ROVERLOG_HEADER     0xC3    // Record types
+#define ROVERLOG_KEY        0xA5
+#define ROVERLOG_DELTA      0x5A
+
+class RoverLog {
+public:
+    RoverLog(uint8_t fieldCount);
+    void        clear();
+    bool        header(const char *names);      // Tab separated field names
+    bool        record(uint32_t time, const int16_t *values);   // [ms]
+    uint16_t    drain(Stream *out, uint16_t maxBytes);
+    uint16_t    pending();                      // Bytes in the ring
+    uint16_t    dropped();                      // Records without space
+private:
+    bool        put(const uint8_t *data, uint8_t length);
+    uint8_t     _fieldCount;
+    uint8_t     _ring[ROVERLOG_RINGSIZE];
+    uint16_t    _head, _count;
+    int16_t     _last[ROVERLOG_MAXFIELDS];      // Values of the previous record
+    uint32_t    _lastTime;
+    uint8_t     _sinceKey;                      // Delta records after the key
+    bool        _needKey;
+    uint16_t    _dropped;
+};
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ *  File: TickScheduler.cpp
+ *
+ *  Periodic tasks on a common tick clock
+ *
+ *  The ticks are counted from micros(), 1000 us each by default.  A task
+ *  has a period and a phase in ticks, and it runs in the ticks where
+ *      tick % period == phase
+ *  so two tasks with the same period and different phases never run in
+ *  the same tick, and the work of a busy tick is not repeated in the next.
+ *
+ *  run() is called from the main loop as often as possible
+ *  - Nothing is done until the next tick has started
+ *  - A tick that starts half a tick or more late moves the tick clock to
+ *    the start time, so the next tick is a full tick later.  The ticks
+ *    missed by a slow loop are skipped, not run back to back
+ *  - The due tasks are run once in the order they were added, and each
+ *    gets the scheduled time of its slot in us, the common time stamp of
+ *    everything the task samples
+ *  - A task that is late by one or more periods runs once, and the missed
+ *    slots are counted as overruns.  There is no burst of catch-up runs
+ *  - A task may call run() again, for example through a blocking wait,
+ *    and that call returns false without running anything
+ *
+ *  stats() tells per task
+ *  - runs and overruns
+ *  - jitter, the start of the task after the scheduled slot time.  It
+ *    includes the loop latency and the tasks before it in the same tick
+ *  - duration of the task, so the sum of the tasks in one tick can be
+ *    kept under the tick length
+ */
+
+#include <TickScheduler.h>
+
+TickScheduler::TickScheduler(uint16_t tickLength) {
+    _tickLength = (tickLength == 0)? 1000: tickLength;
+    _count      = 0;
+    _running    = false;
+    _tick       = 0xFFFFFFFFUL;     // Before tick 0
+    _tickTime   = 0;
+}
+
+void TickScheduler::begin() {
+    _tick       = 0xFFFFFFFFUL;     // The first run() starts tick 0
+    _tickTime   = micros() - _tickLength;
+    for (uint8_t i=0;i<_count;i++) firstSlot(i);
+    resetStats();
+}
+
+void TickScheduler::firstSlot(uint8_t index) {  // First slot after the current tick
+    uint32_t    t       = _tick + 1;
+    uint32_t    next    = t - t % _period[index] + _phase[index];
+    if ((int32_t) (next - t) < 0) next += _period[index];
+    _next[index]    = next;
+}
+
+int8_t TickScheduler::add(TickTask task, uint16_t period, uint16_t phase) {
+    if ((_count >= TICKSCHED_MAXTASKS) || (task == NULL)) return -1;
+    if (period == 0) period = 1;
+    uint8_t     i       = _count++;
+    _task[i]    = task;
+    _period[i]  = period;
+    _phase[i]   = phase % period;
+    firstSlot(i);
+    memset(&_stats[i], 0, sizeof(TickStats));
+    return i;
+}
+
+bool TickScheduler::run() {
+    if (_running) return false;
+    uint32_t    now     = micros();
+    uint32_t    late    = now - _tickTime;
+    if (late < _tickLength) return false;
+    uint32_t    ticks   = (late < 2UL * _tickLength)? 1: late / _tickLength;
+    _tick       += ticks;
+    _tickTime   += ticks * _tickLength;
+    uint32_t    gridTime    = _tickTime;                // Slot times of this tick
+    if (now - _tickTime >= _tickLength / 2) _tickTime = now;    // Skip the missed ticks
+    _running    = true;
+    for (uint8_t i=0;i<_count;i++) {
+        uint32_t    behind  = _tick - _next[i];
+        if ((int32_t) behind < 0) continue;             // Not due
+        TickStats   *s      = &_stats[i];
+        if (behind >= _period[i]) {                     // Missed slots
+            uint32_t    missed  = behind / _period[i];
+            s->overruns = (s->overruns + missed > 0xFFFF)? 0xFFFF: s->overruns + missed;
+            behind      -= missed * _period[i];
+        }
+        uint32_t    slotTime    = gridTime - behind * _tickLength;
+        uint32_t    start       = micros();
+        uint32_t    jitter      = start - slotTime;
+        s->jitter   = (jitter > 0xFFFF)? 0xFFFF: jitter;
+        if (s->jitter > s->maxJitter) s->maxJitter = s->jitter;
+        _task[i](slotTime);
+        uint32_t    duration    = micros() - start;
+        s->duration = (duration > 0xFFFF)? 0xFFFF: duration;
+        if (s->duration > s->maxDuration) s->maxDuration = s->duration;
+        s->runs++;
+        _next[i]    = _tick - behind + _period[i];
+    }
+    _running    = false;
+    return true;
+}
+
+uint32_t TickScheduler::tick() {
+    return _tick;
+}
+
+uint32_t TickScheduler::tickTime() {
+    return _tickTime;
+}
+
+uint8_t TickScheduler::count() {
+    return _count;
+}
+
+void TickScheduler::stats(uint8_t index, TickStats *stats) {
+    if (index >= _count) {
+        memset(stats, 0, sizeof(TickStats));
+        return;
+    }
+    *stats  = _stats[index];
+}
+
+void TickScheduler::resetStats() {
+    for (uint8_t i=0;i<_count;i++) memset(&_stats[i], 0, sizeof(TickStats));
+}
@@ -0,0 +1,44 @@
+#ifndef TICKSCHEDULER_H
+#define TICKSCHEDULER_H
+
+#include <Arduino.h>
+
+#define TICKSCHED_MAXTASKS  10
+
+typedef void (*TickTask)(uint32_t time);    // [us] scheduled time of the slot
+
+typedef struct {
+    uint32_t    runs;
+    uint16_t    overruns;           // Slots missed, because the task was late
+    uint16_t    jitter;             // [us] start after the scheduled time, last run
+    uint16_t    maxJitter;
+    uint16_t    duration;           // [us] last run
+    uint16_t    maxDuration;
+} TickStats;
+
+class TickScheduler {
+public:
+    TickScheduler(uint16_t tickLength = 1000);              // [us]
+    void        begin();                                    // Tick 0 is now
+    int8_t      add(TickTask task, uint16_t period, uint16_t phase = 0);   // [ticks], -1 if full
+    bool        run();                                      // True when a new tick was started
+    uint32_t    tick();                                     // Ticks since begin
+    uint32_t    tickTime();                                 // [us] micros() of the tick start
+    uint8_t     count();
+    void        stats(uint8_t index, TickStats *stats);
+    void        resetStats();
+private:
+    void        firstSlot(uint8_t index);
+    TickTask    _task[TICKSCHED_MAXTASKS];
+    uint16_t    _period[TICKSCHED_MAXTASKS];
+    uint16_t    _phase[TICKSCHED_MAXTASKS];
+    uint32_t    _next[TICKSCHED_MAXTASKS];      // Tick of the next slot
+    TickStats   _stats[TICKSCHED_MAXTASKS];
+    uint8_t     _count;
+    uint16_t    _tickLength;        // [us]
+    uint32_t    _tick;
+    uint32_t    _tickTime;          // [us]
+    bool        _running;           // A task may call run() again
+};
+
+#endif
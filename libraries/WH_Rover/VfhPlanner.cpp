@@ -0,0 +1,128 @@
+/**
+ *  File: VfhPlanner.cpp
+ *
+ *  Reactive obstacle avoidance with a vector field histogram
+ *
+ *  The directions around the rover are divided into 16 sectors of 22.5 deg,
+ *  sector 0 is the front and the sectors grow counter clockwise.
+ *  - Each reading adds an obstacle density to the sectors of its beam,
+ *    255 at the rover and 0 at the range (1500 mm).  The highest density
+ *    of the cycle is kept
+ *  - US beams have a +-15 deg spread, so they cover up to three sectors
+ *  - An IR contact is density 255
+ *  - A sector gets at least the average of its two neighbors, so the
+ *    sectors between the sensors are not seen as free
+ *
+ *  select() chooses the free sector (smoothed density under 160, an
+ *  obstacle at about 560 mm) with the lowest cost
+ *      cost = 5 * sectors from the goal + 2 * sectors from the previous
+ *  The previous choice keeps the rover from switching between two equal
+ *  openings.  If no sector is free, the least dense one is selected.
+ *
+ *  powers() makes the left and right motor powers for the selection
+ *  - Over 90 deg from the front, or nothing free, turn in place
+ *  - Otherwise drive with the power reduced by the density and steer
+ *    with the power times the angle / 90 deg
+ *
+ *  All loops are over the 16 sectors, so a cycle takes a fixed time.
+ *  The planner has no hardware access, WH_Rover feeds it the readings
+ *  (runPlanner), and it can be tested on a PC with any readings.
+ */
+
+#include <VfhPlanner.h>
+
+#define SECTORSHIFT     12          // 65536 / 16 sectors
+#define HALFSECTOR      (1 << (SECTORSHIFT - 1))
+#define GOALWEIGHT      5
+#define PREVWEIGHT      2
+#define QUARTERTURN     16384       // 90 deg
+
+static uint8_t sectorOf(uint16_t angle) {
+    return (uint16_t) (angle + HALFSECTOR) >> SECTORSHIFT;
+}
+
+static uint8_t sectorDiff(uint8_t a, uint8_t b) {   // 0 .. 8
+    uint8_t d   = (a - b) & (VFH_SECTORS - 1);
+    return (d > VFH_SECTORS / 2)? VFH_SECTORS - d: d;
+}
+
+VfhPlanner::VfhPlanner(int16_t range, uint8_t threshold) {
+    _range      = range;
+    _threshold  = threshold;
+    _sector     = 0;
+    _previous   = 0;
+    _free       = true;
+    clear();
+}
+
+void VfhPlanner::clear() {
+    for (uint8_t i=0;i<VFH_SECTORS;i++) _hist[i] = 0;
+}
+
+void VfhPlanner::mark(uint16_t angle, uint8_t value) {
+    uint8_t k   = sectorOf(angle);
+    if (value > _hist[k]) _hist[k] = value;
+}
+
+void VfhPlanner::addReading(uint16_t angle, int16_t distance, uint16_t spread) {
+    if ((distance < 0) || (distance >= _range)) return;
+    uint8_t value   = (int32_t) (_range - distance) * 255 / _range;
+    mark(angle, value);
+    if (spread) {
+        mark(angle - spread, value);
+        mark(angle + spread, value);
+    }
+}
+
+void VfhPlanner::addHit(uint16_t angle) {
+    mark(angle, 255);
+}
+
+bool VfhPlanner::select(uint16_t goal) {
+    uint8_t     goalSector  = sectorOf(goal);
+    uint16_t    bestCost    = 0xFFFF;
+    uint8_t     least       = 0;
+    for (uint8_t k=0;k<VFH_SECTORS;k++) {
+        uint8_t prev    = _hist[(k - 1) & (VFH_SECTORS - 1)];
+        uint8_t next    = _hist[(k + 1) & (VFH_SECTORS - 1)];
+        uint8_t between = (prev + next) >> 1;
+        _smooth[k]      = (_hist[k] > between)? _hist[k]: between;
+        if (_smooth[k] < _smooth[least]) least = k;
+    }
+    _free   = false;
+    for (uint8_t k=0;k<VFH_SECTORS;k++) {
+        if (_smooth[k] >= _threshold) continue;
+        uint16_t cost   = GOALWEIGHT * sectorDiff(k, goalSector) +
+                          PREVWEIGHT * sectorDiff(k, _previous);
+        if (cost < bestCost) {
+            bestCost    = cost;
+            _sector     = k;
+            _free       = true;
+        }
+    }
+    if (!_free) _sector = least;
+    _previous   = _sector;
+    return _free;
+}
+
+uint16_t VfhPlanner::heading() {
+    return (uint16_t) _sector << SECTORSHIFT;
+}
+
+uint8_t VfhPlanner::density(uint8_t sector) {
+    return _smooth[sector & (VFH_SECTORS - 1)];
+}
+
+void VfhPlanner::powers(int16_t power, int16_t *left, int16_t *right) {
+    int16_t     angle   = heading();            // -180 .. 180 deg
+    if (!_free || (angle > QUARTERTURN) || (angle < -QUARTERTURN)) {
+        int16_t turn    = (angle >= 0)? power / 2: -power / 2;  // CCW for positive
+        *left   = -turn;
+        *right  = turn;
+        return;
+    }
+    int16_t     drive   = (int32_t) power * (255 - _smooth[_sector]) / 255;
+    int16_t     steer   = (int32_t) power * angle / QUARTERTURN;
+    *left   = constrain(drive - steer, -1023, 1023);
+    *right  = constrain(drive + steer, -1023, 1023);
+}
@@ -0,0 +1,29 @@
+#ifndef VFHPLANNER_H
+#define VFHPLANNER_H
+
+#include <Arduino.h>
+
+#define VFH_SECTORS     16          // 22.5 deg each, sector 0 is the front
+
+class VfhPlanner {
+public:
+    VfhPlanner(int16_t range = 1500, uint8_t threshold = 160);  // [mm], density
+    void        clear();
+    void        addReading(uint16_t angle, int16_t distance, uint16_t spread = 0);
+    void        addHit(uint16_t angle);                 // Contact, full density
+    bool        select(uint16_t goal);                  // False if all blocked
+    uint16_t    heading();                              // Selected, 0 = front
+    uint8_t     density(uint8_t sector);                // Filled 0 .. 255
+    void        powers(int16_t power, int16_t *left, int16_t *right);
+private:
+    void        mark(uint16_t angle, uint8_t value);
+    int16_t     _range;
+    uint8_t     _threshold;
+    uint8_t     _hist[VFH_SECTORS];
+    uint8_t     _smooth[VFH_SECTORS];
+    uint8_t     _sector;            // Selected
+    uint8_t     _previous;
+    bool        _free;              // A sector under the threshold was found
+};
+
+#endif
@@ -10,72 +10,563 @@
  *  - SHARP GP2Y0A21 Optical Distance Sensors (ODS_x)
  *  - HC_SR04 UltraSound Distance Sensors (US_xx)
  *  - FC-51 InfraRed Collision Detectors (IR_xx)
+ *  - Quadrature wheel encoders (ENC_xx)
  *
- * The API for MPU9255 Gyroscope, Accelerometer, and Magnetormeter
- * will be added in a future version
+ * The overlapping ODS and US sensors are fused per direction (DIR_x)
+ *  - A RangeFilter (integer Kalman filter) for each direction
+ *  - ODS sigma grows with distance, the readings under 65 mm are
+ *    non-monotonic and are not used
+ *  - US sigma grows with the spread of the echo widths, which is
+ *    high for small and sound absorbing targets
+ *  - The ODS readings update the filters once per 40 ms and the US
+ *    readings when a new echo has been measured.  The GP2Y0A21 output
+ *    changes every 38 +- 10 ms, so the ADC samples in between are the
+ *    same measurement and would overstate the confidence
+ *  - updateFusion() is run by the scheduler every 5 ms, and it can be
+ *    called by the application
+ *
+ * runSpeed() drives the wheels at a speed in encoder counts per second
+ *  - The encoders are estimated and an iPID per wheel calculates the power
+ *    every 20 ms in updateSpeed(), run by the scheduler
+ *  - runMotors() and stopMotors() return to open loop power
+ *  - Example QuadEncoder_speedSim runs the same loop against ProcSimulator
+ *
+ * dataLogger() stores a telemetry sample every 20 ms after setLogOutput()
+ *  - power, multipliers, motor powers, US_FL, US_FF, US_FR, ODS_L, ODS_R,
+ *    IR bits, and motor currents as binary records (see RoverLog.cpp)
+ *  - The records are buffered in RAM and written at most 64 bytes at the time
+ *  - For Serial, only the free space of the transmit buffer is written, so
+ *    the control loop does not wait (waitFree = true)
+ *  - For an SD card File, waitFree = false, because availableForWrite()
+ *    does not tell the free space.  Call flush() now and then.
+ *
+ * The motions are executed from a queue of up to 8 commands
+ *  - queueForward, queueTurnLeft, queueBrake, queueUntil, queueWhile, ...
+ *    add a command and return immediately (false if the queue is full)
+ *  - The scheduler advances the first command every ms, so the
+ *    application loop should call updateWH_Rover(), which also runs the
+ *    speed control, current limits, and fusion
+ *  - Turns and brakes take the current power and multipliers when the
+ *    command starts, same as the blocking functions
+ *  - preemptMotion() drops the queue and leaves the motors at the current
+ *    ramp values, stopMotors() also stops the motors
+ *  - onMotionIdle() sets a function that is called when the queue empties
+ *  - The blocking functions (moveForward, ...) wait for a free slot if the
+ *    queue is full, queue the command, and wait until the queue is empty.
+ *    They must not be called from the conditions and actions of the
+ *    queued commands
+ *
+ * attachSimulator() replaces the motors and sensors with a simulated world
+ *  - dataLogger steps the simulation with the motor powers and feeds the
+ *    simulated wheel travel to the encoders
+ *  - getODS, getUS, and getIRMask return the simulated readings, so the
+ *    fusion, speed control, and motions run unchanged
+ *  - The current limits are off while the simulator is attached, also
+ *    when it is attached before initWH_Rover()
+ *  - getSimulator() returns the attached world, NULL on the hardware
+ *  - RoverSim is a 2D room with walls (libraries/RoverSim)
+ *
+ * getIRMask() reads the 8 IR inputs as one snapshot (libraries/IrLatch)
+ *  - bit 0 is IR_LF ... bit 7 is IR_LB, getIR() tests one bit
+ *  - Activations are latched in interrupts with the time in ms, so a
+ *    short bump is seen in getIRLatched() until ackIR()
+ *  - The telemetry, the planner, and the sensor snapshot keep their own
+ *    edge counters (IrEdges), so each of them sees every bump since its
+ *    previous sample, also when the application has already called ackIR()
+ *
+ * runPlanner() avoids the obstacles with a vector field histogram
+ *  - Every 50 ms the enabled US channels, ODS, and IR readings are
+ *    collected into 16 direction sectors (see VfhPlanner.cpp)
+ *  - The free sector closest to the goal angle sets the motor powers
+ *  - runMotors, runSpeed, the queued motions, and stopMotors take the
+ *    motors back from the planner
+ *
+ * setSafety() sets the trip conditions of the safety reflex
+ *  - The conditions are checked in the interrupts, not in the main loop
+ *    > IR activations in the IrLatch callback (pin interrupt or ADC tick)
+ *    > US echoes under the distance in the HC_SR04 echo callback, when
+ *      the motors drive towards the sensor, so the rover can back off
+ *    > Motor currents over the limit in the ADC tick, in every conversion
+ *      of A2 and A3 (AdcSampler::tickValue), before the oversampling
+ *  - A trip halts both motors in the interrupt (Vnh2sp30::halt) and
+ *    latches the cause in getSafetyFault() until resetSafety()
+ *  - While the fault is latched, dataLogger drops the motion queue and
+ *    the planner, so a blocking motion returns and the motors stay braked
+ *  - While halted, Vnh2sp30::update() does not read the current, so the
+ *    motor currents in the telemetry and getSensors() keep the values from
+ *    before the trip.  The current check of the reflex reads AdcSampler
+ *  - getSafetyReaction() is the worst case in us from the trip check in
+ *    the interrupt to both motors braked, the time of halt().  It does not
+ *    include the time before the check
+ *    > the interrupt entry, a few us for pins 18 .. 21
+ *    > up to one ADC tick (104 us) until pins 22 .. 25 are polled, and
+ *      up to one round of the 4 sampled inputs (416 us) until the next
+ *      conversion of the current
+ *    > up to one scan of the selected US channels and the echo
+ *    The host test extras/host/WH_Rover_safety.cpp checks these bounds
+ *    > the HC_SR04 echo interrupt work before the echo callback
+ *  - All conditions are off until setSafety() is called
+ *
+ * The pose (x, y, heading) is dead reckoned every 20 ms (PoseEstimator.cpp)
+ *  - From the encoder counts, or with setPoseSource(POSE_MODEL) from a
+ *    power to speed model of the motor commands, calibrated with
+ *    setPoseModel(deadband, fullSpeed)
+ *  - setPose() sets the start, getPoseX/Y() are in mm and getHeading() is
+ *    a binary angle, 65536 = 360 deg, 0 = +x, counter clockwise
+ *  - correctHeading() pulls the heading towards an absolute heading, for
+ *    example from an IMU, by gain / 256 of the error in every call
+ *  - queueTurnBy and queueTurnTo turn in place until the heading is within
+ *    2 deg of the target, slowing down in the last 45 deg, instead of
+ *    turning for a time like queueTurnLeft and queueTurnRight.  They end
+ *    at maxDuration, or at 10 s if it is 0 or less, so a turn that never
+ *    reaches the heading, like a stuck wheel with the encoders, ends too
+ *
+ * dataLogger() runs the periodic work on a 1 ms tick (TickScheduler.cpp)
+ *  - Each task has a period and a phase, so the 5, 10, 20, and 50 ms
+ *    tasks never share a tick and the work is spread over the ticks
+ *      task        period  phase [ms]
+ *      simulator   1       0
+ *      motion      1       0
+ *      motors      1       0       current limits
+ *      speed       20      1
+ *      pose        20      2
+ *      fusion      5       3
+ *      log         20      4       telemetry record
+ *      sensors     10      5       getSensors() snapshot
+ *      planner     50      7       ticks 7, 57, 107, ... never 1, 2, 4
+ *      drain       10      0       telemetry output
+ *  - The encoders and iPIDs run at every call of updateSpeed(), so their
+ *    speeds and gains use the actual elapsed time of the slot
+ *  - The pose, speed, and planner tasks keep the scheduled slot time in
+ *    us, and the telemetry record gets the ms of the slot, so a late
+ *    start does not shift their intervals
+ *  - getSensors() returns the snapshot of all sensors, taken in one task
+ *    and stamped with its slot time in us, with the age of each US echo
+ *  - getTaskStats() tells the runs, missed slots, jitter, and duration
+ *    of each task (RoverTask)
+ *  - The US triggers are not scheduled tasks.  HC_SR04 sequences the
+ *    trigger delay and the timeouts on its own Timer 2 and stamps the
+ *    echoes with micros() (or Timer 5 with tsTimer5).  A channel ends as
+ *    soon as its echo arrives or its range gate closes, so a fixed slot
+ *    would only add waiting between the channels
+ *  - The IR inputs and the motor currents are sampled in the ADC tick,
+ *    because the safety reflex needs them within 104 and 416 us.  The sensors
+ *    task takes the snapshot of their latest values with the US ranges
+ *  - updateMotion, updateSpeed, updatePose, and updatePlanner keep their
+ *    own intervals when the application calls them directly
+ *
+ * The MPU9255 Gyroscope, Accelerometer, and Magnetometer driver is in
+ * libraries/MPU9255.  Its heading can be given to correctHeading().  The
+ * I2C pins SDA 20 and SCL 21 are used by IR_FR and IR_RF on this rover
  *
  */
 
 #include <Vnh2sp30.h>
 #include <HC_SR04.h>
 #include <GP2Y0A21.h>
+#include <AdcSampler.h>
 #include <WH_Rover.h>
+#include <RangeFilter.h>
+#include <RoverLog.h>
+#include <QuadEncoder.h>
+#include <iPID.h>
+#include <FixedTrig.h>
+#include <VfhPlanner.h>
+#include <IrLatch.h>
+#include <PoseEstimator.h>
+#include <TickScheduler.h>
 
 #define USCOUNT         6
-#define USINITVALUE     9999
-#define FILTER_WINDOW   5
-#define USIDLETIME      3000
 #define LOGINTERVAL     20
+#define LOGFIELDS       13
+#define LOGCHUNK        64          // [bytes] Maximum write in one call
+#define DIRCOUNT        3
+#define ODSMIN          65          // [mm] Non-monotonic under this
+#define ODSMAX          4000
+#define ODSPRECISE      1000        // [mm] Not precise over this
+#define ODSPERIOD       40          // [ms] One GP2Y0A21 measurement
+#define USMIN           30
+#define USMAX           3000
+#define MOTORLIMIT      270         // [ADC] About 10 A with 0.13 V/A current sense
+#define MOTORTRIP       540         // [ADC] About 20 A
+#define MOTORTRIPTIME   500         // [ms]
+#define SPEEDINTERVAL   20          // [ms] Speed estimate and control
+#define MOTIONQUEUE     8           // Queued motion commands
+#define MOTIONINTERVAL  1           // [ms] Motion update
+#define PLANNERINTERVAL 50          // [ms] Obstacle avoidance update
+#define PLANNERRANGE    1500        // [mm]
+#define USSPREAD        FIXEDTRIG_DEG(15)
+#define ROVERTRACK      200         // [mm] Distance between the wheels
+#define COUNTSPERM      1000        // Encoder counts per meter of travel
+#define POSEINTERVAL    20          // [ms] Dead reckoning update
+#define MODELDEADBAND   60          // Power that does not move the rover
+#define MODELSPEED      1000        // [counts/s] at power 1023
+#define TURNTOLERANCE   FIXEDTRIG_DEG(2)
+#define TURNSLOWDOWN    FIXEDTRIG_DEG(45)   // Power reduced in the last 45 deg
+#define TURNMINPOWER    150
+#define TURNSTILL       40          // [counts/s] both wheels, turn done
+#define TURNTIMEOUT     10000       // [ms] when the turn has no maxDuration
+#define TICKLENGTH      1000        // [us] Scheduler tick
+#define FUSIONINTERVAL  5           // [ms] Range filters
+#define SENSORINTERVAL  10          // [ms] getSensors() snapshot
+#define DRAININTERVAL   10          // [ms] Telemetry output
 
 //              ENA A   B   PWM   CS    inv
 Vnh2sp30  mtrL( A0, 7,  8,  5,    A2,   0);             // Left side straight
 Vnh2sp30  mtrR( A1, 4,  9,  6,    A3,   1);             // Right side reversed
 
+QuadEncoder encL(ENC_LA, ENC_LB);                       // Left side straight
+QuadEncoder encR(ENC_RA, ENC_RB, true);                 // Right side reversed
+
+int16_t     speedPV[2], speedCV[2], speedSP[2];         // [counts/s], power
+
+//  iPID
+//  int16_t* ProcessValue, int16_t* ControlValue, int16_t* SetPoint,
+//  uint16_t pFactorPct = 100, uint16_t iFactor = 0, uint16_t dFactor = 0,
+//  uint16_t executeInterval = 100, bool isReverse = false
+iPID        speedL(&speedPV[WHEEL_L], &speedCV[WHEEL_L], &speedSP[WHEEL_L], 20, 20, 0, SPEEDINTERVAL);
+iPID        speedR(&speedPV[WHEEL_R], &speedCV[WHEEL_R], &speedSP[WHEEL_R], 20, 20, 0, SPEEDINTERVAL);
+
 //..............Start only US_FF to detect the distance in front
 HC_SR04 ultraSound(1 << US_FF);
 
 // Local Variables
 int16_t     currentPower, leftMultiplier, rightMultiplier;
-int32_t     loggerTime;
-uint32_t    US_Prev[USCOUNT];       // Used to detect changes in ultra sound values
-uint16_t    US_Changes[USCOUNT];    // Count the changes
-int32_t     US_Time[USCOUNT];       // Last time when used
 
-void dataLoggerHeader() {           // TBD
+typedef enum MotionTypes {
+    MOTION_RAMP,                    // Ramp power and multipliers
+    MOTION_TURNLEFT,
+    MOTION_TURNRIGHT,
+    MOTION_TURNBY,                  // Turn to a heading relative to the start
+    MOTION_TURNTO,                  // Turn to an absolute heading
+    MOTION_BRAKE,
+    MOTION_UNTIL,                   // Keep moving until condition
+    MOTION_WHILE,                   // Run action while condition
+    MOTION_STOP
+} MotionType;
+
+typedef struct {
+    MotionType  type;
+    int16_t     power;              // Target power
+    int16_t     left, right;        // Target multipliers
+    uint16_t    heading;            // Target of the heading turns
+    int32_t     duration;           // [ms] ramp or maximum duration
+    bool        (*condition)(void);
+    void        (*action)(bool);
+} MotionCommand;
+
+MotionCommand motionQueue[MOTIONQUEUE];
+uint8_t     motionHead, motionCount;
+bool        motionActive;           // Head command has been started
+bool        motionBusy;             // In updateMotion
+uint32_t    motionTime;             // [ms] of the last updateMotion
+int32_t     motionStart;            // [ms] when the head command started
+int16_t     rampPower0, rampLeft0, rampRight0;      // Values at the start
+void        (*motionIdleCallback)(void);
+
+RoverLog    telemetry(LOGFIELDS);
+Stream      *logOutput;             // NULL = no logging
+bool        logWaitFree;            // Write only the free output buffer
+
+RangeFilter fusion[DIRCOUNT];
+volatile uint8_t usFresh;           // New echo in US_FL, US_FF, or US_FR
+volatile uint32_t usTime[USCOUNT];  // [us] of the last echo
+volatile uint8_t usEchoed;          // Channels with an echo since init
+uint16_t    odsSamples[2];          // Sample counts of ODS_L and ODS_R
+uint32_t    odsTime[2];             // [ms] of the last ODS update
+
+const SensorMount sensorMounts[16] PROGMEM = {  // US, ODS, and IR positions
+//   x [mm] forward, y [mm] left, direction
+    { 120,   80,    FIXEDTRIG_DEG(45)},     // US_FL
+    { 130,    0,    FIXEDTRIG_DEG(0)},      // US_FF
+    { 120,  -80,    FIXEDTRIG_DEG(-45)},    // US_FR
+    {-120,  -80,    FIXEDTRIG_DEG(-135)},   // US_BR
+    {-130,    0,    FIXEDTRIG_DEG(180)},    // US_BB
+    {-120,   80,    FIXEDTRIG_DEG(135)},    // US_BL
+    { 125,   50,    FIXEDTRIG_DEG(20)},     // ODS_L
+    { 125,  -50,    FIXEDTRIG_DEG(-20)},    // ODS_R
+    { 100,  100,    FIXEDTRIG_DEG(90)},     // IR_LF
+    { 130,   60,    FIXEDTRIG_DEG(0)},      // IR_FL
+    { 130,  -60,    FIXEDTRIG_DEG(0)},      // IR_FR
+    { 100, -100,    FIXEDTRIG_DEG(-90)},    // IR_RF
+    {-100, -100,    FIXEDTRIG_DEG(-90)},    // IR_RB
+    {-130,  -60,    FIXEDTRIG_DEG(180)},    // IR_BR
+    {-130,   60,    FIXEDTRIG_DEG(180)},    // IR_BL
+    {-100,  100,    FIXEDTRIG_DEG(90)}      // IR_LB
+};
+
+VfhPlanner  planner(PLANNERRANGE);
+bool        plannerActive;
+int16_t     plannerPower;
+uint16_t    plannerGoal;            // Relative to the front
+uint32_t    plannerTime;            // [us] of the last plan
+
+RoverSimHook *simulator;            // NULL = hardware
+int32_t     simCount[2];            // Simulated counts fed to the encoders
+uint8_t     simIR;                  // Simulated IR mask of the last step
+IrEdges     irLogSeen, irPlanSeen;  // IR activations already used
+
+PoseEstimator pose(ROVERTRACK, COUNTSPERM);
+PoseSource  poseSource;
+uint32_t    poseTime;               // [us] of the last update, whole ms
+uint32_t    speedTime;              // [us] of the last speed update
+int32_t     poseCount[2];           // Counts at the last update
+int32_t     modelCount[2];          // Counts of the power model
+int32_t     modelMilli[2];          // [1/1000 count] remainders
+uint16_t    modelDeadband, modelSpeed;
+
+uint8_t     safetyIRMask;           // IR bits that trip
+uint8_t     safetyUSMask;           // US channels that trip
+uint16_t    safetyUSDistance;       // [mm] trip under this, 0 = off
+uint16_t    safetyCurrent;          // [ADC] trip over this, 0 = off
+volatile uint8_t  safetyFault;      // SafetyCause bits, 0 = no trip
+volatile uint32_t safetyTime;       // [us] of the first trip
+volatile uint16_t safetyReaction;   // [us] worst case trip check to brake
+
+TickScheduler scheduler(TICKLENGTH);
+RoverSensors sensorView;            // Latest snapshot
+IrEdges     irSensorSeen;
+
+void safetyTrip(uint8_t cause, uint32_t start) {   // Interrupts disabled
+    mtrL.halt();
+    mtrR.halt();
+    uint16_t    reaction = micros() - start;
+    if (reaction > safetyReaction) safetyReaction = reaction;
+    if (safetyFault == 0) safetyTime = start;
+    safetyFault |= cause;
+}
+
+bool safetyToward(uint8_t channel) {   // Driving towards the US channel
+    int16_t     drive   = mtrL.power() + mtrR.power();
+    return (channel < US_BR)? drive > 0: drive < 0;
+}
+
+void safetyIR(uint8_t bits) {       // In IR interrupts, every activation
+    if (bits & safetyIRMask) safetyTrip(SAFETY_IR, micros());
+}
+
+void safetyTick() {                 // In the ADC interrupt
+    IrLatch::poll();
+    if (safetyCurrent == 0) return;
+    uint8_t     pin     = AdcSampler::tickPin();
+    if ((pin != A2) && (pin != A3)) return;         // mtrL and mtrR current sense
+    uint32_t    start   = micros();
+    if (AdcSampler::tickValue() > safetyCurrent) safetyTrip(SAFETY_CURRENT, start);
+}
+
+void dataLoggerHeader() {
+    telemetry.header(
+        "power\tleftMult\trightMult\tleftPower\trightPower\t"
+        "US_FL\tUS_FF\tUS_FR\tODS_L\tODS_R\tIR\tcurrentL\tcurrentR");
+}
+
+void logSample(uint32_t time) {     // [ms]
+    int16_t     values[LOGFIELDS];
+    uint8_t     irBits  = getIRMask() | IrLatch::activatedSince(&irLogSeen);  // IR_LF .. IR_LB as bits 0 .. 7
+    values[0]   = currentPower;
+    values[1]   = leftMultiplier;
+    values[2]   = rightMultiplier;
+    values[3]   = mtrL.power();
+    values[4]   = mtrR.power();
+    values[5]   = getUS(US_FL);
+    values[6]   = getUS(US_FF);
+    values[7]   = getUS(US_FR);
+    values[8]   = getODS(ODS_L);
+    values[9]   = getODS(ODS_R);
+    values[10]  = irBits;
+    values[11]  = mtrL.current();
+    values[12]  = mtrR.current();
+    telemetry.record(time, values);
+}
+
+void setLogOutput(Stream *out, bool waitFree) {
+    logOutput   = out;
+    logWaitFree = waitFree;
+    telemetry.clear();
+    if (out) dataLoggerHeader();
+}
+
+uint16_t droppedLogRecords() {
+    return telemetry.dropped();
+}
+
+void usSample(const HC_SR04Sample *sample) {   // In echo interrupt
+    usFresh |= 1 << sample->channel;
+    usEchoed |= 1 << sample->channel;
+    usTime[sample->channel] = micros();
+    if ((safetyUSMask & (1 << sample->channel)) && safetyToward(sample->channel)) {
+        uint32_t    start   = micros();
+        uint16_t    d       = ultraSound.toMillimeters(sample->width);
+        if ((d >= USMIN) && (d < safetyUSDistance)) safetyTrip(SAFETY_US, start);
+    }
+}
+
+void stepSimulator() {
+    uint8_t echoes  = simulator->step(millis(), mtrL.power(), mtrR.power());
+    uint32_t now    = micros();
+    cli();
+    usFresh |= echoes;
+    usEchoed |= echoes;
+    sei();
+    for (int i=0;i<USCOUNT;i++) {
+        if (echoes & (1 << i)) usTime[i] = now;
+    }
+    for (int i=0;i<USCOUNT;i++) {       // Same check as in usSample
+        if (!(echoes & safetyUSMask & (1 << i)) || !safetyToward(i)) continue;
+        uint32_t    start   = micros();
+        int16_t     d       = simulator->us((USChannel) i);
+        if ((d >= USMIN) && (d < (int16_t) safetyUSDistance)) {
+            cli();
+            safetyTrip(SAFETY_US, start);
+            sei();
+        }
+    }
+    for (int i=0;i<2;i++) {
+        int32_t count   = simulator->count((Wheel) i);
+        int16_t delta   = count - simCount[i];
+        simCount[i]     = count;
+        if (i == WHEEL_L) encL.addCounts(delta); else encR.addCounts(delta);
+    }
+    uint8_t irMask  = getIRMask();
+    IrLatch::latch(irMask & ~simIR);    // New activations
+    simIR   = irMask;
+}
+
+void attachSimulator(RoverSimHook *sim) {
+    simulator   = sim;
+    if (sim) {
+        mtrL.setCurrentLimit(0, 0, 0);  // No current sense
+        mtrR.setCurrentLimit(0, 0, 0);
+        simCount[WHEEL_L]   = sim->count(WHEEL_L);
+        simCount[WHEEL_R]   = sim->count(WHEEL_R);
+    } else {
+        mtrL.setCurrentLimit(MOTORLIMIT, MOTORTRIP, MOTORTRIPTIME);
+        mtrR.setCurrentLimit(MOTORLIMIT, MOTORTRIP, MOTORTRIPTIME);
+    }
+}
 
+RoverSimHook *getSimulator() {
+    return simulator;
+}
+
+void drainLog() {
+    if (logOutput == NULL) return;
+    uint16_t    chunk   = LOGCHUNK;         // Bounded write, no waiting
+    if (logWaitFree) {
+        int     free    = logOutput->availableForWrite();
+        if (free < chunk) chunk = free;
+    }
+    if (chunk) telemetry.drain(logOutput, chunk);
 }
 
 void dataLogger() {
-    int32_t currentTime = millis();
-    if (currentTime - loggerTime > LOGINTERVAL) {
-        loggerTime  = currentTime;
-                                    // Logging actions TBD
+    scheduler.run();                // The due tasks of the new tick
+    if (safetyFault) {              // Tripped in an interrupt, motors halted
+        preemptMotion();
+        plannerActive   = false;
+        currentPower    = 0;
+        speedL.SetMode(false);
+        speedR.SetMode(false);
     }
 }
 
+void updateWH_Rover() {
+    dataLogger();
+}
+
+void initScheduler();               // With the tasks at the end
+
 void initWH_Rover() {
     currentPower    = 0;            // Range = -1023 .. 1023
     leftMultiplier  = 100;          // Range = -100 .. 100
     rightMultiplier = 100;          // Range = -100 .. 100
-    loggerTime      = millis();
-    dataLoggerHeader();
 
-    for (int i=0;i<USCOUNT;i++) {
-        US_Prev[i]      = USINITVALUE;
-        US_Changes[i]   = 0;
-        US_Time[i]      = 0;
+    IrLatch::begin();               // IR pins, latches, and the ADC tick
+    IrLatch::attachCallback(safetyIR);
+    AdcSampler::attachTick(safetyTick);             // Polls the IR pins 22 .. 25
+    AdcSampler::addChannel(ODS_L);  // Motor current inputs are added by Vnh2sp30
+    AdcSampler::addChannel(ODS_R);
+    GP2Y0A21loadCalibration(0);     // Sensor specific curves, if stored, from EEPROM
+    GP2Y0A21loadCalibration(1);
+    mtrL.begin();                   // 20 kHz PWM, after the Arduino init()
+    mtrR.begin();
+    attachSimulator(simulator);     // Current limits, off with a simulator
+    AdcSampler::start();            // Sample all analog inputs in background
+
+    for (int i=0;i<DIRCOUNT;i++) {  // US_FL, US_FF, US_FR for DIR_L, DIR_F, DIR_R
+        fusion[i].reset();
     }
-    for (int i=0;i<8;i++) {         // Setup IR pins starting from IR_LF
-        pinMode(IR_LF + i, INPUT_PULLUP);
+    for (int i=0;i<USCOUNT;i++) {   // Fusion and safety reflex
+        ultraSound.attachCallback(US_FL + i, usSample);
     }
+    usFresh     = 0;
+    usEchoed    = 0;
+
+    encL.begin();
+    encR.begin();
+    encL.setInterval(1);            // The speed task or updateSpeed() sets the interval
+    encR.setInterval(1);
+    speedL.SetInterval(1);
+    speedR.SetInterval(1);
+    modelDeadband   = MODELDEADBAND;
+    modelSpeed      = MODELSPEED;
+    setPoseSource(POSE_ENCODERS);
+    pose.reset();
+    poseTime        = micros();
+    speedL.SetCvLimits(-1023, 1023);
+    speedR.SetCvLimits(-1023, 1023);
+    speedTime       = micros();
+    initScheduler();
 }
 
-void runMotors(int16_t leftPower, int16_t rightPower) {
+void setMotors(int16_t leftPower, int16_t rightPower) {
+    speedL.SetMode(false);          // Open loop power
+    speedR.SetMode(false);
     mtrL.run(leftPower);
     mtrR.run(rightPower);
+}
+
+void runMotors(int16_t leftPower, int16_t rightPower) {
+    plannerActive   = false;
+    setMotors(leftPower, rightPower);
     dataLogger();
 }
 
+void runSpeed(int16_t leftSpeed, int16_t rightSpeed) {
+    plannerActive   = false;
+    if (!speedL.IsAutoMode()) {     // Start from the current power, bumpless
+        speedCV[WHEEL_L] = mtrL.power();
+        speedCV[WHEEL_R] = mtrR.power();
+        speedL.SetMode(true);
+        speedR.SetMode(true);
+    }
+    speedSP[WHEEL_L] = leftSpeed;
+    speedSP[WHEEL_R] = rightSpeed;
+    dataLogger();
+}
+
+int32_t getCount(Wheel wheelNr) {
+    return (wheelNr == WHEEL_L)? encL.count(): encR.count();
+}
+
+int16_t getSpeed(Wheel wheelNr) {
+    return speedPV[wheelNr];
+}
+
+void speedStep() {
+    if (encL.update()) speedPV[WHEEL_L] = encL.speed();
+    if (encR.update()) speedPV[WHEEL_R] = encR.speed();
+    if (speedL.Execute()) mtrL.run(speedCV[WHEEL_L]);
+    if (speedR.Execute()) mtrR.run(speedCV[WHEEL_R]);
+}
+
+void updateSpeed() {                // Every SPEEDINTERVAL ms
+    uint32_t now    = micros();
+    if (now - speedTime < SPEEDINTERVAL * 1000UL) return;
+    speedTime       = now;
+    speedStep();
+}
+
 int32_t interpolate(int32_t x, int32_t dx, int32_t dy, int16_t y0) {
     if (dx == 0) {
         return y0 + dy;
@@ -84,103 +575,295 @@ int32_t interpolate(int32_t x, int32_t dx, int32_t dy, int16_t y0) {
     }
 }
 
-void rampPower( int16_t targetPower,    int16_t rampDuration,
-                int16_t leftTarget,     int16_t rightTarget) {
-    int32_t startTime   = millis();
-    int32_t deltaTime;
-    int32_t deltaPower  = targetPower   - currentPower;
-    int32_t deltaLeft   = leftTarget    - leftMultiplier;
-    int32_t deltaRight  = rightTarget   - rightMultiplier;
-    int32_t rampPower, rampLeft, rampRight, leftPower, rightPower;
-    do {
-        deltaTime   = millis() - startTime;
-        rampPower   = interpolate(deltaTime, rampDuration, deltaPower,  currentPower);
-        rampLeft    = interpolate(deltaTime, rampDuration, deltaLeft,   leftMultiplier);
-        rampRight   = interpolate(deltaTime, rampDuration, deltaRight,  rightMultiplier);
-        runMotors(rampPower * rampLeft / 100, rampPower * rampRight / 100);
-    } while (deltaTime < rampDuration);
+//---------------------------------------------------- Motion Queue ----------
+
+void haltMotors() {
+    currentPower = 0;
+    plannerActive   = false;
+    speedL.SetMode(false);              // No speed control after the stop
+    speedR.SetMode(false);
+    mtrL.stop();                        // Stop both motors
+    mtrR.stop();
+}
+
+bool queueMotion(MotionType type, int16_t power, int16_t left, int16_t right,
+                 int32_t duration, bool condition(void), void action(bool)) {
+    if (motionCount >= MOTIONQUEUE) return false;
+    MotionCommand *cmd  = &motionQueue[(motionHead + motionCount) % MOTIONQUEUE];
+    cmd->type       = type;
+    cmd->power      = power;
+    cmd->left       = left;
+    cmd->right      = right;
+    cmd->duration   = duration;
+    cmd->condition  = condition;
+    cmd->action     = action;
+    motionCount++;
+    return true;
+}
+
+void startMotion(MotionCommand *cmd) {   // Resolve the targets at the start
+    motionStart     = millis();
+    plannerActive   = false;            // The queue takes the motors
+    rampPower0      = currentPower;
+    rampLeft0       = leftMultiplier;
+    rampRight0      = rightMultiplier;
+    switch (cmd->type) {
+        case MOTION_TURNLEFT:
+            if (currentPower == 0) {
+                cmd->power  = 1023 * (int32_t) cmd->left / 100;
+                cmd->left   = -100;
+            } else {
+                cmd->power  = currentPower;
+            }
+            cmd->right  = 100;
+            break;
+        case MOTION_TURNRIGHT:
+            if (currentPower == 0) {
+                cmd->power  = 1023 * (int32_t) cmd->right / 100;
+                cmd->right  = -100;
+            } else {
+                cmd->power  = currentPower;
+            }
+            cmd->left   = 100;
+            break;
+        case MOTION_TURNBY:
+            cmd->heading    = pose.heading() + cmd->left;
+            if (cmd->duration <= 0) cmd->duration = TURNTIMEOUT;
+            break;
+        case MOTION_TURNTO:
+            cmd->heading    = cmd->left;
+            if (cmd->duration <= 0) cmd->duration = TURNTIMEOUT;
+            break;
+        case MOTION_BRAKE:
+            cmd->power  = 0;
+            cmd->left   = leftMultiplier;
+            cmd->right  = rightMultiplier;
+            break;
+        case MOTION_WHILE:
+            cmd->action(true);
+            break;
+        default:
+            break;
+    }
+}
+
+bool stepTurn(MotionCommand *cmd, int32_t deltaTime) {   // Turn in place
+    int32_t error   = (int16_t) (cmd->heading - pose.heading());   // CCW positive
+    int32_t power   = abs(cmd->power);
+    bool    timeout = deltaTime >= cmd->duration;      // Set in startMotion
+    if ((abs(error) <= TURNTOLERANCE) || timeout) {
+        setMotors(0, 0);
+        currentPower    = 0;
+        leftMultiplier  = 100;
+        rightMultiplier = 100;
+        return timeout || (abs(speedPV[WHEEL_L]) + abs(speedPV[WHEEL_R]) < TURNSTILL);
+    }
+    if (abs(error) < TURNSLOWDOWN) power = power * abs(error) / TURNSLOWDOWN;
+    if (power < TURNMINPOWER) power = TURNMINPOWER;
+    if (error > 0)  setMotors(-power, power);           // Left
+    else            setMotors(power, -power);
+    return false;
+}
+
+bool stepMotion(MotionCommand *cmd) {    // True when the command is done
+    int32_t deltaTime   = millis() - motionStart;
+    switch (cmd->type) {
+        case MOTION_UNTIL:
+            if (cmd->condition()) return true;
+            return (cmd->duration > 0) && (deltaTime >= cmd->duration);
+        case MOTION_WHILE:
+            if (cmd->condition && !cmd->condition()) return true;
+            cmd->action(false);
+            return (cmd->duration > 0) && (deltaTime >= cmd->duration);
+        case MOTION_STOP:
+            haltMotors();
+            return true;
+        case MOTION_TURNBY:
+        case MOTION_TURNTO:
+            return stepTurn(cmd, deltaTime);
+        default: {                      // Ramps
+            if (deltaTime > cmd->duration) deltaTime = cmd->duration;
+            int32_t rampPower   = interpolate(deltaTime, cmd->duration, cmd->power - rampPower0, rampPower0);
+            int32_t rampLeft    = interpolate(deltaTime, cmd->duration, cmd->left  - rampLeft0,  rampLeft0);
+            int32_t rampRight   = interpolate(deltaTime, cmd->duration, cmd->right - rampRight0, rampRight0);
+            setMotors(rampPower * rampLeft / 100, rampPower * rampRight / 100);
+            currentPower    = rampPower;
+            leftMultiplier  = rampLeft;
+            rightMultiplier = rampRight;
+            return deltaTime >= cmd->duration;
+        }
+    }
+}
+
+void motionStep() {
+    if (motionBusy) return;
+    motionBusy      = true;             // Actions may call runMotors
+    if (motionCount > 0) {
+        MotionCommand *cmd  = &motionQueue[motionHead];
+        if (!motionActive) {
+            startMotion(cmd);
+            motionActive    = true;
+        }
+        bool done   = stepMotion(cmd);
+        if (done && motionActive) {     // Not preempted by the command
+            motionActive    = false;
+            motionHead      = (motionHead + 1) % MOTIONQUEUE;
+            motionCount--;
+            if ((motionCount == 0) && motionIdleCallback) motionIdleCallback();
+        }
+    }
+    motionBusy      = false;
+}
+
+void updateMotion() {
+    uint32_t now    = millis();
+    if (now - motionTime < MOTIONINTERVAL) return;
+    motionTime      = now;
+    motionStep();
+}
+
+void preemptMotion() {                  // Keep the current ramp values
+    motionCount     = 0;
+    motionActive    = false;
+}
+
+bool isMotionIdle() {
+    return motionCount == 0;
+}
+
+uint8_t queuedMotions() {
+    return motionCount;
+}
+
+void onMotionIdle(void idle(void)) {
+    motionIdleCallback = idle;
+}
+
+bool queueForward(int16_t targetPower, int32_t rampDuration) {
+    return queueMotion(MOTION_RAMP, targetPower, 100, 100, rampDuration, NULL, NULL);
+}
+
+bool queueBackward(int16_t targetPower, int32_t rampDuration) {
+    return queueMotion(MOTION_RAMP, -targetPower, 100, 100, rampDuration, NULL, NULL);
+}
+
+bool queueTurnLeft(int16_t leftSpeed, int32_t turnDuration) {
+    return queueMotion(MOTION_TURNLEFT, 0, leftSpeed, 0, turnDuration, NULL, NULL);
+}
+
+bool queueTurnRight(int16_t rightSpeed, int32_t turnDuration) {
+    return queueMotion(MOTION_TURNRIGHT, 0, 0, rightSpeed, turnDuration, NULL, NULL);
+}
+
+bool queueBrake(int32_t brakeDuration) {
+    return queueMotion(MOTION_BRAKE, 0, 0, 0, brakeDuration, NULL, NULL);
+}
+
+bool queueUntil(bool condition(void), int32_t maxDuration) {
+    return queueMotion(MOTION_UNTIL, 0, 0, 0, maxDuration, condition, NULL);
+}
+
+bool queueWhile(void actionLoop(bool), bool condition(void), int32_t maxDuration) {
+    return queueMotion(MOTION_WHILE, 0, 0, 0, maxDuration, condition, actionLoop);
+}
+
+bool queueAction(void actionLoop(bool), int32_t duration) {
+    return queueMotion(MOTION_WHILE, 0, 0, 0, duration, NULL, actionLoop);
+}
+
+bool queueTurnBy(int16_t power, int16_t angle, int32_t maxDuration) {
+    return queueMotion(MOTION_TURNBY, power, angle, 0, maxDuration, NULL, NULL);
+}
+
+bool queueTurnTo(int16_t power, uint16_t heading, int32_t maxDuration) {
+    return queueMotion(MOTION_TURNTO, power, heading, 0, maxDuration, NULL, NULL);
+}
+
+bool queueStop() {
+    return queueMotion(MOTION_STOP, 0, 0, 0, 0, NULL, NULL);
+}
+
+void waitMotion() {
+    while (!isMotionIdle()) {
+        dataLogger();
+    }
+}
 
-    currentPower    = targetPower;
-    leftMultiplier  = leftTarget;
-    rightMultiplier = rightTarget; 
+void waitSlot() {                       // Room for one more command
+    while (motionCount >= MOTIONQUEUE) {
+        dataLogger();
+    }
 }
 
+//---------------------------------------------------- Blocking Motions ------
+
 void moveForward(int16_t targetPower, int32_t rampDuration) {
-    rampPower(targetPower, rampDuration, 100, 100);
+    waitSlot();
+    queueForward(targetPower, rampDuration);
+    waitMotion();
 }
 
 void moveBackward(int16_t targetPower, int32_t rampDuration) {
-    rampPower(-targetPower, rampDuration, 100, 100);
+    waitSlot();
+    queueBackward(targetPower, rampDuration);
+    waitMotion();
 }
 
 void turnLeft(int16_t leftSpeed, int32_t turnDuration) {
-    if (currentPower == 0) {
-        rampPower(1023 * (int32_t) leftSpeed / 100, turnDuration, -100, 100);
-    } else {
-        rampPower(currentPower, turnDuration, leftSpeed, 100);
-    }
+    waitSlot();
+    queueTurnLeft(leftSpeed, turnDuration);
+    waitMotion();
 }
 
 void turnRight(int16_t rightSpeed, int32_t turnDuration) {
-    if (currentPower == 0) {
-        rampPower(1023 * (int32_t) rightSpeed / 100, turnDuration, 100, -100);
-    } else {
-        rampPower(currentPower, turnDuration, 100, rightSpeed);
-    }
+    waitSlot();
+    queueTurnRight(rightSpeed, turnDuration);
+    waitMotion();
+}
+
+void turnBy(int16_t power, int16_t angle, int32_t maxDuration) {
+    waitSlot();
+    queueTurnBy(power, angle, maxDuration);
+    waitMotion();
+}
+
+void turnTo(int16_t power, uint16_t heading, int32_t maxDuration) {
+    waitSlot();
+    queueTurnTo(power, heading, maxDuration);
+    waitMotion();
 }
 
 void brakeToZero(int32_t brakeDuration) {
-    rampPower(0,brakeDuration,leftMultiplier,rightMultiplier);
+    waitSlot();
+    queueBrake(brakeDuration);
+    waitMotion();
 }
 
 void moveUntil(bool condition(), int32_t maxDuration) {
-    if (maxDuration < 1) {
-        while (!condition()) {         // No time limit
-            dataLogger();
-        }
-    } else {
-        int32_t startTime = millis();
-        int32_t deltaTime;
-        do {
-            deltaTime = millis() - startTime;
-            dataLogger();
-        } while (!condition() && (deltaTime < maxDuration));
-    }
+    waitSlot();
+    queueUntil(condition, maxDuration);
+    waitMotion();
 }
 
 void executeWhile(void actionLoop(bool), bool condition(void), int32_t maxDuration) {
-    int32_t     startTime = millis();
-    int32_t     actionTime;
-    int32_t     deltaTime;
-
-    actionLoop(true);
-    while (condition()) {
-        actionTime      = millis();
-        while (actionTime == millis()) {
-                                    // Wait for the next ms
-        }
-        actionLoop(false);
-        dataLogger();
-        if (maxDuration > 0) {      // Check explicit time limit
-            deltaTime   = millis() - startTime;
-            if (deltaTime >= maxDuration) return;
-        }
-    }
+    waitSlot();
+    queueWhile(actionLoop, condition, maxDuration);
+    waitMotion();
 }
 
 void stopMotors() {
-    currentPower = 0;
-    mtrL.stop();                        // Stop both motors
-    mtrR.stop();
+    preemptMotion();
+    haltMotors();
 }
 
 void stopAll() {
     stopMotors();
-    while(1);                           // Stop looping    
+    while (1) delay(1000);              // Stop looping
 }
 
 int16_t getODS(ODSPin pinNr) {
-    return GP2Y0A21distance(analogRead(pinNr));
+    int16_t reading = simulator? simulator->ods(pinNr): AdcSampler::read(pinNr);
+    return GP2Y0A21distance(reading, pinNr - ODS_L);
 }
 
 void enableUS(USChannel channelNr) {
@@ -192,9 +875,361 @@ void disableUS(USChannel channelNr) {
 }
 
 int16_t getUS(USChannel channelNr) {
+    if (simulator) return simulator->us(channelNr);
     return ultraSound.readSensor(channelNr);
 }
 
+void readMount(uint8_t index, SensorMount *mount) {
+    mount->x        = pgm_read_word(&sensorMounts[index].x);
+    mount->y        = pgm_read_word(&sensorMounts[index].y);
+    mount->angle    = pgm_read_word(&sensorMounts[index].angle);
+}
+
+void getMount(USChannel channelNr, SensorMount *mount) {
+    readMount(channelNr - US_FL, mount);
+}
+
+void getMount(ODSPin pinNr, SensorMount *mount) {
+    readMount(6 + pinNr - ODS_L, mount);
+}
+
+void getMount(IRPin pinNr, SensorMount *mount) {
+    readMount(8 + pinNr - IR_LF, mount);
+}
+
+uint8_t getIRMask() {
+    if (simulator == NULL) return IrLatch::read();
+    uint8_t mask    = 0;
+    for (int i=0;i<8;i++) {
+        if (simulator->ir((IRPin) (IR_LF + i))) mask |= 1 << i;
+    }
+    return mask;
+}
+
 bool getIR(IRPin pinNr) {
-    return !digitalRead(pinNr);
-}
\ No newline at end of file
+    return getIRMask() & (1 << (pinNr - IR_LF));
+}
+
+uint8_t getIRLatched() {
+    return IrLatch::latched();
+}
+
+uint32_t getIRTime(IRPin pinNr) {
+    return IrLatch::latchTime(pinNr - IR_LF);
+}
+
+void ackIR(uint8_t mask) {
+    IrLatch::acknowledge(mask);
+}
+
+uint16_t odsSigma(int16_t distance) {   // [mm]
+    if ((distance < ODSMIN) || (distance > ODSMAX)) return 0;
+    if (distance > ODSPRECISE) return distance / 4;
+    return 5 + distance / 25;           // 9 mm at 100 mm, 45 mm at 1 m
+}
+
+uint16_t usSigma(USChannel channelNr, int16_t distance) {
+    if ((distance < USMIN) || (distance > USMAX)) return 0;
+    return 10 + ultraSound.jitter(channelNr) / 6;   // 1 us is 0.17 mm
+}
+
+void updateFusion() {
+    uint32_t    now     = millis();
+    uint8_t     fresh;
+    bool        odsNew[2];
+    int16_t     ods[2];
+    uint16_t    odsS[2];
+
+    cli();
+    fresh   = usFresh;
+    usFresh = 0;
+    sei();
+
+    for (int i=0;i<2;i++) {             // ODS_L and ODS_R
+        uint16_t count  = AdcSampler::sampleCount(ODS_L + i);
+        odsNew[i]       = (count != odsSamples[i]) && (now - odsTime[i] >= ODSPERIOD);
+        if (odsNew[i]) {                // One update per sensor measurement
+            odsSamples[i]   = count;
+            odsTime[i]      = now;
+        }
+        ods[i]          = getODS((ODSPin) (ODS_L + i));
+        odsS[i]         = odsSigma(ods[i]);
+    }
+    for (int i=0;i<DIRCOUNT;i++) {
+        fusion[i].predict(now);
+        USChannel   ch  = (USChannel) (US_FL + i);
+        if (fresh & (1 << ch)) {
+            int16_t d   = getUS(ch);
+            fusion[i].update(d, usSigma(ch, d));
+        }
+    }
+    if (odsNew[0]) {
+        fusion[DIR_L].update(ods[0], odsS[0]);
+        fusion[DIR_F].update(ods[0], 2 * odsS[0]);  // Looking past the front
+    }
+    if (odsNew[1]) {
+        fusion[DIR_R].update(ods[1], odsS[1]);
+        fusion[DIR_F].update(ods[1], 2 * odsS[1]);
+    }
+}
+
+int16_t getDistance(Direction dirNr) {
+    return fusion[dirNr].distance();
+}
+
+uint8_t getConfidence(Direction dirNr) {
+    return fusion[dirNr].confidence();
+}
+
+//---------------------------------------------------- Planner ---------------
+
+void planStep() {
+    SensorMount mount;
+    uint32_t    usMask  = ultraSound.selectionMask();
+    planner.clear();
+    for (int i=0;i<USCOUNT;i++) {       // Only the enabled channels
+        USChannel ch    = (USChannel) (US_FL + i);
+        if (!(usMask & (1UL << ch))) continue;
+        int16_t d       = getUS(ch);
+        if (d == 0) continue;           // No data until the filter window is full
+        getMount(ch, &mount);
+        planner.addReading(mount.angle, d, USSPREAD);
+    }
+    for (int i=0;i<2;i++) {
+        ODSPin pin      = (ODSPin) (ODS_L + i);
+        getMount(pin, &mount);
+        planner.addReading(mount.angle, getODS(pin));
+    }
+    uint8_t     irMask  = getIRMask() | IrLatch::activatedSince(&irPlanSeen);
+    for (int i=0;i<8;i++) {
+        IRPin pin       = (IRPin) (IR_LF + i);
+        if (!(irMask & (1 << i))) continue;
+        getMount(pin, &mount);
+        planner.addHit(mount.angle);
+    }
+    planner.select(plannerGoal);
+    int16_t     left, right;
+    planner.powers(plannerPower, &left, &right);
+    setMotors(left, right);
+}
+
+void runPlanner(int16_t power, uint16_t goalAngle) {
+    preemptMotion();
+    plannerPower    = power;
+    plannerGoal     = goalAngle;
+    if (!plannerActive) {
+        plannerActive   = true;
+        plannerTime     = micros();
+        planStep();                 // Plan immediately, then in the planner slots
+    }
+    dataLogger();
+}
+
+void stopPlanner() {
+    if (plannerActive) stopMotors();
+}
+
+bool isPlannerActive() {
+    return plannerActive;
+}
+
+uint16_t plannerHeading() {
+    return planner.heading();
+}
+
+void updatePlanner() {              // Every PLANNERINTERVAL ms
+    uint32_t now    = micros();
+    if (!plannerActive || (now - plannerTime < PLANNERINTERVAL * 1000UL)) return;
+    plannerTime     = now;
+    planStep();
+}
+
+//---------------------------------------------------- Pose ------------------
+
+int32_t modelCounts(uint8_t i, int16_t power, uint32_t elapsed) {
+    int32_t     speed   = 0;        // [counts/s]
+    int16_t     drive   = abs(power) - modelDeadband;
+    if (drive > 0) speed = (int32_t) drive * modelSpeed / (1023 - modelDeadband);
+    if (power < 0) speed = -speed;
+    modelMilli[i]   += speed * (int32_t) elapsed;
+    modelCount[i]   += modelMilli[i] / 1000;
+    modelMilli[i]   %= 1000;
+    return modelCount[i];
+}
+
+int32_t poseCounts(uint8_t i, uint32_t elapsed) {
+    if (poseSource == POSE_MODEL) {
+        return modelCounts(i, (i == WHEEL_L)? mtrL.power(): mtrR.power(), elapsed);
+    }
+    return getCount((Wheel) i);
+}
+
+void poseStep(uint32_t time) {      // [us]
+    uint32_t    elapsed = (time - poseTime) / 1000;     // [ms], the rest in the next step
+    poseTime    += elapsed * 1000;
+    int16_t     delta[2];
+    for (int i=0;i<2;i++) {
+        int32_t count   = poseCounts(i, elapsed);
+        delta[i]        = count - poseCount[i];
+        poseCount[i]    = count;
+    }
+    pose.update(delta[WHEEL_L], delta[WHEEL_R]);
+}
+
+void updatePose() {                 // Every POSEINTERVAL ms
+    uint32_t    now     = micros();
+    if (now - poseTime < POSEINTERVAL * 1000UL) return;
+    poseStep(now);
+}
+
+void setPoseSource(PoseSource source) {
+    poseSource  = source;
+    for (int i=0;i<2;i++) {         // No jump at the switch
+        poseCount[i]    = poseCounts(i, 0);
+    }
+}
+
+void setPoseModel(uint16_t deadband, uint16_t fullSpeed) {
+    modelDeadband   = (deadband < 1000)? deadband: 1000;
+    modelSpeed      = fullSpeed;
+}
+
+void setPose(int32_t x, int32_t y, uint16_t heading) {
+    pose.reset(x, y, heading);
+}
+
+int32_t getPoseX() {
+    return pose.x();
+}
+
+int32_t getPoseY() {
+    return pose.y();
+}
+
+uint16_t getHeading() {
+    return pose.heading();
+}
+
+void correctHeading(uint16_t heading, uint8_t gain) {
+    pose.correctHeading(heading, gain);
+}
+
+//---------------------------------------------------- Safety Reflex ---------
+
+void setSafety(uint8_t irMask, uint8_t usMask, int16_t usDistance, uint16_t current) {
+    cli();
+    safetyIRMask        = irMask;
+    safetyUSMask        = (usDistance > 0)? usMask: 0;
+    safetyUSDistance    = usDistance;
+    safetyCurrent       = current;
+    sei();
+}
+
+uint8_t getSafetyFault() {
+    return safetyFault;
+}
+
+uint32_t getSafetyTime() {
+    cli();
+    uint32_t    time    = safetyTime;
+    sei();
+    return time;
+}
+
+uint16_t getSafetyReaction() {
+    cli();
+    uint16_t    reaction = safetyReaction;
+    sei();
+    return reaction;
+}
+
+void resetSafety() {                // Also the current trips, braked until the next command
+    cli();
+    safetyFault = 0;
+    mtrL.resetTrip();
+    mtrR.resetTrip();
+    sei();
+}
+
+//---------------------------------------------------- Scheduler -------------
+
+void sensorSnapshot(uint32_t time) {    // All sensors in one slot
+    RoverSensors *v     = &sensorView;
+    uint32_t    echoTime[USCOUNT];
+    uint8_t     echoed;
+    cli();
+    echoed  = usEchoed;
+    for (int i=0;i<USCOUNT;i++) echoTime[i] = usTime[i];
+    sei();
+    v->time     = time;
+    v->ir       = getIRMask() | IrLatch::activatedSince(&irSensorSeen);
+    for (int i=0;i<2;i++) {
+        v->ods[i]       = getODS((ODSPin) (ODS_L + i));
+        v->count[i]     = getCount((Wheel) i);
+        v->speed[i]     = speedPV[i];
+    }
+    v->current[WHEEL_L] = simulator? 0: mtrL.current();
+    v->current[WHEEL_R] = simulator? 0: mtrR.current();
+    for (int i=0;i<USCOUNT;i++) {
+        v->us[i]        = getUS((USChannel) (US_FL + i));
+        int32_t age     = time - echoTime[i];           // The echo can be after the slot
+        if (age < 0) age = 0;
+        age /= 1000;
+        v->usAge[i]     = (!(echoed & (1 << i)) || (age > 0xFFFE))? 0xFFFF: age;
+    }
+}
+
+uint32_t slotMillis(uint32_t time) {    // [ms] of the slot at time [us]
+    return millis() - (micros() - time) / 1000;
+}
+
+void simulatorTask(uint32_t)        {if (simulator) stepSimulator();}
+void motionTask(uint32_t)           {motionStep();}
+void motorsTask(uint32_t)           {mtrL.update(); mtrR.update();}
+void speedTask(uint32_t time)       {speedStep(); speedTime = time;}
+void poseTask(uint32_t time)        {poseStep(time);}
+void fusionTask(uint32_t)           {updateFusion();}
+void logTask(uint32_t time)         {if (logOutput) logSample(slotMillis(time));}
+void plannerTask(uint32_t time)     {if (plannerActive) {plannerTime = time; planStep();}}
+void drainTask(uint32_t)            {drainLog();}
+
+typedef struct {
+    TickTask    task;
+    uint8_t     period, phase;      // [ms]
+} RoverSchedule;
+
+const RoverSchedule roverSchedule[] = {     // In the order of RoverTask
+    {simulatorTask, 1,                  0},
+    {motionTask,    MOTIONINTERVAL,     0},
+    {motorsTask,    1,                  0},
+    {speedTask,     SPEEDINTERVAL,      1},
+    {poseTask,      POSEINTERVAL,       2},
+    {fusionTask,    FUSIONINTERVAL,     3},
+    {logTask,       LOGINTERVAL,        4},
+    {sensorSnapshot, SENSORINTERVAL,    5},
+    {plannerTask,   PLANNERINTERVAL,    7},
+    {drainTask,     DRAININTERVAL,      0}
+};
+
+void initScheduler() {
+    if (scheduler.count() == 0) {   // Once, initWH_Rover may be called again
+        for (uint8_t i=0;i<sizeof(roverSchedule)/sizeof(RoverSchedule);i++) {
+            scheduler.add(roverSchedule[i].task, roverSchedule[i].period, roverSchedule[i].phase);
+        }
+    }
+    IrLatch::activatedSince(&irSensorSeen);     // Skip the earlier bumps
+    memset(&sensorView, 0, sizeof(RoverSensors));
+    scheduler.begin();
+}
+
+void getSensors(RoverSensors *sensors) {
+    *sensors    = sensorView;
+}
+
+void getTaskStats(RoverTask task, TickStats *stats) {
+    scheduler.stats(task, stats);
+}
+
+void resetTaskStats() {
+    scheduler.resetStats();
+}
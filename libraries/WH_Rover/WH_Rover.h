@@ -2,6 +2,7 @@
 #define WH_ROVER_H_H
 
 #include <Arduino.h>
+#include <TickScheduler.h>
 
 typedef enum ODSPins {
     ODS_L = A6,
@@ -17,6 +18,18 @@ typedef enum USChannels {
     US_BL = 5
 } USChannel;
 
+typedef enum EncoderPins {
+    ENC_LA = 2,                     // INT4
+    ENC_LB = 30,
+    ENC_RA = 3,                     // INT5
+    ENC_RB = 31
+} EncoderPin;
+
+typedef enum Wheels {
+    WHEEL_L = 0,
+    WHEEL_R = 1
+} Wheel;
+
 typedef enum IRPins {
     IR_LF = 18,
     IR_FL = 19,
@@ -28,23 +41,144 @@ typedef enum IRPins {
     IR_LB = 25
 } IRPin;
 
+typedef enum Directions {
+    DIR_L = 0,                      // US_FL and ODS_L
+    DIR_F = 1,                      // US_FF, ODS_L, and ODS_R
+    DIR_R = 2                       // US_FR and ODS_R
+} Direction;
+
+typedef enum PoseSources {
+    POSE_ENCODERS   = 0,            // Wheel encoder counts
+    POSE_MODEL      = 1             // Counts from the motor powers
+} PoseSource;
+
+typedef enum SafetyCauses {
+    SAFETY_IR       = 1,            // IR activation in the trip mask
+    SAFETY_US       = 2,            // US echo under the trip distance
+    SAFETY_CURRENT  = 4             // Motor current over the trip current
+} SafetyCause;
+
+typedef enum RoverTasks {           // Scheduled every period [ms] at phase
+    TASK_SIMULATOR  = 0,            //  1   0   RoverSim step, when attached
+    TASK_MOTION     = 1,            //  1   0   Motion queue
+    TASK_MOTORS     = 2,            //  1   0   Current limits
+    TASK_SPEED      = 3,            // 20   1   Encoders and speed control
+    TASK_POSE       = 4,            // 20   2   Dead reckoning
+    TASK_FUSION     = 5,            //  5   3   ODS and US range filters
+    TASK_LOG        = 6,            // 20   4   Telemetry record
+    TASK_SENSORS    = 7,            // 10   5   getSensors() snapshot
+    TASK_PLANNER    = 8,            // 50   7   Obstacle avoidance
+    TASK_DRAIN      = 9             // 10   0   Telemetry output
+} RoverTask;
+
+typedef struct {                    // All sensors at the same time
+    uint32_t    time;               // [us] micros() of the snapshot slot
+    int16_t     ods[2];             // [mm] ODS_L, ODS_R
+    int16_t     us[6];              // [mm] US_FL .. US_BL, 0 = disabled
+    uint16_t    usAge[6];           // [ms] since the last echo, 0xFFFF = none
+    uint8_t     ir;                 // IR mask and the bumps since the previous snapshot
+    int16_t     current[2];         // [ADC] motor current sense, left and right
+    int32_t     count[2];           // Encoder counts
+    int16_t     speed[2];           // [counts/s]
+} RoverSensors;
+
+typedef struct {
+    int16_t     x, y;               // [mm] forward and left from the center
+    uint16_t    angle;              // 65536 = 360 deg, 0 = forward, CCW
+} SensorMount;
+
+class RoverSimHook {                // Simulated motors and sensors (RoverSim)
+public:
+    virtual uint8_t step(uint32_t now, int16_t leftPower, int16_t rightPower) = 0;  // New US echoes
+    virtual int32_t count(Wheel wheelNr) = 0;           // Encoder counts
+    virtual int16_t ods(ODSPin pinNr) = 0;              // ADC reading
+    virtual int16_t us(USChannel channelNr) = 0;        // [mm]
+    virtual bool    ir(IRPin pinNr) = 0;
+};
+
 void initWH_Rover();
+void updateWH_Rover();
+void attachSimulator(RoverSimHook *sim);                // NULL = hardware
+RoverSimHook *getSimulator();                           // NULL = hardware
+void setLogOutput(Stream *out, bool waitFree = true);   // NULL = off
+uint16_t droppedLogRecords();
 
 void    runMotors(int16_t leftPower, int16_t rightPower);
+void    runSpeed(int16_t leftSpeed, int16_t rightSpeed);
 void    moveForward(int16_t targetPower, int32_t rampDuration);
 void    moveBackward(int16_t targetPower, int32_t rampDuration);
 void    turnLeft(int16_t leftSpeed, int32_t turnDuration);
 void    turnRight(int16_t rightSpeed, int32_t turnDuration);
+void    turnBy(int16_t power, int16_t angle, int32_t maxDuration);      // 65536 = 360 deg, CCW, 0 = 10 s
+void    turnTo(int16_t power, uint16_t heading, int32_t maxDuration);
 void    brakeToZero(int32_t brakeDuration);
 void    moveUntil(bool condition(void), int32_t maxDuration);
 void    executeWhile(void actionLoop(bool), bool condition(void), int32_t maxDuration);
 void    stopMotors();
 void    stopAll();
 
+bool    queueForward(int16_t targetPower, int32_t rampDuration);
+bool    queueBackward(int16_t targetPower, int32_t rampDuration);
+bool    queueTurnLeft(int16_t leftSpeed, int32_t turnDuration);
+bool    queueTurnRight(int16_t rightSpeed, int32_t turnDuration);
+bool    queueTurnBy(int16_t power, int16_t angle, int32_t maxDuration);
+bool    queueTurnTo(int16_t power, uint16_t heading, int32_t maxDuration);
+bool    queueBrake(int32_t brakeDuration);
+bool    queueUntil(bool condition(void), int32_t maxDuration);
+bool    queueWhile(void actionLoop(bool), bool condition(void), int32_t maxDuration);
+bool    queueAction(void actionLoop(bool), int32_t duration);
+bool    queueStop();
+void    preemptMotion();
+bool    isMotionIdle();
+uint8_t queuedMotions();
+void    onMotionIdle(void idle(void));
+void    waitMotion();
+void    updateMotion();
+
+void    runPlanner(int16_t power, uint16_t goalAngle = 0);     // 65536 = 360 deg
+void    stopPlanner();
+bool    isPlannerActive();
+uint16_t plannerHeading();
+void    updatePlanner();
+
+void    setSafety(uint8_t irMask, uint8_t usMask = 0, int16_t usDistance = 0, uint16_t current = 0);
+uint8_t getSafetyFault();           // SafetyCause bits, 0 = no trip
+uint32_t getSafetyTime();           // [us] of the first trip
+uint16_t getSafetyReaction();       // [us] worst case from the trip check to brake
+void    resetSafety();
+
 int16_t getODS(ODSPin pinNr);
 void    enableUS(USChannel channelNr);
 void    disableUS(USChannel channelNr);
-int16_t getUS(USChannel channelNr);
+int16_t getUS(USChannel channelNr);    // [mm], 0 = no data yet
 bool    getIR(IRPin pinNr);
+uint8_t getIRMask();                // Bit 0 = IR_LF ... bit 7 = IR_LB
+uint8_t getIRLatched();
+uint32_t getIRTime(IRPin pinNr);    // [ms] when latched
+void    ackIR(uint8_t mask);
+void    getMount(USChannel channelNr, SensorMount *mount);
+void    getMount(ODSPin pinNr, SensorMount *mount);
+void    getMount(IRPin pinNr, SensorMount *mount);
+
+int32_t getCount(Wheel wheelNr);
+int16_t getSpeed(Wheel wheelNr);
+void    updateSpeed();
+
+void    setPoseSource(PoseSource source);
+void    setPoseModel(uint16_t deadband, uint16_t fullSpeed);  // Power, [counts/s] at 1023
+void    setPose(int32_t x, int32_t y, uint16_t heading);      // [mm], 65536 = 360 deg
+int32_t getPoseX();                 // [mm]
+int32_t getPoseY();
+uint16_t getHeading();              // 0 = +x, CCW
+void    correctHeading(uint16_t heading, uint8_t gain);       // gain / 256 of the error
+void    updatePose();
+
+void    getSensors(RoverSensors *sensors);                  // Latest snapshot, every 10 ms
+void    getTaskStats(RoverTask task, TickStats *stats);
+void    resetTaskStats();
+
+void    updateFusion();
+int16_t getDistance(Direction dirNr);
+uint8_t getConfidence(Direction dirNr);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,54 @@
+/**
+ * Drive around the obstacles with the built-in planner
+ *  - The front ultrasonic sensors are enabled for the planner
+ *  - runPlanner drives with power 600 towards the front, and turns to
+ *    the free direction closest to it
+ *  - With SIMULATE 1 the rover drives in a RoverSim room, so the planner
+ *    can be tried without the robot.  The collisions should stay at 0,
+ *    which the planner scenario of libraries/RoverSim/extras/host checks
+ *    for 300 s on a PC
+ *  - The selected heading is printed every 500 ms
+ */
+
+#include <WH_Rover.h>
+
+#define SIMULATE    1               // 0 = drive the real rover
+
+#if SIMULATE
+#include <RoverSim.h>
+RoverSim    room;
+#endif
+
+uint32_t    printTime;
+
+void setup() {
+    Serial.begin(115200);
+    initWH_Rover();
+#if SIMULATE
+    room.addBox(-1500,-1000,1500,1000);     // Walls [mm]
+    room.addBox(600,-300,900,300);          // Obstacle
+    room.setPose(-1000,0,0);
+    attachSimulator(&room);
+#endif
+    enableUS(US_FL);
+    enableUS(US_FR);
+    runPlanner(600);
+    printTime = millis();
+}
+
+void loop() {
+    updateWH_Rover();
+    if (millis() - printTime >= 500) {
+        printTime += 500;
+        Serial.print((int16_t) plannerHeading() * 360L / 65536);
+#if SIMULATE
+        Serial.print("\t");
+        Serial.print(room.x());
+        Serial.print("\t");
+        Serial.print(room.y());
+        Serial.print("\t");
+        Serial.print(room.collisions());
+#endif
+        Serial.println();
+    }
+}
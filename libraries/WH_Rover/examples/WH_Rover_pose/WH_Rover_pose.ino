@@ -0,0 +1,66 @@
+/**
+ * Drive a square with heading-targeted turns and print the pose
+ *  - Each side is 1.5 s straight, then a brake and a 90 deg turn left
+ *    by the dead reckoned heading instead of a timed turn
+ *  - x and y in mm and the heading in deg are printed every 500 ms
+ *  - With SIMULATE 1 the rover drives in a RoverSim room, and the true
+ *    pose of the simulation is printed after the estimate
+ *  - Without encoders, use setPoseSource(POSE_MODEL) and calibrate
+ *    setPoseModel() so that a straight run gives the measured distance
+ */
+
+#include <WH_Rover.h>
+#include <FixedTrig.h>
+
+#define SIMULATE    1               // 0 = drive the real rover
+
+#if SIMULATE
+#include <RoverSim.h>
+RoverSim    room;
+#endif
+
+uint32_t    printTime;
+
+void queueSquare() {
+    for (int i=0;i<4;i++) {
+        queueForward(600, 300);             // Ramp up
+        queueForward(600, 1500);            // Keep the power
+        queueBrake(300);
+        queueTurnBy(500, FIXEDTRIG_DEG(90), 3000);
+    }
+}
+
+void setup() {
+    Serial.begin(115200);
+    initWH_Rover();
+#if SIMULATE
+    room.addBox(-2000,-2000,2000,2000);     // Walls [mm]
+    room.setPose(-1000,-1000,0);
+    attachSimulator(&room);
+    setPose(room.x(), room.y(), room.heading());
+#endif
+    onMotionIdle(queueSquare);
+    queueSquare();
+    printTime = millis();
+}
+
+void loop() {
+    updateWH_Rover();
+    if (millis() - printTime >= 500) {
+        printTime += 500;
+        Serial.print(getPoseX());
+        Serial.print("\t");
+        Serial.print(getPoseY());
+        Serial.print("\t");
+        Serial.print((int16_t) getHeading() * 360L / 65536);
+#if SIMULATE
+        Serial.print("\t");
+        Serial.print(room.x());
+        Serial.print("\t");
+        Serial.print(room.y());
+        Serial.print("\t");
+        Serial.print((int16_t) room.heading() * 360L / 65536);
+#endif
+        Serial.println();
+    }
+}
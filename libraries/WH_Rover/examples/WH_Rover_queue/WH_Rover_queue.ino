@@ -0,0 +1,36 @@
+/**
+ * Drive a pattern with the motion queue while the loop keeps running
+ *  - The moves are queued and executed by updateWH_Rover
+ *  - The loop checks the front IR sensors every ms, also during the ramps
+ *  - An obstacle preempts the queue and brakes in 0.3 s
+ *  - When the queue is empty, the pattern is queued again
+ */
+
+#include <WH_Rover.h>
+#define  LED     13
+
+void queuePattern() {
+    queueForward(800,1000);     // Accelerate to power 800 in 1 sec
+    queueTurnLeft(50,500);      // Turn left for 0.5 s
+    queueForward(800,500);      // Straight again
+    queueBrake(1000);           // SlowDown to halt in 1 sec
+    queueTurnRight(100,1000);   // Turn CW in 1 sec for full speed
+    queueBrake(500);
+}
+
+void setup() {
+    initWH_Rover();
+    pinMode(LED,OUTPUT);
+    onMotionIdle(queuePattern); // Repeat the pattern
+    queuePattern();
+}
+
+void loop() {
+    updateWH_Rover();
+    bool obstacle = getIR(IR_FL) || getIR(IR_FR);
+    digitalWrite(LED, obstacle);
+    if (obstacle && (queuedMotions() > 1)) {
+        preemptMotion();        // Drop the pattern
+        queueBrake(300);
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * Stop the motors in the interrupts with the safety reflex
+ *  - The front IR sensors, US_FF under 200 mm, and motor currents over
+ *    25 A trip the reflex
+ *  - The rover drives forward with the blocking moveForward.  A trip
+ *    brakes the motors at once, and moveForward returns
+ *  - The cause, the time, and the worst case reaction time are printed
+ *    to the PC, then the rover backs off and the fault is reset.  The
+ *    reaction is from the trip check in the interrupt to both motors
+ *    braked, without the interrupt entry and the ADC tick polling
+ */
+
+#include <WH_Rover.h>
+
+#define TRIPIR      ((1 << (IR_FL - IR_LF)) | (1 << (IR_FR - IR_LF)))
+#define TRIPUS      (1 << US_FF)
+#define TRIPRANGE   200             // [mm]
+#define TRIPCURRENT 680             // [ADC] About 25 A
+
+bool tripped() {                    // The reflex has already braked
+    return getSafetyFault() != 0;
+}
+
+void setup() {
+    Serial.begin(115200);
+    initWH_Rover();
+    setSafety(TRIPIR, TRIPUS, TRIPRANGE, TRIPCURRENT);
+}
+
+void loop() {
+    moveForward(600, 1000);         // Ramp up in 1 s
+    moveUntil(tripped, 10000);      // Keep going up to 10 s
+    uint8_t fault   = getSafetyFault();
+    if (fault == 0) {
+        brakeToZero(500);
+        return;
+    }
+    Serial.print("Trip");
+    if (fault & SAFETY_IR)      Serial.print(" IR");
+    if (fault & SAFETY_US)      Serial.print(" US");
+    if (fault & SAFETY_CURRENT) Serial.print(" current");
+    Serial.print(" at ");
+    Serial.print(getSafetyTime());
+    Serial.print(" us, worst reaction ");
+    Serial.print(getSafetyReaction());
+    Serial.println(" us");
+    delay(2000);
+    resetSafety();
+    moveBackward(400, 300);         // Back off and stop
+    brakeToZero(300);
+}
@@ -0,0 +1,101 @@
+/**
+ * Print the time aligned sensor snapshot and the scheduler statistics
+ *  - The rover runs the obstacle avoidance planner, so all the tasks
+ *    have work to do
+ *  - Every second one snapshot from getSensors() is printed: the slot
+ *    time in us, ODS, US with the echo ages, IR bits, currents, and speeds
+ *  - Every 5 s the runs, missed slots (overruns), worst jitter, and worst
+ *    duration in us are printed per task, and the statistics are reset
+ *  - A delay in loop() shows as jitter, and over a period as overruns
+ *  - With SIMULATE 1 the rover drives in a RoverSim room
+ */
+
+#include <WH_Rover.h>
+
+#define SIMULATE    1               // 0 = drive the real rover
+#define LOOPDELAY   0               // [ms] extra work in the loop
+
+#if SIMULATE
+#include <RoverSim.h>
+RoverSim    room;
+#endif
+
+const char  *taskNames[] = {
+    "simulator", "motion", "motors", "speed", "pose",
+    "fusion", "log", "sensors", "planner", "drain"};
+
+uint32_t    printTime, statsTime;
+
+void printSensors() {
+    RoverSensors s;
+    getSensors(&s);
+    Serial.print(s.time);
+    Serial.print("\tODS ");
+    Serial.print(s.ods[0]);
+    Serial.print(" ");
+    Serial.print(s.ods[1]);
+    Serial.print("\tUS");
+    for (int i=0;i<6;i++) {
+        Serial.print(" ");
+        Serial.print(s.us[i]);
+        Serial.print("/");
+        Serial.print(s.usAge[i]);
+    }
+    Serial.print("\tIR ");
+    Serial.print(s.ir, BIN);
+    Serial.print("\tI ");
+    Serial.print(s.current[WHEEL_L]);
+    Serial.print(" ");
+    Serial.print(s.current[WHEEL_R]);
+    Serial.print("\tspeed ");
+    Serial.print(s.speed[WHEEL_L]);
+    Serial.print(" ");
+    Serial.println(s.speed[WHEEL_R]);
+}
+
+void printStats() {
+    TickStats   stats;
+    Serial.println("task\truns\tover\tjitter\tduration");
+    for (int i=TASK_SIMULATOR;i<=TASK_DRAIN;i++) {
+        getTaskStats((RoverTask) i, &stats);
+        Serial.print(taskNames[i]);
+        Serial.print("\t");
+        Serial.print(stats.runs);
+        Serial.print("\t");
+        Serial.print(stats.overruns);
+        Serial.print("\t");
+        Serial.print(stats.maxJitter);
+        Serial.print("\t");
+        Serial.println(stats.maxDuration);
+    }
+    resetTaskStats();
+}
+
+void setup() {
+    Serial.begin(115200);
+    initWH_Rover();
+    enableUS(US_FL);
+    enableUS(US_FR);
+#if SIMULATE
+    room.addBox(-2000,-2000,2000,2000);     // Walls [mm]
+    room.addBox(-300,-300,300,300);         // Obstacle in the middle
+    room.setPose(-1000,-1000,0);
+    attachSimulator(&room);
+#endif
+    runPlanner(500);
+    printTime   = millis();
+    statsTime   = printTime;
+}
+
+void loop() {
+    updateWH_Rover();
+    if (LOOPDELAY) delay(LOOPDELAY);
+    if (millis() - printTime >= 1000) {
+        printTime += 1000;
+        printSensors();
+    }
+    if (millis() - statsTime >= 5000) {
+        statsTime += 5000;
+        printStats();
+    }
+}
@@ -0,0 +1,134 @@
+/**
+ *  File: WH_Rover_safety.cpp
+ *
+ *  Host test of the safety reflex latency
+ *
+ *  The rover drives forward without a simulator, and the test serves the
+ *  interrupts in 1 us steps: HostSonar.h for the HC_SR04 echoes, a free
+ *  running ADC with a conversion every 104 us, and the pin interrupts of
+ *  IrLatch.  Each trip condition is injected many times at a random phase
+ *  and the time to both motors halted is measured
+ *      IR on pin 18, pin interrupt     immediate
+ *      IR on pin 22, polled            one ADC conversion, 104 us
+ *      current on A2 over the limit    one round of the 4 inputs, 416 us
+ *      US_FF echo under the distance   the measurement under way and the
+ *                                      next one with the short echo
+ *  It fails if a trip is over its bound, has another cause, or leaves a
+ *  motor running.
+ *
+ *      ./WH_Rover_safety               (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <WH_Rover.h>
+#include <Vnh2sp30.h>
+#include <HostSonar.h>
+#include <stdio.h>
+
+#define CONVERSION  104             // [us] 13 ADC clocks at 125 kHz
+#define ADCINPUTS   4               // A2, A3, ODS_L, ODS_R
+#define TRIPS       50
+#define FAR         3000            // [mm] US target before the trip
+#define NEAR        200
+#define TRIPDISTANCE 300
+#define CURRENT     100             // [ADC] before the trip
+#define TRIPCURRENT 600
+#define SETTLE      50000           // [us] after a reset, past the last trip echo
+#define CHANNELTIME (101 * 16 + HOSTSONAR_DELAY)    // [us] before the echo
+
+extern "C" void ADC_vect(void);
+extern Vnh2sp30 mtrL, mtrR;
+
+HostSonar   sensors;
+static uint16_t adcInputs[16];      // A0 .. A15
+static uint16_t adcPhase;           // [us] into the conversion
+static uint32_t seed    = 1;
+
+static void step() {                // 1 us of the rover hardware
+    sensors.run(1);
+    if ((ADCSRA & (1 << ADIE)) && (++adcPhase >= CONVERSION)) {
+        adcPhase    = 0;
+        ADC         = adcInputs[(ADMUX & 7) | ((ADCSRB & (1 << MUX5))? 8: 0)];
+        ADC_vect();
+    }
+}
+
+static void irPin(bool active) {
+    if (active) {
+        PIND    &= ~(1 << 3);       // Pin 18 is PD3, active low
+        hostInterrupt(digitalPinToInterrupt(IR_LF));
+    } else {
+        PIND    |= 1 << 3;
+    }
+}
+
+static void irPolled(bool active) {
+    if (active) PINA &= ~(1 << 0);  // Pin 22 is PA0
+    else        PINA |= 1 << 0;
+}
+
+static void current(bool active) {
+    adcInputs[A2 - A0]  = active? TRIPCURRENT + 100: CURRENT;
+}
+
+static void echo(bool active) {
+    sensors.setRange(US_FF, active? NEAR: FAR);
+}
+
+typedef struct {
+    const char  *name;
+    void        (*inject)(bool active);
+    uint8_t     cause;
+    uint32_t    bound;              // [us]
+} Trip;
+
+static const Trip trips[] = {
+    {"IR pin",   irPin,    SAFETY_IR,      0},
+    {"IR poll",  irPolled, SAFETY_IR,      CONVERSION},
+    {"current",  current,  SAFETY_CURRENT, ADCINPUTS * CONVERSION},
+    {"US",       echo,     SAFETY_US,      2 * CHANNELTIME
+        + (uint32_t) (FAR + NEAR) * 1000000UL / HOSTSONAR_NMPERUS}};
+#define TRIPTYPES   (sizeof(trips) / sizeof(trips[0]))
+
+int main() {
+    uint16_t    errors      = 0;
+    uint32_t    worst[TRIPTYPES];
+
+    PIND    = 0xFF;                 // IR inputs inactive
+    PINA    = 0xFF;
+    for (uint8_t i=0;i<16;i++) adcInputs[i] = CURRENT;
+    for (uint8_t i=0;i<6;i++) sensors.setRange(i, FAR);
+    initWH_Rover();
+    setSafety(0xFF, 1 << US_FF, TRIPDISTANCE, TRIPCURRENT);
+
+    printf("trip\tworst [us]\tbound [us]\n");
+    for (uint8_t t=0;t<TRIPTYPES;t++) {
+        worst[t]    = 0;
+        for (uint8_t n=0;n<TRIPS;n++) {
+            for (uint32_t i=0;i<SETTLE;i++) step();
+            resetSafety();
+            runMotors(400, 400);
+            seed    = seed * 1103515245 + 12345;
+            for (uint32_t i=(seed >> 16) % 20000;i>0;i--) step();     // Random phase
+            uint64_t    start   = hostTime();
+            trips[t].inject(true);
+            while (!getSafetyFault() && (hostTime() - start < 100000)) step();
+            uint32_t    latency = hostTime() - start;
+            trips[t].inject(false);
+            if (latency > worst[t]) worst[t] = latency;
+            bool        ok      = (getSafetyFault() == trips[t].cause)
+                               && (mtrL.state() == isHalted) && (mtrR.state() == isHalted)
+                               && (latency <= trips[t].bound);
+            if (!ok && (errors++ < 20)) {
+                printf("%s trip %u: fault %u, latency %lu us\n", trips[t].name, n,
+                    getSafetyFault(), (unsigned long) latency);
+            }
+        }
+        printf("%s\t%lu\t%lu\n", trips[t].name, (unsigned long) worst[t],
+            (unsigned long) trips[t].bound);
+    }
+    fprintf(stderr, "%u trips, IR %lu and %lu us, current %lu us, US %.1f ms, %u errors%s\n",
+        (unsigned) (TRIPTYPES * TRIPS), (unsigned long) worst[0], (unsigned long) worst[1],
+        (unsigned long) worst[2], worst[3] / 1e3, errors, errors? "  FAIL": "");
+    return errors? 1: 0;
+}
@@ -0,0 +1,53 @@
+/**
+ *  File: WH_Rover_turn.cpp
+ *
+ *  Host test of the heading turn timeouts
+ *
+ *  Without a simulator the encoders do not count, like a rover with its
+ *  wheels in the air, so the dead reckoned heading never reaches the
+ *  target of turnBy() or turnTo()
+ *  - With maxDuration 0 or negative the turn must end after 10 s
+ *  - With a maxDuration the turn must end after it
+ *  - The motors must be stopped after each turn
+ *
+ *      ./WH_Rover_turn                 (run.sh, scenarios.txt)
+ */
+
+#include <Arduino.h>
+#include <WH_Rover.h>
+#include <Vnh2sp30.h>
+#include <FixedTrig.h>
+#include <stdio.h>
+
+#define DEFAULTTIMEOUT  10000       // [ms]
+#define MARGIN          50
+
+extern Vnh2sp30 mtrL, mtrR;
+
+static uint16_t errors;
+
+static void check(const char *name, int32_t maxDuration, uint32_t start) {
+    uint32_t    expected    = (maxDuration > 0)? maxDuration: DEFAULTTIMEOUT;
+    uint32_t    duration    = millis() - start;
+    bool        ok          = (duration >= expected) && (duration <= expected + MARGIN)
+                           && (mtrL.power() == 0) && (mtrR.power() == 0);
+    printf("%s %ld ms: %lu ms%s\n", name, (long) maxDuration, (unsigned long) duration,
+        ok? "": "  FAIL");
+    if (!ok) errors++;
+}
+
+int main() {
+    static const int32_t durations[] = {0, -1, 2000};
+    initWH_Rover();
+    for (uint8_t i=0;i<3;i++) {
+        uint32_t    start   = millis();
+        turnBy(500, FIXEDTRIG_DEG(90), durations[i]);
+        check("turnBy", durations[i], start);
+        start       = millis();
+        turnTo(500, FIXEDTRIG_DEG(180), durations[i]);
+        check("turnTo", durations[i], start);
+    }
+    fprintf(stderr, "6 turns without heading feedback, %u errors%s\n",
+        errors, errors? "  FAIL": "");
+    return errors? 1: 0;
+}
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+Decode WH_Rover binary telemetry into a tab separated table.
+
+The capture is the raw byte stream written by WH_Rover after
+setLogOutput(&Serial) or setLogOutput(&file, false), for example saved
+with a serial terminal or copied from the SD card.
+
+    python3 roverlog.py capture.bin > capture.tsv
+    python3 roverlog.py --split columns capture.bin
+
+The first column is the time in ms and the other columns are the fields
+named in the header record.  With --split, every column is written into
+its own file in the given directory, one value per line.
+
+Record formats are described in RoverLog.cpp.  Records with a wrong
+checksum are skipped, and the delta records after them are skipped until
+the next key record.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+HEADER, KEY, DELTA = 0xC3, 0xA5, 0x5A
+
+
+def decode(data):
+    names, rows = None, []
+    fields, last, time = 0, None, None
+    bad = 0
+    i = 0
+    while i < len(data):
+        kind = data[i]
+        if kind == HEADER and i + 1 < len(data):
+            end = data.find(b"\0", i + 2)
+            if end < 0:
+                break
+            fields = data[i + 1]
+            names = data[i + 2:end].decode("ascii", "replace").split("\t")
+            last = None
+            i = end + 1
+            continue
+        if kind == KEY and fields:
+            size = 1 + 4 + 2 * fields + 1
+            record = data[i:i + size]
+            if len(record) == size and sum(record[:-1]) & 0xFF == record[-1]:
+                time = struct.unpack_from("<I", record, 1)[0]
+                last = list(struct.unpack_from("<%dh" % fields, record, 5))
+                rows.append([time] + last)
+                i += size
+                continue
+        if kind == DELTA and fields and last is not None:
+            size = 1 + 1 + fields + 1
+            record = data[i:i + size]
+            if len(record) == size and sum(record[:-1]) & 0xFF == record[-1]:
+                time += record[1]
+                deltas = struct.unpack_from("<%db" % fields, record, 2)
+                last = [v + d for v, d in zip(last, deltas)]
+                rows.append([time] + last)
+                i += size
+                continue
+        bad += 1                    # Not a valid record, resynchronize
+        if kind == DELTA or kind == KEY:
+            last = None
+        i += 1
+    if names is None:
+        names = ["field%d" % n for n in range(fields)]
+    return ["time"] + names, rows, bad
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--split", metavar="DIR", help="write one file per column")
+    parser.add_argument("capture")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        columns, rows, bad = decode(f.read())
+    if bad:
+        sys.stderr.write("%d bytes skipped\n" % bad)
+
+    if args.split:
+        os.makedirs(args.split, exist_ok=True)
+        for n, name in enumerate(columns):
+            with open(os.path.join(args.split, name + ".txt"), "w") as f:
+                f.writelines("%d\n" % row[n] for row in rows)
+    else:
+        print("\t".join(columns))
+        for row in rows:
+            print("\t".join(str(v) for v in row))
+
+
+if __name__ == "__main__":
+    main()
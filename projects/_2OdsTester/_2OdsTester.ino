@@ -15,6 +15,7 @@
  */
   
  #include <TM1638.h>               // Include the LED & KEY library
+#include <AdcSampler.h>             // Background sampling of the inputs
 
 TM1638  panel(37,36,35);            // Pin order: STB, CLK, DIO
 
@@ -23,11 +24,15 @@ void setup() {
   
   delay(100);                       // Flash all LEDs and digits
   panel.allOff();
+
+  AdcSampler::addChannel(A6, 0);    // No oversampling to show the raw noise
+  AdcSampler::addChannel(A7, 0);
+  AdcSampler::start();
 }
 
 void loop() {
-  uint16_t  odsL  = analogRead(A6); // Read the inputs
-  uint16_t  odsR  = analogRead(A7);
+  uint16_t  odsL  = AdcSampler::read(A6);  // Read the latest inputs
+  uint16_t  odsR  = AdcSampler::read(A7);
 
   panel.writeDec(0,odsL,4);         // Show results in LED&KEY
   panel.writeDec(4,odsR,4);
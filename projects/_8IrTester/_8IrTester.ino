@@ -17,14 +17,21 @@
  * The results  LED&KEY panel.
  *  The LEDs are showing the states of the 8 IR sensors
  *  The display shows the pin number and the sensor identification
+ *
+ * The inputs are read with the IrLatch library
+ *  - all 8 inputs in one snapshot
+ *  - a short activation is latched in the interrupts, and its LED is kept
+ *    on for 300 ms, so also the brief bumps are visible
  *  
  */
   
 #include <TM1638.h>                 // Include the LED & KEY library
+#include <IrLatch.h>                // Snapshot and latches of pins 18..25
 
 TM1638  panel(37,36,35);            // Pin order: STB, CLK, DIO
 
-#define firstPin  18
+#define firstPin  IRLATCH_FIRSTPIN
+#define holdTime  300               // [ms] LED on after a latched bump
 
 char* sensorName[] = {"LE Fr", "Fr LE", "Fr ri", "ri Fr",
                       "ri BA", "BA ri", "BA LE", "LE BA"};
@@ -33,21 +40,24 @@ uint8_t prevPattern = 0;
 void setup() {
   panel.setLEDs(prevPattern);       // Reset LEDs
   panel.writeText(0,"NO SENSR");      // Update display
-  for (uint8_t i=0;i<8;i++) {       // Setup input pins
-    pinMode(firstPin + i, INPUT_PULLUP);
-  }
+  IrLatch::begin();                 // Setup input pins and interrupts
 }
 
 void loop() {
   uint8_t   pattern = 0;
   uint8_t   activeChannel;
+  uint8_t   active  = IrLatch::read() | IrLatch::latched();
+  uint32_t  now     = millis();
 
   for (uint8_t i=0;i<8;i++) {       // Scan the IR Sensors
     pattern <<= 1;                  // Shift the pattern to left
-    if (!digitalRead(firstPin + i)) {
+    if (active & (1 << i)) {
       pattern++;                    // Mark the active sensor
       activeChannel = i;
     }
+    if ((IrLatch::latched() & (1 << i)) && (now - IrLatch::latchTime(i) >= holdTime)) {
+      IrLatch::acknowledge(1 << i); // Bump has been shown
+    }
   }
 
   if (prevPattern != pattern) {     // Update panel only for changes